@@ -0,0 +1,184 @@
+/*arena.c*/
+
+//
+// Bump allocator for the nuPython front end (see arena.h). Memory is
+// taken from a list of chunks; each allocation just moves the top of
+// the newest chunk up. A request that does not fit starts a new chunk,
+// twice the size of the last one (or bigger, if the request is), so a
+// program of any size needs only a handful of chunks.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>   // size_t, max_align_t
+#include <string.h>
+
+#include "arena.h"
+
+
+#define ARENA_FIRST_CHUNK (64 * 1024)       // bytes
+#define ARENA_MAX_CHUNK   (8 * 1024 * 1024) // chunks stop doubling here
+#define ARENA_ALIGN       (_Alignof(max_align_t))
+
+
+//
+// A chunk of memory, with its bytes following the header:
+//
+struct ARENA_CHUNK
+{
+  struct ARENA_CHUNK* prev;  // the chunk before, NULL => first
+  size_t size;               // # of bytes in data
+  size_t top;                // # of bytes handed out so far
+  max_align_t data[];
+};
+
+struct ARENA
+{
+  struct ARENA_CHUNK* chunk; // newest chunk, where allocation happens
+  size_t next_size;          // size of the next chunk
+  size_t bytes;              // total # of bytes handed out
+};
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**ARENA ERROR\n");
+  printf("**ARENA ERROR: %s\n", msg);
+  printf("**ARENA ERROR\n");
+
+  exit(-123);
+}
+
+//
+// new_chunk
+//
+// Adds a new chunk of at least the given size to the arena.
+//
+static void new_chunk(struct ARENA* arena, size_t size)
+{
+  size_t chunk_size = arena->next_size;
+  while (chunk_size < size)
+    chunk_size *= 2;
+
+  struct ARENA_CHUNK* chunk = (struct ARENA_CHUNK*)calloc(1, sizeof(struct ARENA_CHUNK) + chunk_size);
+  if (chunk == NULL)
+    panic("out of memory (new_chunk)");
+
+  chunk->prev = arena->chunk;
+  chunk->size = chunk_size;
+  chunk->top = 0;
+  arena->chunk = chunk;
+
+  if (arena->next_size < ARENA_MAX_CHUNK)
+    arena->next_size *= 2;
+}
+
+//
+// arena_create
+//
+// Returns a new, empty arena.
+//
+struct ARENA* arena_create(void)
+{
+  struct ARENA* arena = (struct ARENA*)malloc(sizeof(struct ARENA));
+  if (arena == NULL)
+    panic("out of memory (arena_create)");
+
+  arena->chunk = NULL;
+  arena->next_size = ARENA_FIRST_CHUNK;
+  arena->bytes = 0;
+
+  return arena;
+}
+
+//
+// bump
+//
+// Returns size bytes from the newest chunk, starting on a multiple
+// of align (a power of 2), and starts a new chunk if they don't fit.
+// Chunks are calloc'd, and never reused, so the memory is zero.
+//
+static void* bump(struct ARENA* arena, size_t size, size_t align)
+{
+  struct ARENA_CHUNK* chunk = arena->chunk;
+  size_t start = 0;
+
+  if (chunk != NULL)
+    start = (chunk->top + align - 1) & ~(align - 1);
+
+  if (chunk == NULL || start > chunk->size || chunk->size - start < size) {
+    new_chunk(arena, size);
+    chunk = arena->chunk;
+    start = 0;
+  }
+
+  arena->bytes += size + (start - chunk->top);
+  chunk->top = start + size;
+
+  return (char*)chunk->data + start;
+}
+
+//
+// arena_alloc
+//
+// Returns size bytes of zeroed memory from the arena, aligned
+// for any type.
+//
+void* arena_alloc(struct ARENA* arena, size_t size)
+{
+  return bump(arena, size, ARENA_ALIGN);
+}
+
+//
+// arena_strdup
+//
+// Returns a copy of the given string, allocated in the arena.
+//
+char* arena_strdup(struct ARENA* arena, const char* s)
+{
+  size_t length = strlen(s);
+
+  char* copy = (char*)bump(arena, length + 1, 1);  // strings need no alignment
+  memcpy(copy, s, length + 1);
+
+  return copy;
+}
+
+//
+// arena_bytes
+//
+// Returns the total # of bytes allocated from the arena so far.
+//
+size_t arena_bytes(struct ARENA* arena)
+{
+  return arena->bytes;
+}
+
+//
+// arena_destroy
+//
+// Frees the arena and everything that was allocated from it.
+//
+void arena_destroy(struct ARENA* arena)
+{
+  if (arena == NULL)
+    return;
+
+  struct ARENA_CHUNK* chunk = arena->chunk;
+  while (chunk != NULL) {
+    struct ARENA_CHUNK* prev = chunk->prev;
+    free(chunk);
+    chunk = prev;
+  }
+
+  free(arena);
+}
@@ -0,0 +1,62 @@
+/*arena.h*/
+
+//
+// Bump allocator for the nuPython front end. An arena hands out
+// memory from large chunks, one after the other, and frees it all at
+// once when the arena is destroyed; nothing is freed individually.
+// One arena is owned by each compilation, and serves every node and
+// string of the program graph, so the graph sits contiguously in
+// memory and is torn down with a single call.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stddef.h>   // size_t
+
+
+struct ARENA;  // the chunks handed out so far (see arena.c)
+
+
+//
+// Public functions:
+//
+
+//
+// arena_create
+//
+// Returns a new, empty arena.
+//
+struct ARENA* arena_create(void);
+
+//
+// arena_alloc
+//
+// Returns size bytes of zeroed memory from the arena, aligned
+// for any type. The memory lives until the arena is destroyed.
+//
+void* arena_alloc(struct ARENA* arena, size_t size);
+
+//
+// arena_strdup
+//
+// Returns a copy of the given string, allocated in the arena.
+//
+char* arena_strdup(struct ARENA* arena, const char* s);
+
+//
+// arena_bytes
+//
+// Returns the total # of bytes allocated from the arena so far.
+//
+size_t arena_bytes(struct ARENA* arena);
+
+//
+// arena_destroy
+//
+// Frees the arena and everything that was allocated from it.
+//
+void arena_destroy(struct ARENA* arena);
@@ -0,0 +1,646 @@
+/*bytecode.c*/
+
+//
+// Compiles a nuPython program graph into bytecode for the virtual machine
+// in vm.c. The compiler makes one pass over the graph: every statement
+// becomes a handful of instructions, literals are decoded once into the
+// constant pool, and variable names are resolved to slots up front (see
+// resolve.h) so instructions refer to variables by number. While loops become a
+// conditional jump at the top and an unconditional jump back at the end.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "bytecode.h"
+#include "rstring.h"
+
+
+//
+// Registers used by the compiled code. Expressions are never nested in
+// nuPython, so a fixed pair is enough: one for while loop conditions
+// and one for the address of a *p = ... assignment target.
+//
+#define REG_CONDITION 0
+#define REG_TARGET    1
+#define NUM_REGISTERS 2
+
+
+//
+// Opcode names, for printing:
+//
+static char* opcode_names[NUM_OPCODES] = {
+  "add", "sub", "mul", "pow", "mod", "div",
+  "eq", "ne", "lt", "lte", "gt", "gte", "is", "in", "append",
+  "move", "input", "int", "float", "print", "deref_target",
+  "jump", "jump_if_false", "halt",
+  "add_ii", "sub_ii", "mul_ii", "div_ii",
+  "eq_ii", "ne_ii", "lt_ii", "lte_ii", "gt_ii", "gte_ii",
+  "add_rr", "sub_rr", "mul_rr", "div_rr",
+  "eq_rr", "ne_rr", "lt_rr", "lte_rr", "gt_rr", "gte_rr",
+  "inc_ii", "add_to_ii", "branch_lt_ii", "deref_inc",
+  "loop_lt", "loop_inc_lt"
+};
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**BYTECODE ERROR\n");
+  printf("**BYTECODE ERROR: %s\n", msg);
+  printf("**BYTECODE ERROR\n");
+
+  exit(-123);
+}
+
+//
+// make_operand
+//
+// Helper function to build an operand of the given kind.
+//
+static struct OPERAND make_operand(int kind, int index)
+{
+  struct OPERAND operand;
+  operand.kind = kind;
+  operand.index = index;
+  return operand;
+}
+
+//
+// emit
+//
+// Appends an instruction to the end of the code array, growing the
+// array as needed. Returns the index of the new instruction so jumps
+// can be patched later.
+//
+static int emit(struct BYTECODE* code, int opcode, int line, struct OPERAND dst, struct OPERAND a, struct OPERAND b)
+{
+  if (code->num_instrs == code->instr_capacity) {
+    code->instr_capacity *= 2;
+    code->code = (struct INSTR*)realloc(code->code, code->instr_capacity * sizeof(struct INSTR));
+    if (code->code == NULL)
+      panic("out of memory (emit)");
+  }
+
+  struct INSTR* instr = &code->code[code->num_instrs];
+  instr->opcode = opcode;
+  instr->line = line;
+  instr->dst = dst;
+  instr->a = a;
+  instr->b = b;
+  instr->target = -1;
+  instr->cache_types = -1;
+  instr->cache_hits = 0;
+  instr->checked = false;
+
+  code->num_instrs++;
+  return code->num_instrs - 1;
+}
+
+//
+// add_constant
+//
+// Adds a literal element to the constant pool, decoding it from its
+// string form into a typed value. Returns the constant's index.
+//
+static int add_constant(struct BYTECODE* code, struct ELEMENT* element)
+{
+  if (code->num_constants == code->const_capacity) {
+    code->const_capacity *= 2;
+    code->constants = (struct RAM_VALUE*)realloc(code->constants, code->const_capacity * sizeof(struct RAM_VALUE));
+    if (code->constants == NULL)
+      panic("out of memory (add_constant)");
+  }
+
+  struct RAM_VALUE* value = &code->constants[code->num_constants];
+  int type = element->element_type;
+
+  if (type == ELEMENT_INT_LITERAL) {
+    value->value_type = RAM_TYPE_INT;
+    value->types.i = atoi(element->element_value);
+  } else if (type == ELEMENT_REAL_LITERAL) {
+    value->value_type = RAM_TYPE_REAL;
+    value->types.d = atof(element->element_value);
+  } else if (type == ELEMENT_STR_LITERAL) {
+    value->value_type = RAM_TYPE_STR;
+    value->types.s = rstr_from(element->element_value);
+  } else if (type == ELEMENT_TRUE) {
+    value->value_type = RAM_TYPE_BOOLEAN;
+    value->types.i = 1;
+  } else if (type == ELEMENT_FALSE) {
+    value->value_type = RAM_TYPE_BOOLEAN;
+    value->types.i = 0;
+  } else {
+    value->value_type = RAM_TYPE_NONE;
+    value->types.i = 0;
+  }
+
+  code->num_constants++;
+  return code->num_constants - 1;
+}
+
+//
+// add_string_constant
+//
+// Adds the given string to the constant pool as-is, whatever kind of
+// element it came from. Returns the constant's index.
+//
+static int add_string_constant(struct BYTECODE* code, char* s)
+{
+  struct ELEMENT element;
+  element.element_type = ELEMENT_STR_LITERAL;
+  element.element_value = s;
+
+  return add_constant(code, &element);
+}
+
+//
+// unary_operand
+//
+// Returns the operand for a unary expression. In a binary expression
+// the executor reads the variable itself for &x (only *x is followed),
+// so binary_context selects that behavior; otherwise &x yields the
+// address of x.
+//
+static struct OPERAND unary_operand(struct BYTECODE* code, struct UNARY_EXPR* unary, bool binary_context)
+{
+  struct ELEMENT* element = unary->element;
+
+  if (element->element_type != ELEMENT_IDENTIFIER)
+    return make_operand(OPND_CONST, add_constant(code, element));
+
+  int name = symtab_slot(code->symbols, element->element_value);
+
+  if (unary->expr_type == UNARY_PTR_DEREF)
+    return make_operand(OPND_DEREF, name);
+  if (unary->expr_type == UNARY_ADDRESS_OF && !binary_context)
+    return make_operand(OPND_ADDR, name);
+
+  return make_operand(OPND_VAR, name);
+}
+
+//
+// compile_expr
+//
+// Compiles an expression whose result is stored into dst.
+//
+static void compile_expr(struct BYTECODE* code, struct EXPR* expr, struct OPERAND dst, int line)
+{
+  struct OPERAND none = make_operand(OPND_NONE, 0);
+
+  if (!expr->isBinaryExpr) {
+    emit(code, OP_MOVE, line, dst, unary_operand(code, expr->lhs, false), none);
+    return;
+  }
+
+  if (expr->rhs == NULL) { // malformed expression, stop without a message like the executor
+    emit(code, OP_HALT, line, none, none, none);
+    return;
+  }
+
+  int opcode = OP_ADD + expr->operator;
+  if (expr->operator < OPERATOR_PLUS || expr->operator > OPERATOR_IN)
+    opcode = OP_IS;
+
+  struct OPERAND a = unary_operand(code, expr->lhs, true);
+  struct OPERAND b = unary_operand(code, expr->rhs, true);
+
+  // x = x + ...: lets the VM append to a string in place
+  if (opcode == OP_ADD && dst.kind == OPND_VAR && a.kind == OPND_VAR && a.index == dst.index)
+    opcode = OP_APPEND;
+
+  emit(code, opcode, line, dst, a, b);
+}
+
+//
+// compile_assignment
+//
+// Compiles x = ..., *p = ..., and x = input/int/float(...). For *p the
+// target is resolved before the right-hand side is evaluated, so errors
+// are reported in the same order as the tree-walking executor.
+//
+static void compile_assignment(struct BYTECODE* code, struct STMT* stmt)
+{
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+  struct OPERAND none = make_operand(OPND_NONE, 0);
+  int line = stmt->line;
+  struct OPERAND dst;
+
+  int name = symtab_slot(code->symbols, assignment->var_name);
+  if (assignment->isPtrDeref) {
+    emit(code, OP_DEREF_TARGET, line, make_operand(OPND_REG, REG_TARGET), make_operand(OPND_VAR, name), none);
+    dst = make_operand(OPND_CELL, REG_TARGET);
+  } else {
+    dst = make_operand(OPND_VAR, name);
+  }
+
+  if (assignment->rhs->value_type == VALUE_EXPR) {
+    compile_expr(code, assignment->rhs->types.expr, dst, line);
+    return;
+  }
+
+  // function call: input, int, and float, anything else is ignored
+  struct FUNCTION_CALL* call = assignment->rhs->types.function_call;
+  struct ELEMENT* parameter = call->parameter;
+
+  if (strcmp(call->function_name, "input") == 0) {
+    struct OPERAND prompt = none;
+    if (parameter != NULL) // the prompt is output as written, whatever the element type
+      prompt = make_operand(OPND_CONST, add_string_constant(code, parameter->element_value));
+    emit(code, OP_INPUT, line, dst, prompt, none);
+  } else if (strcmp(call->function_name, "int") == 0 || strcmp(call->function_name, "float") == 0) {
+    struct OPERAND var = none;
+    if (parameter != NULL) // the parameter is always looked up as a variable
+      var = make_operand(OPND_VAR, symtab_slot(code->symbols, parameter->element_value));
+    int opcode = (strcmp(call->function_name, "int") == 0) ? OP_INT : OP_FLOAT;
+    emit(code, opcode, line, dst, var, none);
+  }
+}
+
+//
+// compile_function_call
+//
+// Compiles a function call statement, which is always print.
+//
+static void compile_function_call(struct BYTECODE* code, struct STMT* stmt)
+{
+  struct ELEMENT* parameter = stmt->types.function_call->parameter;
+  struct OPERAND none = make_operand(OPND_NONE, 0);
+  struct OPERAND a = none;
+
+  if (parameter != NULL && parameter->element_type == ELEMENT_IDENTIFIER)
+    a = make_operand(OPND_VAR, symtab_slot(code->symbols, parameter->element_value));
+  else if (parameter != NULL)
+    a = make_operand(OPND_CONST, add_constant(code, parameter));
+
+  emit(code, OP_PRINT, stmt->line, none, a, none);
+}
+
+static void compile_stmts(struct BYTECODE* code, struct STMT* stmt, struct STMT* stop);
+
+//
+// compile_while
+//
+// Compiles a while loop:
+//
+//   top:  [cond = condition]
+//         jump_if_false cond, exit
+//         body
+//         jump top
+//   exit:
+//
+static void compile_while(struct BYTECODE* code, struct STMT* stmt)
+{
+  struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
+  struct EXPR* condition = while_loop->condition;
+  struct OPERAND none = make_operand(OPND_NONE, 0);
+  int line = stmt->line;
+
+  int top = code->num_instrs;
+  struct OPERAND cond;
+
+  if (condition->isBinaryExpr) {
+    cond = make_operand(OPND_REG, REG_CONDITION);
+    compile_expr(code, condition, cond, line);
+  } else {
+    cond = unary_operand(code, condition->lhs, false);
+  }
+
+  int branch = emit(code, OP_JUMP_IF_FALSE, line, none, cond, none);
+
+  // the last stmt in the body links back to the loop itself:
+  compile_stmts(code, while_loop->loop_body, stmt);
+
+  int jump = emit(code, OP_JUMP, line, none, none, none);
+  code->code[jump].target = top;
+  code->code[branch].target = code->num_instrs;
+}
+
+//
+// compile_stmts
+//
+// Compiles statements until stop (or the end of the program) is reached.
+//
+static void compile_stmts(struct BYTECODE* code, struct STMT* stmt, struct STMT* stop)
+{
+  struct OPERAND none = make_operand(OPND_NONE, 0);
+
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      compile_assignment(code, stmt);
+      stmt = stmt->types.assignment->next_stmt;
+    } else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      compile_function_call(code, stmt);
+      stmt = stmt->types.function_call->next_stmt;
+    } else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      compile_while(code, stmt);
+      stmt = stmt->types.while_loop->next_stmt;
+    } else if (stmt->stmt_type == STMT_PASS) {
+      stmt = stmt->types.pass->next_stmt;
+    } else { // if-then-else is rejected by programgraph_build
+      emit(code, OP_HALT, stmt->line, none, none, none);
+      return;
+    }
+  }
+}
+
+//
+// bytecode_compile
+//
+// Given a nuPython program graph, compiles the program
+// into bytecode and returns it.
+//
+struct BYTECODE* bytecode_compile(struct STMT* program)
+{
+  struct BYTECODE* code = (struct BYTECODE*)malloc(sizeof(struct BYTECODE));
+  if (code == NULL)
+    panic("out of memory (bytecode_compile)");
+
+  code->num_instrs = 0;
+  code->instr_capacity = 16;
+  code->code = (struct INSTR*)malloc(code->instr_capacity * sizeof(struct INSTR));
+
+  code->num_constants = 0;
+  code->const_capacity = 8;
+  code->constants = (struct RAM_VALUE*)malloc(code->const_capacity * sizeof(struct RAM_VALUE));
+
+  if (code->code == NULL || code->constants == NULL)
+    panic("out of memory (bytecode_compile)");
+
+  code->num_registers = NUM_REGISTERS;
+  code->symbols = resolve_program(program);
+
+  for (int opcode = 0; opcode < NUM_OPCODES; opcode++)
+    code->fires[opcode] = 0;
+
+  compile_stmts(code, program, NULL);
+
+  struct OPERAND none = make_operand(OPND_NONE, 0);
+  emit(code, OP_HALT, 0, none, none, none);
+
+  return code;
+}
+
+//
+// bytecode_quickened_opcode
+//
+// Returns the specialized opcode for a generic binary opcode and the
+// given operand types, or -1 if there is none. Used by the VM when
+// it quickens an instruction, and by check.c when it proves the types.
+//
+int bytecode_quickened_opcode(int opcode, int type_lhs, int type_rhs)
+{
+  static const int int_opcodes[] = {
+    OP_ADD_II, OP_SUB_II, OP_MUL_II, -1 /*pow*/, -1 /*mod*/, OP_DIV_II,
+    OP_EQ_II, OP_NE_II, OP_LT_II, OP_LTE_II, OP_GT_II, OP_GTE_II
+  };
+  static const int real_opcodes[] = {
+    OP_ADD_RR, OP_SUB_RR, OP_MUL_RR, -1 /*pow*/, -1 /*mod*/, OP_DIV_RR,
+    OP_EQ_RR, OP_NE_RR, OP_LT_RR, OP_LTE_RR, OP_GT_RR, OP_GTE_RR
+  };
+
+  if (opcode < OP_ADD || opcode > OP_GTE)
+    return -1;
+  if (type_lhs == RAM_TYPE_INT && type_rhs == RAM_TYPE_INT)
+    return int_opcodes[opcode - OP_ADD];
+  if (type_lhs == RAM_TYPE_REAL && type_rhs == RAM_TYPE_REAL)
+    return real_opcodes[opcode - OP_ADD];
+  return -1;
+}
+
+//
+// is_int_constant
+//
+// Returns true if the operand is an int constant.
+//
+static bool is_int_constant(struct BYTECODE* code, struct OPERAND operand)
+{
+  return operand.kind == OPND_CONST && code->constants[operand.index].value_type == RAM_TYPE_INT;
+}
+
+//
+// writes_var
+//
+// Returns true if the instruction may write the variable in the
+// given slot: directly, or through a pointer.
+//
+static bool writes_var(struct INSTR* instr, int slot)
+{
+  if (instr->dst.kind == OPND_CELL)
+    return true;
+  return instr->dst.kind == OPND_VAR && instr->dst.index == slot;
+}
+
+//
+// fuse_counted_loop
+//
+// Given the jump at the end of a while loop, turns the loop into a
+// counted loop if it has the form
+//
+//   top:  [cond = i < N]
+//         jump_if_false cond, exit
+//         body, which changes neither i nor N
+//         i = i + constant
+//         jump top
+//   exit:
+//
+// The header becomes loop_lt and the increment loop_inc_lt, which
+// does the increment and the test, and goes back to the body or out
+// of the loop itself; the jumps are only used if i or N is not an int.
+//
+static void fuse_counted_loop(struct BYTECODE* code, int jump)
+{
+  int top = code->code[jump].target;
+  int increment = jump - 1;
+
+  if (top >= increment - 1)  // no room for a header and an increment
+    return;
+
+  struct INSTR* header = &code->code[top];
+  struct INSTR* branch = &code->code[top + 1];
+  struct INSTR* step = &code->code[increment];
+
+  if (!(header->opcode == OP_LT || header->opcode == OP_LT_II) || header->dst.kind != OPND_REG)
+    return;
+  if (branch->opcode != OP_JUMP_IF_FALSE || branch->a.kind != OPND_REG || branch->a.index != header->dst.index)
+    return;
+  if (branch->target != jump + 1)
+    return;
+
+  // the condition is i < N, with N a constant or another variable:
+  if (header->a.kind != OPND_VAR)
+    return;
+  int i = header->a.index;
+  int n = -1;
+  if (header->b.kind == OPND_VAR && header->b.index != i)
+    n = header->b.index;
+  else if (!is_int_constant(code, header->b))
+    return;
+
+  // the last statement in the body is i = i + constant:
+  if (!(step->opcode == OP_ADD || step->opcode == OP_APPEND || step->opcode == OP_ADD_II))
+    return;
+  if (step->dst.kind != OPND_VAR || step->dst.index != i || step->a.kind != OPND_VAR || step->a.index != i)
+    return;
+  if (!is_int_constant(code, step->b))
+    return;
+
+  for (int k = top + 2; k < increment; k++) {
+    if (writes_var(&code->code[k], i) || (n >= 0 && writes_var(&code->code[k], n)))
+      return;
+  }
+
+  header->opcode = OP_LOOP_LT;
+  header->target = increment;
+  step->opcode = OP_LOOP_INC_LT;
+  step->target = top;
+  step->cache_hits = 0;
+}
+
+//
+// bytecode_fuse
+//
+// Replaces the common idioms in the bytecode with superinstructions.
+// Counted loops are found first, since their increments and tests
+// would otherwise be fused on their own. The int forms need
+// instructions that check_program has proven safe and specialized;
+// *p = *p + 1 checks its types when it runs, and does the two
+// instructions it stands for one at a time if they differ.
+//
+void bytecode_fuse(struct BYTECODE* code)
+{
+  for (int i = 0; i < code->num_instrs; i++) {
+    if (code->code[i].opcode == OP_JUMP)
+      fuse_counted_loop(code, i);
+  }
+
+  for (int i = 0; i < code->num_instrs - 1; i++) {
+    struct INSTR* instr = &code->code[i];
+    struct INSTR* next = &code->code[i + 1];
+
+    if (instr->opcode == OP_ADD_II && instr->checked
+      && instr->dst.kind == OPND_VAR && instr->a.kind == OPND_VAR && instr->dst.index == instr->a.index) {
+      // x = x + 1, x = x + y:
+      if (is_int_constant(code, instr->b))
+        instr->opcode = OP_INC_II;
+      else if (instr->b.kind == OPND_VAR)
+        instr->opcode = OP_ADD_TO_II;
+    }
+    else if (instr->opcode == OP_LT_II && instr->checked
+      && next->opcode == OP_JUMP_IF_FALSE && instr->dst.kind == OPND_REG
+      && next->a.kind == OPND_REG && next->a.index == instr->dst.index) {
+      // while a < b:
+      instr->opcode = OP_BRANCH_LT_II;
+    }
+    else if (instr->opcode == OP_DEREF_TARGET
+      && next->opcode == OP_ADD && next->dst.kind == OPND_CELL && next->dst.index == instr->dst.index
+      && next->a.kind == OPND_DEREF && next->a.index == instr->a.index && is_int_constant(code, next->b)) {
+      // *p = *p + 1:
+      instr->opcode = OP_DEREF_INC;
+    }
+  }
+}
+
+//
+// bytecode_destroy
+//
+// Frees all the memory associated with the given bytecode.
+//
+void bytecode_destroy(struct BYTECODE* code)
+{
+  if (code == NULL)
+    return;
+
+  for (int i = 0; i < code->num_constants; i++) {
+    if (code->constants[i].value_type == RAM_TYPE_STR)
+      rstr_release(code->constants[i].types.s);
+  }
+  symtab_destroy(code->symbols);
+
+  free(code->code);
+  free(code->constants);
+  free(code);
+}
+
+//
+// print_operand
+//
+// Prints one operand of an instruction, for bytecode_print.
+//
+static void print_operand(struct BYTECODE* code, struct OPERAND operand)
+{
+  if (operand.kind == OPND_REG) {
+    printf("r%d", operand.index);
+  } else if (operand.kind == OPND_CONST) {
+    struct RAM_VALUE* value = &code->constants[operand.index];
+    if (value->value_type == RAM_TYPE_INT)
+      printf("%d", value->types.i);
+    else if (value->value_type == RAM_TYPE_REAL)
+      printf("%f", value->types.d);
+    else if (value->value_type == RAM_TYPE_STR)
+      printf("'%s'", value->types.s);
+    else if (value->value_type == RAM_TYPE_BOOLEAN)
+      printf("%s", value->types.i ? "True" : "False");
+    else
+      printf("None");
+  } else if (operand.kind == OPND_VAR) {
+    printf("%s", code->symbols->names[operand.index]);
+  } else if (operand.kind == OPND_DEREF) {
+    printf("*%s", code->symbols->names[operand.index]);
+  } else if (operand.kind == OPND_ADDR) {
+    printf("&%s", code->symbols->names[operand.index]);
+  } else if (operand.kind == OPND_CELL) {
+    printf("[r%d]", operand.index);
+  } else {
+    printf("-");
+  }
+}
+
+//
+// bytecode_print
+//
+// Prints the bytecode to the console, for debugging.
+//
+void bytecode_print(struct BYTECODE* code)
+{
+  printf("**BYTECODE**\n");
+  for (int i = 0; i < code->num_instrs; i++) {
+    struct INSTR* instr = &code->code[i];
+
+    printf("%4d: %-14s ", i, opcode_names[instr->opcode]);
+    print_operand(code, instr->dst);
+    printf(", ");
+    print_operand(code, instr->a);
+    printf(", ");
+    print_operand(code, instr->b);
+    if (instr->target >= 0)
+      printf(" -> %d", instr->target);
+    printf("  (line %d)%s\n", instr->line, instr->checked ? " checked" : "");
+  }
+  printf("**END BYTECODE**\n");
+}
+
+//
+// bytecode_print_fires
+//
+// Prints how many times each superinstruction ran.
+//
+void bytecode_print_fires(struct BYTECODE* code)
+{
+  printf("**SUPERINSTRUCTIONS**\n");
+  for (int opcode = OP_INC_II; opcode < NUM_OPCODES; opcode++)
+    printf("%s: %ld\n", opcode_names[opcode], code->fires[opcode]);
+  printf("**END SUPERINSTRUCTIONS**\n");
+}
@@ -0,0 +1,196 @@
+/*bytecode.h*/
+
+//
+// Compact bytecode for nuPython. The program graph produced by
+// programgraph_build is compiled into a flat array of instructions,
+// which is then run by the register-based virtual machine (see vm.h).
+// Each instruction names its operands directly (a register, a constant,
+// a variable slot, ...), so one instruction does the work of the nested
+// execute_assignment -> execute_expression -> retrieve_value calls
+// in the tree-walking executor.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+
+
+//
+// Opcodes. The binary operators are laid out in the same order as
+// enum OPERATORS so that OP_ADD + operator gives the opcode.
+//
+enum OPCODES
+{
+  OP_ADD = 0,     // dst = a + b
+  OP_SUB,         // dst = a - b
+  OP_MUL,         // dst = a * b
+  OP_POW,         // dst = a ** b
+  OP_MOD,         // dst = a % b
+  OP_DIV,         // dst = a / b
+  OP_EQ,          // dst = a == b
+  OP_NE,          // dst = a != b
+  OP_LT,          // dst = a < b
+  OP_LTE,         // dst = a <= b
+  OP_GT,          // dst = a > b
+  OP_GTE,         // dst = a >= b
+  OP_IS,          // not supported on any operand types
+  OP_IN,          // not supported on any operand types
+  OP_APPEND,      // dst = dst + b where dst (= a) is a variable, strings are appended in place
+  OP_MOVE,        // dst = a
+  OP_INPUT,       // dst = input(a)
+  OP_INT,         // dst = int(a)
+  OP_FLOAT,       // dst = float(a)
+  OP_PRINT,       // print(a)
+  OP_DEREF_TARGET,// dst = address stored in pointer a, for *a = ...
+  OP_JUMP,        // goto target
+  OP_JUMP_IF_FALSE, // if a is not true, goto target
+  OP_HALT,        // stop execution
+
+  //
+  // Quickened opcodes: the VM rewrites a binary instruction into one of
+  // these once its operands have had the same types a few times in a
+  // row (see vm.c). Each checks its operand types and falls back to the
+  // generic opcode if they differ. _II is int-int, _RR is real-real.
+  //
+  OP_ADD_II, OP_SUB_II, OP_MUL_II, OP_DIV_II,
+  OP_EQ_II, OP_NE_II, OP_LT_II, OP_LTE_II, OP_GT_II, OP_GTE_II,
+  OP_ADD_RR, OP_SUB_RR, OP_MUL_RR, OP_DIV_RR,
+  OP_EQ_RR, OP_NE_RR, OP_LT_RR, OP_LTE_RR, OP_GT_RR, OP_GTE_RR,
+
+  //
+  // Superinstructions: bytecode_fuse replaces the common loop idioms
+  // with these. A superinstruction that stands for two instructions
+  // takes the place of the first and reads its second half from the
+  // one after it, which is left as is, so no jump target moves.
+  //
+  OP_INC_II,       // x = x + constant, x proven int
+  OP_ADD_TO_II,    // x = x + y, x and y proven int
+  OP_BRANCH_LT_II, // if not a < b, goto the next instruction's target (proven int)
+  OP_DEREF_INC,    // *p = *p + constant, the next instruction is the add
+  OP_LOOP_LT,      // counted loop header: while i < N, target is the back edge
+  OP_LOOP_INC_LT,  // counted loop back edge: i = i + constant, then test i < N again
+  NUM_OPCODES
+};
+
+//
+// Where an operand lives:
+//
+enum OPERAND_KINDS
+{
+  OPND_NONE = 0,  // no operand, e.g. print()
+  OPND_REG,       // VM register (temporary value)
+  OPND_CONST,     // constant pool entry (literal)
+  OPND_VAR,       // variable, index is its slot (see resolve.h)
+  OPND_DEREF,     // *var, the memory cell that var points to
+  OPND_ADDR,      // &var, the address of var
+  OPND_CELL       // memory cell whose address is held in a register
+};
+
+struct OPERAND
+{
+  int kind;   // enum OPERAND_KINDS
+  int index;  // register #, constant #, or slot #
+};
+
+struct INSTR
+{
+  int opcode;  // enum OPCODES
+  int line;    // source line, for error messages
+
+  struct OPERAND dst;
+  struct OPERAND a;
+  struct OPERAND b;
+
+  int target;  // jump target (index into code), if any
+
+  //
+  // inline type cache, for quickening binary instructions:
+  //
+  int cache_types;  // operand types last seen, lhs type * 8 + rhs type
+  int cache_hits;   // # of times in a row they were seen, -1 => never quicken
+                    // (OP_LOOP_INC_LT: 1 => the loop header found i and N to be ints)
+
+  bool checked;  // operands and types proven safe by check.c, no run-time checks needed
+};
+
+struct BYTECODE
+{
+  struct INSTR* code;  // array of instructions
+  int num_instrs;
+  int instr_capacity;
+
+  struct RAM_VALUE* constants;  // constant pool, strings are rstrings
+  int num_constants;
+  int const_capacity;
+
+  struct SYMTAB* symbols;  // slot # <-> variable name
+
+  int num_registers;  // # of VM registers the code needs
+
+  long fires[NUM_OPCODES];  // # of times each superinstruction ran
+};
+
+
+//
+// Public functions:
+//
+
+//
+// bytecode_compile
+//
+// Given a nuPython program graph, compiles the program
+// into bytecode and returns it. The program graph is not
+// referenced by the bytecode, and may be destroyed after
+// the call returns.
+//
+struct BYTECODE* bytecode_compile(struct STMT* program);
+
+//
+// bytecode_quickened_opcode
+//
+// Returns the specialized opcode for a generic binary opcode and the
+// given operand types (RAM_TYPE_INT, ...), or -1 if there is none.
+//
+int bytecode_quickened_opcode(int opcode, int type_lhs, int type_rhs);
+
+//
+// bytecode_fuse
+//
+// Replaces the common idioms in the bytecode with superinstructions:
+// x = x + 1, x = x + y, while i < N, and *p = *p + 1. Counted loops,
+// while i < N: { ... i = i + constant } where the rest of the body
+// changes neither i nor N, get a header that checks the types of i
+// and N once per entry, and a back edge that steps and tests i with
+// no checks. Should be called after check_program, since the other
+// int forms are only used where the types have been proven.
+//
+void bytecode_fuse(struct BYTECODE* code);
+
+//
+// bytecode_destroy
+//
+// Frees all the memory associated with the given bytecode.
+//
+void bytecode_destroy(struct BYTECODE* code);
+
+//
+// bytecode_print
+//
+// Prints the bytecode to the console, for debugging.
+//
+void bytecode_print(struct BYTECODE* code);
+
+//
+// bytecode_print_fires
+//
+// Prints how many times each superinstruction ran.
+//
+void bytecode_print_fires(struct BYTECODE* code);
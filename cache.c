@@ -0,0 +1,517 @@
+/*cache.c*/
+
+//
+// Precompiled program cache for nuPython (see cache.h). A cache file
+// is the header, then the flat program's arrays --- stmts, exprs,
+// unaries, elements, calls, names, strings --- each starting on a
+// multiple of 8 bytes. The header records the size of every array
+// entry too, so a file from a build with a different layout is a
+// miss. The arrays are covered by a hash in the header, and a loaded
+// program is also checked index by index before it is run, so a
+// damaged file cannot send the executor outside the mapping.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#define _DEFAULT_SOURCE  // fileno, getpid
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stddef.h>   // offsetof
+#include <stdint.h>   // uint32_t, uint64_t
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>  // mmap, munmap
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // getpid
+#define CACHE_MMAP
+#endif
+
+#include "programgraph.h"
+#include "flat.h"
+#include "cache.h"
+
+
+#define CACHE_MAGIC   "NUPYC\n\032"  // 8 bytes, with the '\0'
+#define CACHE_VERSION 1              // bump when the flat layout changes
+#define CACHE_ALIGN   8
+#define FNV_OFFSET    14695981039346656037ull
+
+struct CACHE_HEADER
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t optimized;      // true => the optimizer was on
+  uint64_t source_hash;    // FNV-1a of the source text
+  uint64_t source_length;
+
+  uint32_t entry_sizes[5]; // sizeof FLAT_STMT, _EXPR, _UNARY, _ELEMENT, _CALL
+  uint32_t num_stmts;
+  uint32_t num_exprs;
+  uint32_t num_unaries;
+  uint32_t num_elements;
+  uint32_t num_calls;
+  uint32_t num_slots;
+  uint32_t strings_size;
+  uint64_t payload_hash;   // FNV-1a of everything after the header
+};
+
+//
+// A loaded program, and the memory its arrays point into:
+//
+struct CACHED_PROGRAM
+{
+  struct FLAT_PROGRAM program;  // first, see cache_close
+  void* data;
+  size_t size;
+  bool mapped;                  // false => data is malloc'd
+};
+
+
+//
+// hash_bytes
+//
+// Continues the 64-bit FNV-1a hash of a byte sequence, hash so far
+// (FNV_OFFSET to start), over the given bytes, and returns it.
+//
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t length)
+{
+  const unsigned char* bytes = (const unsigned char*)data;
+
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+//
+// make_header
+//
+// Fills in the header for the given program and source.
+//
+static void make_header(struct CACHE_HEADER* header, struct FLAT_PROGRAM* program, char* source, size_t length, bool optimized)
+{
+  memset(header, 0, sizeof(struct CACHE_HEADER));
+  memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+  header->version = CACHE_VERSION;
+  header->optimized = optimized;
+  header->source_hash = hash_bytes(FNV_OFFSET, source, length);
+  header->source_length = length;
+
+  header->entry_sizes[0] = sizeof(struct FLAT_STMT);
+  header->entry_sizes[1] = sizeof(struct FLAT_EXPR);
+  header->entry_sizes[2] = sizeof(struct FLAT_UNARY);
+  header->entry_sizes[3] = sizeof(struct FLAT_ELEMENT);
+  header->entry_sizes[4] = sizeof(struct FLAT_CALL);
+
+  if (program != NULL) {
+    header->num_stmts = program->num_stmts;
+    header->num_exprs = program->num_exprs;
+    header->num_unaries = program->num_unaries;
+    header->num_elements = program->num_elements;
+    header->num_calls = program->num_calls;
+    header->num_slots = program->num_slots;
+    header->strings_size = program->strings_size;
+  }
+}
+
+//
+// section_sizes
+//
+// Computes the # of bytes of each array in the file, in file order,
+// and returns the total size of the file.
+//
+static uint64_t section_sizes(struct CACHE_HEADER* header, uint64_t sizes[7])
+{
+  sizes[0] = (uint64_t)header->num_stmts * sizeof(struct FLAT_STMT);
+  sizes[1] = (uint64_t)header->num_exprs * sizeof(struct FLAT_EXPR);
+  sizes[2] = (uint64_t)header->num_unaries * sizeof(struct FLAT_UNARY);
+  sizes[3] = (uint64_t)header->num_elements * sizeof(struct FLAT_ELEMENT);
+  sizes[4] = (uint64_t)header->num_calls * sizeof(struct FLAT_CALL);
+  sizes[5] = (uint64_t)header->num_slots * sizeof(uint32_t);
+  sizes[6] = header->strings_size;
+
+  uint64_t total = sizeof(struct CACHE_HEADER);
+  for (int i = 0; i < 7; i++)
+    total += (sizes[i] + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+
+  return total;
+}
+
+//
+// valid_index
+//
+// Returns true if index is < count, or is FLAT_NULL and that's allowed.
+//
+static bool valid_index(uint32_t index, uint32_t count, bool null_ok)
+{
+  return index < count || (null_ok && index == FLAT_NULL);
+}
+
+//
+// valid_program
+//
+// Returns true if every index and string offset in the program is in
+// bounds, and every string ends inside the strings.
+//
+static bool valid_program(struct FLAT_PROGRAM* p)
+{
+  if (p->strings_size > 0 && p->strings[p->strings_size - 1] != '\0')
+    return false;
+
+  for (uint32_t i = 0; i < p->num_stmts; i++) {
+    struct FLAT_STMT* stmt = &p->stmts[i];
+
+    if (!valid_index(stmt->next, p->num_stmts, true))
+      return false;
+
+    switch (stmt->stmt_type) {
+      case STMT_ASSIGNMENT:
+        if (!valid_index(stmt->u.assignment.var, p->num_slots, false))
+          return false;
+        if (stmt->u.assignment.value_type == VALUE_EXPR) {
+          if (!valid_index(stmt->u.assignment.value, p->num_exprs, false))
+            return false;
+        }
+        else if (stmt->u.assignment.value_type != VALUE_FUNCTION_CALL ||
+                 !valid_index(stmt->u.assignment.value, p->num_calls, false)) {
+          return false;
+        }
+        break;
+      case STMT_FUNCTION_CALL:
+        if (!valid_index(stmt->u.function_call.call, p->num_calls, false))
+          return false;
+        break;
+      case STMT_WHILE_LOOP:
+        if (!valid_index(stmt->u.while_loop.condition, p->num_exprs, false) ||
+            !valid_index(stmt->u.while_loop.body, p->num_stmts, true))
+          return false;
+        break;
+      case STMT_PASS:
+        break;
+      default:
+        return false;
+    }
+  }
+
+  for (uint32_t i = 0; i < p->num_exprs; i++) {
+    if (!valid_index(p->exprs[i].lhs, p->num_unaries, false) ||
+        !valid_index(p->exprs[i].rhs, p->num_unaries, true))
+      return false;
+  }
+  for (uint32_t i = 0; i < p->num_unaries; i++) {
+    if (!valid_index(p->unaries[i].element, p->num_elements, false))
+      return false;
+  }
+  for (uint32_t i = 0; i < p->num_elements; i++) {
+    struct FLAT_ELEMENT* element = &p->elements[i];
+    if (!valid_index(element->text, p->strings_size, false) ||
+        !valid_index(element->slot, p->num_slots, element->element_type != ELEMENT_IDENTIFIER))
+      return false;
+  }
+  for (uint32_t i = 0; i < p->num_calls; i++) {
+    struct FLAT_CALL* call = &p->calls[i];
+    if (!valid_index(call->function, p->strings_size, false) ||
+        !valid_index(call->parameter, p->num_elements, true))
+      return false;
+
+    // int() and float() look their parameter up as a variable:
+    char* function = p->strings + call->function;
+    if (call->parameter != FLAT_NULL && (strcmp(function, "int") == 0 || strcmp(function, "float") == 0) &&
+        p->elements[call->parameter].slot == FLAT_NULL)
+      return false;
+  }
+  for (uint32_t slot = 0; slot < p->num_slots; slot++) {
+    if (!valid_index(p->names[slot], p->strings_size, false))
+      return false;
+  }
+
+  return true;
+}
+
+//
+// cache_read_source
+//
+// Reads the rest of the given input stream into a new buffer, which
+// the caller frees, and returns it; *length is set to its # of bytes.
+// Returns NULL if the stream cannot be read.
+//
+char* cache_read_source(FILE* input, size_t* length)
+{
+  size_t capacity = 64 * 1024;
+  size_t size = 0;
+  char* source = (char*)malloc(capacity);
+
+  while (source != NULL) {
+    size += fread(source + size, 1, capacity - size, input);
+    if (size < capacity)
+      break;
+
+    capacity *= 2;
+    char* bigger = (char*)realloc(source, capacity);
+    if (bigger == NULL)
+      free(source);
+    source = bigger;
+  }
+
+  if (source != NULL && ferror(input)) {
+    free(source);
+    source = NULL;
+  }
+
+  *length = size;
+  return source;
+}
+
+//
+// cache_path
+//
+// Returns the name of the cache file for the given source file, as
+// a new string the caller frees: the .py is replaced by .nupyc (or
+// .nupyc is appended, if the name doesn't end in .py).
+//
+char* cache_path(char* filename)
+{
+  size_t length = strlen(filename);
+  if (length >= 3 && strcmp(filename + length - 3, ".py") == 0)
+    length -= 3;
+
+  char* path = (char*)malloc(length + strlen(".nupyc") + 1);
+  if (path == NULL)
+    return NULL;
+
+  memcpy(path, filename, length);
+  strcpy(path + length, ".nupyc");
+
+  return path;
+}
+
+//
+// map_file
+//
+// Returns the contents of the given file, mapped into memory if the
+// system can, else read into a malloc'd buffer, or NULL on error.
+//
+static void* map_file(char* path, size_t* size, bool* mapped)
+{
+  FILE* file = fopen(path, "rb");
+  if (file == NULL)
+    return NULL;
+
+  void* data = NULL;
+  *mapped = false;
+
+#if defined(CACHE_MMAP)
+  struct stat info;
+  if (fstat(fileno(file), &info) == 0 && info.st_size > 0) {
+    *size = (size_t)info.st_size;
+    data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (data == MAP_FAILED)
+      data = NULL;
+    else
+      *mapped = true;
+  }
+#endif
+
+  if (data == NULL) {
+    data = cache_read_source(file, size);
+    if (data != NULL && *size == 0) {
+      free(data);
+      data = NULL;
+    }
+  }
+
+  fclose(file);  // a mapping outlives the file
+  return data;
+}
+
+//
+// unmap_file
+//
+// Frees the contents returned by map_file.
+//
+static void unmap_file(void* data, size_t size, bool mapped)
+{
+#if defined(CACHE_MMAP)
+  if (mapped) {
+    munmap(data, size);
+    return;
+  }
+#endif
+  free(data);
+}
+
+//
+// cache_load
+//
+// Maps the given cache file and returns the flat program in it, if
+// the file was written by this version of nuPython for exactly the
+// given source, with the optimizer on or off as given. Returns NULL
+// otherwise. The program is freed with cache_close, not flat_destroy.
+//
+struct FLAT_PROGRAM* cache_load(char* path, char* source, size_t length, bool optimized)
+{
+  size_t size;
+  bool mapped;
+  char* data = (char*)map_file(path, &size, &mapped);
+  if (data == NULL)
+    return NULL;
+
+  struct CACHE_HEADER expected;
+  struct CACHE_HEADER header;
+  make_header(&expected, NULL, source, length, optimized);
+
+  if (size < sizeof(struct CACHE_HEADER)) {
+    unmap_file(data, size, mapped);
+    return NULL;
+  }
+  memcpy(&header, data, sizeof(struct CACHE_HEADER));
+
+  uint64_t sizes[7];
+  if (memcmp(&header, &expected, offsetof(struct CACHE_HEADER, num_stmts)) != 0 ||
+      section_sizes(&header, sizes) != size ||
+      hash_bytes(FNV_OFFSET, data + sizeof(struct CACHE_HEADER), size - sizeof(struct CACHE_HEADER)) != header.payload_hash) {
+    unmap_file(data, size, mapped);
+    return NULL;
+  }
+
+  struct CACHED_PROGRAM* cached = (struct CACHED_PROGRAM*)calloc(1, sizeof(struct CACHED_PROGRAM));
+  if (cached == NULL) {
+    unmap_file(data, size, mapped);
+    return NULL;
+  }
+  cached->data = data;
+  cached->size = size;
+  cached->mapped = mapped;
+
+  // the arrays point straight into the file's contents:
+  void* sections[7];
+  size_t offset = sizeof(struct CACHE_HEADER);
+  for (int i = 0; i < 7; i++) {
+    sections[i] = data + offset;
+    offset += (sizes[i] + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+  }
+
+  struct FLAT_PROGRAM* program = &cached->program;
+  program->stmts = (struct FLAT_STMT*)sections[0];
+  program->exprs = (struct FLAT_EXPR*)sections[1];
+  program->unaries = (struct FLAT_UNARY*)sections[2];
+  program->elements = (struct FLAT_ELEMENT*)sections[3];
+  program->calls = (struct FLAT_CALL*)sections[4];
+  program->names = (uint32_t*)sections[5];
+  program->strings = (char*)sections[6];
+
+  program->num_stmts = header.num_stmts;
+  program->num_exprs = header.num_exprs;
+  program->num_unaries = header.num_unaries;
+  program->num_elements = header.num_elements;
+  program->num_calls = header.num_calls;
+  program->num_slots = header.num_slots;
+  program->strings_size = header.strings_size;
+
+  if (!valid_program(program)) {
+    cache_close(program);
+    return NULL;
+  }
+
+  return program;
+}
+
+//
+// write_section
+//
+// Writes size bytes, padded with zeros to a multiple of CACHE_ALIGN,
+// and adds them to the hash in *hash. Returns false if the write
+// failed.
+//
+static bool write_section(FILE* file, void* data, size_t size, uint64_t* hash)
+{
+  static const char zeros[CACHE_ALIGN] = { 0 };
+  size_t padding = (CACHE_ALIGN - size % CACHE_ALIGN) % CACHE_ALIGN;
+
+  *hash = hash_bytes(hash_bytes(*hash, data, size), zeros, padding);
+
+  if (size > 0 && fwrite(data, 1, size, file) != size)
+    return false;
+  return fwrite(zeros, 1, padding, file) == padding;
+}
+
+//
+// cache_save
+//
+// Writes the flat program, compiled from the given source, out to
+// the given cache file. Returns false if the file could not be
+// written, in which case no (partial) cache file is left behind.
+//
+bool cache_save(char* path, struct FLAT_PROGRAM* program, char* source, size_t length, bool optimized)
+{
+  struct CACHE_HEADER header;
+  make_header(&header, program, source, length, optimized);
+
+  // written under another name, then renamed, so a reader never
+  // sees half a file:
+  char* temp = (char*)malloc(strlen(path) + 32);
+  if (temp == NULL)
+    return false;
+#if defined(CACHE_MMAP)
+  sprintf(temp, "%s.%ld.tmp", path, (long)getpid());
+#else
+  sprintf(temp, "%s.tmp", path);
+#endif
+
+  FILE* file = fopen(temp, "wb");
+  if (file == NULL) {
+    free(temp);
+    return false;
+  }
+
+  // the header goes first, but its hash covers what follows, so it
+  // is written again at the end:
+  uint64_t hash = FNV_OFFSET;
+  uint64_t ignored = FNV_OFFSET;
+
+  bool success = write_section(file, &header, sizeof(struct CACHE_HEADER), &ignored) &&
+    write_section(file, program->stmts, program->num_stmts * sizeof(struct FLAT_STMT), &hash) &&
+    write_section(file, program->exprs, program->num_exprs * sizeof(struct FLAT_EXPR), &hash) &&
+    write_section(file, program->unaries, program->num_unaries * sizeof(struct FLAT_UNARY), &hash) &&
+    write_section(file, program->elements, program->num_elements * sizeof(struct FLAT_ELEMENT), &hash) &&
+    write_section(file, program->calls, program->num_calls * sizeof(struct FLAT_CALL), &hash) &&
+    write_section(file, program->names, program->num_slots * sizeof(uint32_t), &hash) &&
+    write_section(file, program->strings, program->strings_size, &hash);
+
+  header.payload_hash = hash;
+  if (success)
+    success = (fseek(file, 0, SEEK_SET) == 0 &&
+               fwrite(&header, 1, sizeof(struct CACHE_HEADER), file) == sizeof(struct CACHE_HEADER));
+
+  if (fclose(file) != 0)
+    success = false;
+  if (success)
+    success = (rename(temp, path) == 0);
+  if (!success)
+    remove(temp);
+
+  free(temp);
+  return success;
+}
+
+//
+// cache_close
+//
+// Unmaps a program returned by cache_load.
+//
+void cache_close(struct FLAT_PROGRAM* program)
+{
+  if (program == NULL)
+    return;
+
+  struct CACHED_PROGRAM* cached = (struct CACHED_PROGRAM*)program;
+
+  unmap_file(cached->data, cached->size, cached->mapped);
+  free(cached);
+}
@@ -0,0 +1,75 @@
+/*cache.h*/
+
+//
+// Precompiled program cache for nuPython. The flat form of a program
+// (see flat.h) has no pointers, so it is written out as is, into a
+// .nupyc file next to the source (prog.py => prog.nupyc), after a
+// header holding a format version and a hash of the source text. On
+// the next run the file is memory-mapped and, if the header matches
+// the source, executed right away --- no scanning, parsing, building,
+// or optimizing (see -cache in main.c).
+//
+// A missing, stale, or damaged cache file is simply a miss; the cache
+// is then rewritten from the freshly compiled program.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+#include <stddef.h>   // size_t
+
+#include "flat.h"
+
+
+//
+// Public functions:
+//
+
+//
+// cache_read_source
+//
+// Reads the rest of the given input stream into a new buffer, which
+// the caller frees, and returns it; *length is set to its # of bytes.
+// Returns NULL if the stream cannot be read.
+//
+char* cache_read_source(FILE* input, size_t* length);
+
+//
+// cache_path
+//
+// Returns the name of the cache file for the given source file, as
+// a new string the caller frees: the .py is replaced by .nupyc (or
+// .nupyc is appended, if the name doesn't end in .py).
+//
+char* cache_path(char* filename);
+
+//
+// cache_load
+//
+// Maps the given cache file and returns the flat program in it, if
+// the file was written by this version of nuPython for exactly the
+// given source, with the optimizer on or off as given. Returns NULL
+// otherwise. The program is freed with cache_close, not flat_destroy.
+//
+struct FLAT_PROGRAM* cache_load(char* path, char* source, size_t length, bool optimized);
+
+//
+// cache_save
+//
+// Writes the flat program, compiled from the given source, out to
+// the given cache file. Returns false if the file could not be
+// written, in which case no (partial) cache file is left behind.
+//
+bool cache_save(char* path, struct FLAT_PROGRAM* program, char* source, size_t length, bool optimized);
+
+//
+// cache_close
+//
+// Unmaps a program returned by cache_load.
+//
+void cache_close(struct FLAT_PROGRAM* program);
@@ -0,0 +1,732 @@
+/*check.c*/
+
+//
+// Static semantic checks for nuPython bytecode (see check.h).
+//
+// The analysis is a forward dataflow over basic blocks. For every
+// variable (and VM register) the state holds the set of types its
+// value may have, as TYPE_ bits, plus TYPE_UNDEF if it may not have
+// been assigned yet. Blocks start at jump targets and after jumps;
+// the state entering a block is the union of the states leaving its
+// predecessors, and blocks are re-analyzed until no state changes.
+// Once the states are stable, each reachable block is walked one
+// last time to mark the safe instructions and report errors. Errors
+// are only reported in blocks that always run: a block every path
+// from the start to the end of the program passes through. A while
+// loop's body may never run, so its errors are not certain to happen.
+//
+// An instruction that fails stops the program, so anything that
+// follows it only runs if it succeeded: after x + 1, x is known to
+// be defined. An instruction that always fails ends its block.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "bytecode.h"
+#include "ram.h"
+#include "check.h"
+
+
+//
+// The types of value an operand may have, as bits. A pointer made by
+// &x always holds a valid address; one computed by pointer arithmetic
+// may not, so the two are kept apart:
+//
+#define TYPE_INT   0x01
+#define TYPE_REAL  0x02
+#define TYPE_STR   0x04
+#define TYPE_PTR   0x08  // pointer, the address may be invalid
+#define TYPE_BOOL  0x10
+#define TYPE_NONE  0x20
+#define TYPE_ADDR  0x40  // pointer to an existing variable
+#define TYPE_ANY   0x7F
+#define TYPE_UNDEF 0x80  // variable may not be defined yet
+
+#define TYPE_NUMBER  (TYPE_INT | TYPE_REAL)
+#define TYPE_POINTER (TYPE_PTR | TYPE_ADDR)
+
+//
+// The state of the analysis:
+//
+struct CHECKER
+{
+  struct BYTECODE* code;
+  int num_vars;  // # of slots + # of registers, the size of a state
+
+  bool* leader;            // true => instruction starts a basic block
+  unsigned char** entry;   // state entering each block, NULL => not reached
+  bool* pending;           // true => block must be (re-)analyzed
+  bool* always;            // true => block runs on every path through the program
+
+  bool final;              // true => last walk: mark and report
+  bool mark;
+  bool report;
+  bool certain;            // true => the block being walked always runs
+  int num_errors;
+};
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**CHECK ERROR\n");
+  printf("**CHECK ERROR: %s\n", msg);
+  printf("**CHECK ERROR\n");
+
+  exit(-123);
+}
+
+//
+// error
+//
+// Records an error that is certain to happen when the instruction
+// on the given line runs. The error is only counted (and reported)
+// if the instruction is certain to run too, i.e. its block always
+// runs. If name is not NULL, the error is that the variable is not
+// defined.
+//
+static void error(struct CHECKER* checker, char* msg, char* name, int line)
+{
+  if (!checker->final || !checker->certain)
+    return;
+
+  checker->num_errors++;
+
+  if (!checker->report)
+    return;
+  if (name != NULL)
+    printf("**STATIC ERROR: name '%s' is not defined (line %d)\n", name, line);
+  else
+    printf("**STATIC ERROR: %s (line %d)\n", msg, line);
+}
+
+//
+// constant_types
+//
+// Returns the TYPE_ bit of a constant pool entry.
+//
+static int constant_types(struct RAM_VALUE* value)
+{
+  switch (value->value_type) {
+  case RAM_TYPE_INT: return TYPE_INT;
+  case RAM_TYPE_REAL: return TYPE_REAL;
+  case RAM_TYPE_STR: return TYPE_STR;
+  case RAM_TYPE_BOOLEAN: return TYPE_BOOL;
+  default: return TYPE_NONE;
+  }
+}
+
+//
+// fetch_types
+//
+// Returns the TYPE_ bits of the values the operand may have when it
+// is fetched, or 0 if fetching it always fails (the error is recorded).
+// *safe is set to false if the fetch might fail.
+//
+static int fetch_types(struct CHECKER* checker, unsigned char* state, struct OPERAND operand, int line, bool* safe)
+{
+  struct BYTECODE* code = checker->code;
+
+  if (operand.kind == OPND_NONE)
+    return TYPE_NONE;
+  if (operand.kind == OPND_CONST)
+    return constant_types(&code->constants[operand.index]);
+  if (operand.kind == OPND_REG)
+    return state[code->symbols->num_slots + operand.index];
+
+  char* name = code->symbols->names[operand.index];
+  int types = state[operand.index];
+
+  if (types == TYPE_UNDEF) {
+    error(checker, NULL, name, line);
+    return 0;
+  }
+  if (types & TYPE_UNDEF)
+    *safe = false;
+  types &= ~TYPE_UNDEF;
+
+  if (operand.kind == OPND_ADDR)
+    return TYPE_ADDR;
+
+  if (operand.kind == OPND_DEREF) {
+    if (!(types & TYPE_POINTER)) {
+      error(checker, "invalid operand types", NULL, line);
+      return 0;
+    }
+    if (types != TYPE_ADDR)
+      *safe = false;
+    return TYPE_ANY;  // the cell pointed to could hold anything
+  }
+
+  return types;
+}
+
+//
+// refine
+//
+// Once an instruction has read an operand successfully, the variable
+// it names is known to be defined (and, for *p, to be a pointer).
+//
+static void refine(unsigned char* state, struct OPERAND operand)
+{
+  if (operand.kind == OPND_VAR || operand.kind == OPND_ADDR)
+    state[operand.index] &= ~TYPE_UNDEF;
+  else if (operand.kind == OPND_DEREF)
+    state[operand.index] &= TYPE_POINTER;
+}
+
+//
+// store_types
+//
+// Updates the state for a store of a value with the given types.
+// A store through a pointer could change any variable that exists.
+//
+static void store_types(struct CHECKER* checker, unsigned char* state, struct OPERAND dst, int types)
+{
+  int num_slots = checker->code->symbols->num_slots;
+
+  if (dst.kind == OPND_REG)
+    state[num_slots + dst.index] = (unsigned char)types;
+  else if (dst.kind == OPND_VAR)
+    state[dst.index] = (unsigned char)types;
+  else if (dst.kind == OPND_CELL) {
+    for (int slot = 0; slot < num_slots; slot++) {
+      if (state[slot] & ~TYPE_UNDEF)
+        state[slot] |= types;
+    }
+  }
+}
+
+//
+// pair_types
+//
+// Returns the type of lhs <opcode> rhs for one lhs type and one rhs
+// type, or 0 if the types are not supported. *safe is set to false
+// if the operation might fail anyway (division by zero).
+//
+static int pair_types(int opcode, int lhs, int rhs, bool nonzero_rhs, bool* safe)
+{
+  bool relational = (opcode >= OP_EQ && opcode <= OP_GTE);
+  bool division = (opcode == OP_DIV || opcode == OP_MOD);
+
+  if (opcode == OP_IS || opcode == OP_IN)
+    return 0;
+
+  if ((lhs & TYPE_NUMBER) && (rhs & TYPE_NUMBER)) {
+    bool ints = (lhs == TYPE_INT && rhs == TYPE_INT);
+    if (division && !nonzero_rhs && (opcode == OP_DIV || ints))  // real % 0 is fmod, no error
+      *safe = false;
+    if (relational)
+      return TYPE_BOOL;
+    return ints ? TYPE_INT : TYPE_REAL;
+  }
+
+  if (lhs == TYPE_STR && rhs == TYPE_STR) {
+    if (relational)
+      return TYPE_BOOL;
+    return (opcode == OP_ADD) ? TYPE_STR : 0;
+  }
+
+  if ((lhs & TYPE_POINTER) && rhs == TYPE_INT) {  // pointer arithmetic, always a pointer
+    if (division && !nonzero_rhs)
+      *safe = false;
+    return TYPE_PTR;
+  }
+
+  return 0;
+}
+
+//
+// binary_types
+//
+// Returns the types of lhs <opcode> rhs over every combination of
+// the possible operand types. *safe is set to false if any of them
+// might fail.
+//
+static int binary_types(int opcode, int lhs, int rhs, bool nonzero_rhs, bool* safe)
+{
+  int types = 0;
+
+  for (int l = 1; l <= TYPE_ADDR; l <<= 1) {
+    if (!(lhs & l))
+      continue;
+    for (int r = 1; r <= TYPE_ADDR; r <<= 1) {
+      if (!(rhs & r))
+        continue;
+      int result = pair_types(opcode, l, r, nonzero_rhs, safe);
+      if (result == 0)
+        *safe = false;
+      types |= result;
+    }
+  }
+
+  return types;
+}
+
+//
+// nonzero_constant
+//
+// Returns true if the operand is a numeric constant other than 0.
+//
+static bool nonzero_constant(struct BYTECODE* code, struct OPERAND operand)
+{
+  if (operand.kind != OPND_CONST)
+    return false;
+
+  struct RAM_VALUE* value = &code->constants[operand.index];
+  if (value->value_type == RAM_TYPE_INT)
+    return value->types.i != 0;
+  if (value->value_type == RAM_TYPE_REAL)
+    return value->types.d != 0.0;
+  return false;
+}
+
+//
+// check_binary
+//
+// Analyzes a binary instruction (including OP_APPEND). On the last
+// walk, a safe instruction is marked, and specialized if the types
+// of both operands are known exactly. Returns false if the
+// instruction always fails.
+//
+static bool check_binary(struct CHECKER* checker, struct INSTR* instr, unsigned char* state)
+{
+  bool safe = true;
+  int opcode = (instr->opcode == OP_APPEND) ? OP_ADD : instr->opcode;
+
+  // both operands are fetched (and errors reported) before stopping:
+  int lhs = fetch_types(checker, state, instr->a, instr->line, &safe);
+  int rhs = fetch_types(checker, state, instr->b, instr->line, &safe);
+  if (lhs == 0 || rhs == 0)
+    return false;
+  refine(state, instr->a);
+  refine(state, instr->b);
+
+  int types = binary_types(opcode, lhs, rhs, nonzero_constant(checker->code, instr->b), &safe);
+  if (types == 0) {
+    error(checker, "invalid operand types", NULL, instr->line);
+    return false;
+  }
+  store_types(checker, state, instr->dst, types);
+
+  if (checker->final && checker->mark && safe) {
+    instr->checked = true;
+
+    // an append of numbers (i = i + 1) is an ordinary add:
+    int type_lhs = (lhs == TYPE_INT) ? RAM_TYPE_INT : (lhs == TYPE_REAL) ? RAM_TYPE_REAL : -1;
+    int type_rhs = (rhs == TYPE_INT) ? RAM_TYPE_INT : (rhs == TYPE_REAL) ? RAM_TYPE_REAL : -1;
+    int quickened = bytecode_quickened_opcode(opcode, type_lhs, type_rhs);
+    if (quickened >= 0)
+      instr->opcode = quickened;
+  }
+
+  return true;
+}
+
+//
+// check_instr
+//
+// Analyzes one instruction, updating the state to what holds after
+// it runs. Returns false if the instruction always fails.
+//
+static bool check_instr(struct CHECKER* checker, struct INSTR* instr, unsigned char* state)
+{
+  bool safe = true;
+  int opcode = instr->opcode;
+  int types;
+
+  if ((opcode >= OP_ADD && opcode <= OP_APPEND) || (opcode >= OP_ADD_II && opcode <= OP_GTE_RR))
+    return check_binary(checker, instr, state);
+
+  switch (opcode) {
+  case OP_MOVE:
+  case OP_PRINT:
+  case OP_JUMP_IF_FALSE:
+    types = fetch_types(checker, state, instr->a, instr->line, &safe);
+    if (types == 0)
+      return false;
+    refine(state, instr->a);
+    if (opcode == OP_MOVE)
+      store_types(checker, state, instr->dst, types);
+    break;
+
+  case OP_INPUT:
+    // like the executor, a bad prompt is reported but input() goes on:
+    fetch_types(checker, state, instr->a, instr->line, &safe);
+    store_types(checker, state, instr->dst, TYPE_STR);
+    return true;
+
+  case OP_INT:
+  case OP_FLOAT:
+    types = fetch_types(checker, state, instr->a, instr->line, &safe);
+    if (types == 0)
+      return false;
+    if (!(types & TYPE_STR)) {
+      error(checker, (opcode == OP_INT) ? "invalid string for int()" : "invalid string for float()", NULL, instr->line);
+      return false;
+    }
+    refine(state, instr->a);
+    store_types(checker, state, instr->dst, (opcode == OP_INT) ? TYPE_INT : TYPE_REAL);
+    break;  // the string itself is checked at run-time
+
+  case OP_DEREF_TARGET:
+    types = state[instr->a.index];
+    if (types == TYPE_UNDEF) {
+      error(checker, NULL, checker->code->symbols->names[instr->a.index], instr->line);
+      return false;
+    }
+    if (!(types & TYPE_POINTER)) {
+      error(checker, "invalid operand types", NULL, instr->line);
+      return false;
+    }
+    safe = (types == TYPE_ADDR);
+    state[instr->a.index] &= TYPE_POINTER;
+    store_types(checker, state, instr->dst, TYPE_ADDR);
+    break;
+
+  default:  // jump, halt
+    return true;
+  }
+
+  if (checker->final && checker->mark && safe)
+    instr->checked = true;
+  return true;
+}
+
+//
+// join
+//
+// Merges a state into the state entering the block at index, and
+// schedules the block if that changed anything.
+//
+static void join(struct CHECKER* checker, int index, unsigned char* state)
+{
+  unsigned char* entry = checker->entry[index];
+
+  if (entry == NULL) {
+    entry = (unsigned char*)malloc(checker->num_vars);
+    if (entry == NULL)
+      panic("out of memory (join)");
+    memcpy(entry, state, checker->num_vars);
+    checker->entry[index] = entry;
+    checker->pending[index] = true;
+    return;
+  }
+
+  for (int v = 0; v < checker->num_vars; v++) {
+    unsigned char merged = entry[v] | state[v];
+    if (merged != entry[v]) {
+      entry[v] = merged;
+      checker->pending[index] = true;
+    }
+  }
+}
+
+//
+// successors
+//
+// Sets next[] to the blocks that may follow the block at index, and
+// returns how many there are (at most 2); the end of the program (a
+// halt, or falling off the last instruction) is index n. The jumps
+// are followed as written, whatever the conditions.
+//
+static int successors(struct CHECKER* checker, int index, int next[2])
+{
+  struct BYTECODE* code = checker->code;
+  int n = code->num_instrs;
+
+  for (int i = index; i < n; i++) {
+    int opcode = code->code[i].opcode;
+
+    if (i > index && checker->leader[i]) {
+      next[0] = i;
+      return 1;
+    }
+    if (opcode == OP_HALT) {
+      next[0] = n;
+      return 1;
+    }
+    if (opcode == OP_JUMP) {
+      next[0] = (code->code[i].target < n) ? code->code[i].target : n;
+      return 1;
+    }
+    if (opcode == OP_JUMP_IF_FALSE) {
+      next[0] = (code->code[i].target < n) ? code->code[i].target : n;
+      next[1] = i + 1;
+      return 2;
+    }
+  }
+
+  next[0] = n;
+  return 1;
+}
+
+//
+// find_always
+//
+// Marks the blocks that always run: those on every path from the
+// start to the end of the program, i.e. the dominators of the end.
+// The dominator tree is found with the iterative algorithm of Cooper,
+// Harvey and Kennedy, over the blocks in reverse postorder; since
+// while loops are the only cycles, it settles in a couple of passes.
+//
+static void find_always(struct CHECKER* checker)
+{
+  int n = checker->code->num_instrs;
+
+  int* order = (int*)malloc((n + 1) * sizeof(int));    // blocks in postorder
+  int* number = (int*)malloc((n + 1) * sizeof(int));   // postorder # of a block, -1 => not reached
+  int* idom = (int*)malloc((n + 1) * sizeof(int));     // immediate dominator, -1 => not yet known
+  int* stack = (int*)malloc((n + 1) * sizeof(int));
+  int* edge = (int*)malloc((n + 1) * sizeof(int));     // next successor to visit, per block on the stack
+  int* first = (int*)calloc(n + 2, sizeof(int));       // predecessors of block b: preds[first[b] .. first[b+1])
+  int* preds = (int*)malloc(2 * (n + 1) * sizeof(int));
+
+  if (order == NULL || number == NULL || idom == NULL || stack == NULL || edge == NULL || first == NULL || preds == NULL)
+    panic("out of memory (find_always)");
+
+  for (int b = 0; b <= n; b++) {
+    number[b] = -1;
+    idom[b] = -1;
+  }
+
+  //
+  // depth-first from the start, numbering the blocks in postorder:
+  //
+  int count = 0;
+  int top = 0;
+  stack[top++] = 0;
+  edge[0] = 0;
+  number[0] = -2;  // on the stack
+
+  while (top > 0) {
+    int b = stack[top - 1];
+    int next[2];
+    int num_next = (b == n) ? 0 : successors(checker, b, next);
+
+    if (edge[b] < num_next) {
+      int s = next[edge[b]++];
+      if (number[s] == -1) {
+        number[s] = -2;
+        edge[s] = 0;
+        stack[top++] = s;
+      }
+    }
+    else {
+      top--;
+      number[b] = count;
+      order[count++] = b;
+    }
+  }
+
+  if (number[n] >= 0) {  // the end can be reached
+    //
+    // the predecessors of each reached block:
+    //
+    for (int k = 0; k < count; k++) {
+      int next[2];
+      int b = order[k];
+      int num_next = (b == n) ? 0 : successors(checker, b, next);
+      for (int e = 0; e < num_next; e++)
+        first[next[e] + 1]++;
+    }
+    for (int b = 0; b <= n; b++)
+      first[b + 1] += first[b];
+    for (int b = 0; b <= n; b++)
+      edge[b] = first[b];  // where the next predecessor of b goes
+    for (int k = 0; k < count; k++) {
+      int next[2];
+      int b = order[k];
+      int num_next = (b == n) ? 0 : successors(checker, b, next);
+      for (int e = 0; e < num_next; e++)
+        preds[edge[next[e]]++] = b;
+    }
+
+    idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (int k = count - 1; k >= 0; k--) {  // reverse postorder
+        int b = order[k];
+        if (b == 0)
+          continue;
+
+        int dom = -1;
+        for (int p = first[b]; p < first[b + 1]; p++) {
+          int pred = preds[p];
+          if (idom[pred] == -1)
+            continue;
+          if (dom == -1) {
+            dom = pred;
+            continue;
+          }
+          int x = pred, y = dom;  // the nearest common dominator:
+          while (x != y) {
+            while (number[x] < number[y])
+              x = idom[x];
+            while (number[y] < number[x])
+              y = idom[y];
+          }
+          dom = x;
+        }
+
+        if (dom != idom[b]) {
+          idom[b] = dom;
+          changed = true;
+        }
+      }
+    }
+
+    for (int b = idom[n]; ; b = idom[b]) {
+      checker->always[b] = true;
+      if (b == 0)
+        break;
+    }
+  }
+
+  free(order);
+  free(number);
+  free(idom);
+  free(stack);
+  free(edge);
+  free(first);
+  free(preds);
+}
+
+//
+// check_block
+//
+// Walks the basic block starting at index, from its entry state,
+// passing the state on to the blocks that may follow it.
+//
+static void check_block(struct CHECKER* checker, int index, unsigned char* state)
+{
+  struct BYTECODE* code = checker->code;
+
+  memcpy(state, checker->entry[index], checker->num_vars);
+  checker->certain = checker->always[index];
+
+  for (int i = index; i < code->num_instrs; i++) {
+    struct INSTR* instr = &code->code[i];
+
+    if (i > index && checker->leader[i]) {  // falls into the next block
+      join(checker, i, state);
+      return;
+    }
+
+    if (!check_instr(checker, instr, state))
+      return;  // always fails, nothing after it runs
+
+    if (instr->opcode == OP_JUMP) {
+      join(checker, instr->target, state);
+      return;
+    }
+    if (instr->opcode == OP_JUMP_IF_FALSE)
+      join(checker, instr->target, state);
+    if (instr->opcode == OP_HALT)
+      return;
+  }
+}
+
+//
+// check_program
+//
+// Analyzes the given bytecode. If mark is true, proven-safe
+// instructions are marked as checked (and specialized where
+// possible). If report is true, the errors that are certain to
+// happen --- in code that always runs --- are output, with their line
+// numbers. Returns the # of errors reported (0 unless report is true).
+//
+int check_program(struct BYTECODE* code, bool mark, bool report)
+{
+  if (code == NULL)
+    panic("code is NULL (check_program)");
+
+  int n = code->num_instrs;
+  int num_slots = code->symbols->num_slots;
+
+  struct CHECKER checker;
+  checker.code = code;
+  checker.num_vars = num_slots + code->num_registers;
+  checker.leader = (bool*)calloc(n + 1, sizeof(bool));
+  checker.entry = (unsigned char**)calloc(n + 1, sizeof(unsigned char*));
+  checker.pending = (bool*)calloc(n + 1, sizeof(bool));
+  checker.always = (bool*)calloc(n + 1, sizeof(bool));
+  checker.final = false;
+  checker.mark = mark;
+  checker.report = report;
+  checker.certain = false;
+  checker.num_errors = 0;
+
+  unsigned char* state = (unsigned char*)malloc(checker.num_vars + 1);
+
+  if (checker.leader == NULL || checker.entry == NULL || checker.pending == NULL || checker.always == NULL || state == NULL)
+    panic("out of memory (check_program)");
+
+  //
+  // basic blocks start at jump targets, and after jumps:
+  //
+  for (int i = 0; i < n; i++) {
+    int opcode = code->code[i].opcode;
+    if (opcode == OP_JUMP || opcode == OP_JUMP_IF_FALSE) {
+      checker.leader[code->code[i].target] = true;
+      checker.leader[i + 1] = true;
+    }
+  }
+
+  //
+  // at the start, no variable is defined and the registers are None:
+  //
+  for (int v = 0; v < checker.num_vars; v++)
+    state[v] = (v < num_slots) ? TYPE_UNDEF : TYPE_NONE;
+  checker.leader[0] = true;
+  join(&checker, 0, state);
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = 0; i < n; i++) {
+      if (checker.pending[i]) {
+        checker.pending[i] = false;
+        check_block(&checker, i, state);
+        changed = true;
+      }
+    }
+  }
+
+  //
+  // only the errors in blocks that always run are reported:
+  //
+  if (report)
+    find_always(&checker);
+
+  //
+  // the states are stable, one last walk to mark and report:
+  //
+  checker.final = true;
+  for (int i = 0; i < n; i++) {
+    if (checker.entry[i] != NULL)
+      check_block(&checker, i, state);
+  }
+
+  for (int i = 0; i <= n; i++)
+    free(checker.entry[i]);
+  free(checker.entry);
+  free(checker.leader);
+  free(checker.pending);
+  free(checker.always);
+  free(state);
+
+  return checker.num_errors;
+}
@@ -0,0 +1,46 @@
+/*check.h*/
+
+//
+// Static semantic checks for nuPython bytecode, run after compilation
+// and before the VM. A flow-sensitive analysis follows the possible
+// types of every variable (and whether it is defined yet) through the
+// straight-line code and around while loops, until nothing changes.
+//
+// Instructions that are proven safe --- every operand is defined, of
+// a type the operation supports, and pointers hold valid addresses ---
+// are marked as checked, and the VM then runs them without any of its
+// run-time checks. Binary instructions whose operand types are known
+// exactly are also specialized up front (e.g. OP_ADD_II), instead of
+// waiting for the VM to quicken them.
+//
+// Errors that are certain to happen, such as reading a variable that
+// is never assigned before it, can be reported up front --- in code
+// that always runs, not in a while loop's body, which may not. The VM still reports them when they happen, so
+// checking never changes what a program outputs.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "bytecode.h"
+
+
+//
+// Public functions:
+//
+
+//
+// check_program
+//
+// Analyzes the given bytecode. If mark is true, proven-safe
+// instructions are marked as checked (and specialized where
+// possible). If report is true, the errors that are certain to
+// happen, in code that always runs, are output with their line
+// numbers. Returns the # of errors reported (0 unless report is true).
+//
+int check_program(struct BYTECODE* code, bool mark, bool report);
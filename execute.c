@@ -28,10 +28,14 @@
 #include <string.h>
 #include <assert.h>
 #include <math.h> 
+#include <stdint.h>  // uintptr_t
 
 #include "programgraph.h"
 #include "ram.h"
+#include "rstring.h"
 #include "execute.h"
+#include "output.h"
+#include "input.h"
 
 
 // **IMPORTANT
@@ -45,6 +49,131 @@ typedef union {
     char* s;   
 } ResultUnion;
 
+// 
+// Numeric literals are decoded (atoi/atof) once, before execution, by decode_literals. The decoded values are kept in 
+// a hash table keyed by the literal's ELEMENT node, so evaluating a literal in a loop is a table lookup instead of 
+// re-parsing its string every time. The table lives for one call to execute() 
+//
+struct LITERAL {
+  struct ELEMENT* element; // NULL => empty bucket 
+  ResultUnion value; 
+};
+
+static struct LITERAL* literals = NULL; 
+static int literals_size = 0; // always a power of 2 
+static int literals_count = 0; 
+
+//
+// literal_bucket
+//
+// Returns the bucket of the literals table holding the given element, or the empty bucket where it would be inserted 
+//
+static int literal_bucket(struct ELEMENT* element) {
+  unsigned int mask = literals_size - 1; 
+  unsigned int bucket = (unsigned int)(((uintptr_t)element >> 4) * 2654435761u) & mask; 
+  while (literals[bucket].element!=NULL && literals[bucket].element!=element) {
+    bucket = (bucket + 1) & mask; // linear probing 
+  }
+  return bucket; 
+}
+
+//
+// add_literal
+//
+// Decodes an int or real literal and adds it to the literals table (growing the table to stay at most half full) 
+// Any other kind of element is ignored 
+//
+static void add_literal(struct ELEMENT* element) {
+  if (element==NULL || (element->element_type!=ELEMENT_INT_LITERAL && element->element_type!=ELEMENT_REAL_LITERAL)) {
+    return; 
+  }
+  if ((literals_count+1)*2 > literals_size) {
+    struct LITERAL* old = literals; 
+    int old_size = literals_size; 
+    literals_size = (old_size==0) ? 64 : 2*old_size; 
+    literals = (struct LITERAL*)calloc(literals_size, sizeof(struct LITERAL)); 
+    if (literals==NULL) {
+      printf("**EXECUTION ERROR: out of memory (add_literal)\n"); 
+      exit(-1); 
+    }
+    for (int i = 0; i < old_size; i++) {
+      if (old[i].element!=NULL) {
+        literals[literal_bucket(old[i].element)] = old[i]; 
+      }
+    }
+    free(old); 
+  }
+  int bucket = literal_bucket(element); 
+  if (literals[bucket].element==NULL) {
+    literals[bucket].element = element; 
+    if (element->element_type==ELEMENT_INT_LITERAL) {
+      literals[bucket].value.i = atoi(element->element_value); 
+    } else {
+      literals[bucket].value.d = atof(element->element_value); 
+    }
+    literals_count++; 
+  }
+}
+
+//
+// decode_literals
+//
+// Pre-pass that decodes every numeric literal in the statements from stmt until stop (or the end of the program): 
+// expression operands and print parameters. The last stmt of a loop body links back to the loop, which is where the 
+// body stops 
+//
+static void decode_literals(struct STMT* stmt, struct STMT* stop) {
+  while (stmt!=NULL && stmt!=stop) {
+    if (stmt->stmt_type==STMT_ASSIGNMENT) {
+      struct VALUE* rhs = stmt->types.assignment->rhs; 
+      if (rhs->value_type==VALUE_EXPR) {
+        struct EXPR* expr = rhs->types.expr; 
+        add_literal(expr->lhs->element); 
+        if (expr->isBinaryExpr && expr->rhs!=NULL) {
+          add_literal(expr->rhs->element); 
+        }
+      }
+      stmt=stmt->types.assignment->next_stmt; 
+    } else if (stmt->stmt_type==STMT_FUNCTION_CALL) {
+      add_literal(stmt->types.function_call->parameter); 
+      stmt=stmt->types.function_call->next_stmt; 
+    } else if (stmt->stmt_type==STMT_WHILE_LOOP) {
+      struct EXPR* condition = stmt->types.while_loop->condition; 
+      add_literal(condition->lhs->element); 
+      if (condition->isBinaryExpr && condition->rhs!=NULL) {
+        add_literal(condition->rhs->element); 
+      }
+      decode_literals(stmt->types.while_loop->loop_body, stmt); 
+      stmt=stmt->types.while_loop->next_stmt; 
+    } else if (stmt->stmt_type==STMT_PASS) {
+      stmt=stmt->types.pass->next_stmt; 
+    } else {
+      return; // execution stops here anyway 
+    }
+  }
+}
+
+//
+// literal_value
+//
+// Returns the decoded value of an int or real literal, decoding it on the spot if the pre-pass did not see it 
+//
+static ResultUnion literal_value(struct ELEMENT* element) {
+  if (literals_size > 0) {
+    int bucket = literal_bucket(element); 
+    if (literals[bucket].element==element) {
+      return literals[bucket].value; 
+    }
+  }
+  ResultUnion value; 
+  if (element->element_type==ELEMENT_INT_LITERAL) {
+    value.i = atoi(element->element_value); 
+  } else {
+    value.d = atof(element->element_value); 
+  }
+  return value; 
+}
+
 //
 // retrieve_value
 //
@@ -52,6 +181,7 @@ typedef union {
 // Used to decrypt both the lhs and rhs expressions - deals with all types: 
 // int, real, str, identifier, ptr
 // Called in execute_binary_expression to compute lhs and rhs of binary expression 
+// Values are borrowed from memory (no copies are made), so a string result is only valid until the next memory write
 // Returns false if semantic error (identifier not found in RAM), else true
 //
 bool retrieve_value(struct UNARY_EXPR* expr, ResultUnion* result, int* type, struct RAM* memory, int line) {
@@ -59,20 +189,18 @@ bool retrieve_value(struct UNARY_EXPR* expr, ResultUnion* result, int* type, str
   char* string_value = expr->element->element_value; 
   int expr_type = expr->element->element_type; 
   if (expr_type==ELEMENT_INT_LITERAL) {
-    int num = atoi(string_value); 
-    result->i=num; 
+    result->i=literal_value(expr->element).i; // decoded once, before execution 
     *type=RAM_TYPE_INT; 
   } else if (expr_type==ELEMENT_REAL_LITERAL) {
-    double num = atof(string_value); 
-    result->d=num;  
+    result->d=literal_value(expr->element).d;  
     *type=RAM_TYPE_REAL; 
   } else if (expr_type==ELEMENT_STR_LITERAL) {
     result->s=string_value; 
     *type=RAM_TYPE_STR; 
   } else if (expr_type==ELEMENT_IDENTIFIER) {
-    struct RAM_VALUE* cell_ram_value; 
+    const struct RAM_VALUE* cell_ram_value; 
     if (expr->expr_type==UNARY_PTR_DEREF) { // handle ptr deref case, first get address that identifier is binded to, then use address to get actual value
-      struct RAM_VALUE* address_val = ram_read_cell_by_name(memory, string_value); 
+      const struct RAM_VALUE* address_val = ram_peek_cell_by_name(memory, string_value); 
       if (address_val==NULL) {
         printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", string_value, line);
         return false;   
@@ -82,7 +210,7 @@ bool retrieve_value(struct UNARY_EXPR* expr, ResultUnion* result, int* type, str
         return false; 
       }
       int address = address_val->types.i; 
-      struct RAM_VALUE* pointer_deref_ram_value = ram_read_cell_by_addr(memory, address); 
+      const struct RAM_VALUE* pointer_deref_ram_value = ram_peek_cell_by_addr(memory, address); 
       if (pointer_deref_ram_value==NULL) {
         printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", string_value, line); 
         return false; 
@@ -90,7 +218,7 @@ bool retrieve_value(struct UNARY_EXPR* expr, ResultUnion* result, int* type, str
       cell_ram_value = pointer_deref_ram_value; // the cell is given by following the pointer 
     }
     if (expr->expr_type!=UNARY_PTR_DEREF) { // for all other cases, i.e. <unary_expr>=<element> 
-      cell_ram_value = ram_read_cell_by_name(memory, string_value); 
+      cell_ram_value = ram_peek_cell_by_name(memory, string_value); 
       if (cell_ram_value==NULL) {
         printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", string_value, line);
         return false; 
@@ -154,6 +282,10 @@ bool operator_int_evaluate(struct EXPR* expr, int result_lhs, int result_rhs, in
     res = result_lhs / result_rhs; 
     *type=RAM_TYPE_INT;
   } else if (operator==OPERATOR_MOD) {
+    if (result_rhs==0) {
+      printf("**SEMANTIC ERROR: ZeroDivisionError: integer modulo by zero (line %d)\n", line);
+      return false; 
+    }
     res = result_lhs % result_rhs; 
     *type=RAM_TYPE_INT;
   } else if (operator==OPERATOR_POWER) {
@@ -258,14 +390,10 @@ bool operator_real_evaluate(struct EXPR* expr, double result_lhs, double result_
 bool operator_str_concat_evaluate(struct EXPR* expr, char* result_lhs, char* result_rhs, ResultUnion* result_string_operation, int* type, int line) {
   int operator = expr->operator; 
   int str_comp = strcmp(result_lhs, result_rhs); // compares the left and right strings: neg if l<r, 0 if l==r, and 1 if l>r
-  if (operator==OPERATOR_PLUS) { // string concatenation case, malloc enough space (l+r+1) for the new string, then fill in chars with strcpy
-    size_t length_lhs = strlen(result_lhs); 
-    size_t length_rhs = strlen(result_rhs);
-    int concat_length = length_lhs + length_rhs + 1; 
-    char* concat = (char*)malloc(concat_length*sizeof(char)); 
-    strcpy(concat, result_lhs); 
-    strcat(concat, result_rhs); 
-    result_string_operation->s=concat; 
+  if (operator==OPERATOR_PLUS) { // string concatenation case, the result is a new refcounted string (see rstring.h) owned by the caller
+    int length_lhs = strlen(result_lhs); 
+    int length_rhs = strlen(result_rhs);
+    result_string_operation->s=rstr_concat(result_lhs, length_lhs, result_rhs, length_rhs); 
     *type=RAM_TYPE_STR; 
   } else if (operator==OPERATOR_EQUAL) { // use str_comp (result of strcmp) to evaluate string comparison boolean logic, return result and type (either str or bool) to caller
     result_string_operation->i = (str_comp==0) ? 1 : 0; 
@@ -403,20 +531,22 @@ bool execute_binary_expression(struct EXPR* expr, ResultUnion* result, int* resu
 // execute_unary_expression 
 //
 // Executes unary expression - figures out type of expresion and appropriately assigns resulting value to the result union. 
-// Handles int, str, real, boolean, identifier literals + ptr
+// Handles int, str, real, boolean, identifier literals + ptr. Like retrieve_value, identifiers are read with the borrowed
+// (ram_peek) API. A str result is an rstring the caller owns a reference to: a copy of a literal, or the string in memory
+// with its refcount bumped (so y = x shares x's string instead of copying it)
 //
 bool execute_unary_expression(struct EXPR* expr, struct RAM* memory, char* string_rhs, ResultUnion* result, int* result_type, int line, bool is_address, bool is_pointer_deref) {
   // evaluate int, str, real, true, false, and identifier cases
   int assignment_type = expr->lhs->element->element_type; 
   if (assignment_type==ELEMENT_INT_LITERAL) {
-    int num = atoi(string_rhs); 
+    int num = literal_value(expr->lhs->element).i; // decoded once, before execution 
     result->i=num; 
     *result_type=RAM_TYPE_INT; 
   } else if (assignment_type==ELEMENT_STR_LITERAL) {
-    result->s=string_rhs; 
+    result->s=rstr_from(string_rhs); 
     *result_type=RAM_TYPE_STR; 
   } else if (assignment_type==ELEMENT_REAL_LITERAL) {
-    double num = atof(string_rhs); 
+    double num = literal_value(expr->lhs->element).d; 
     result->d=num; 
     *result_type=RAM_TYPE_REAL; 
   } else if (assignment_type==ELEMENT_TRUE) {
@@ -426,7 +556,7 @@ bool execute_unary_expression(struct EXPR* expr, struct RAM* memory, char* strin
     result->i=0; 
     *result_type=RAM_TYPE_BOOLEAN; 
   } else if (assignment_type==ELEMENT_IDENTIFIER) {
-    struct RAM_VALUE* val; 
+    const struct RAM_VALUE* val; 
     if (is_address) { // x=&y case (ptr), type is now of ptr and value is the addr of the rhs identifier (using ram_get_addr)
       int address = ram_get_addr(memory, string_rhs); 
       if (address==-1) {
@@ -439,7 +569,7 @@ bool execute_unary_expression(struct EXPR* expr, struct RAM* memory, char* strin
       return true; 
     }
     if (is_pointer_deref) { //handle ptr deref case, first get address that identifier is binded to, then use address to get actual value, handling three potential semantic error cases
-      struct RAM_VALUE* address_val = ram_read_cell_by_name(memory, string_rhs); 
+      const struct RAM_VALUE* address_val = ram_peek_cell_by_name(memory, string_rhs); 
       if (address_val==NULL) {
         printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", string_rhs, line);
         return false;   
@@ -449,7 +579,7 @@ bool execute_unary_expression(struct EXPR* expr, struct RAM* memory, char* strin
         return false; 
       }
       int address = address_val->types.i; 
-      struct RAM_VALUE* pointer_deref_ram_value = ram_read_cell_by_addr(memory, address); 
+      const struct RAM_VALUE* pointer_deref_ram_value = ram_peek_cell_by_addr(memory, address); 
       if (pointer_deref_ram_value==NULL) {
         printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", string_rhs, line); 
         return false; 
@@ -457,7 +587,7 @@ bool execute_unary_expression(struct EXPR* expr, struct RAM* memory, char* strin
       val=pointer_deref_ram_value; 
     }
     if (!is_pointer_deref) { //
-      val = ram_read_cell_by_name(memory, string_rhs); 
+      val = ram_peek_cell_by_name(memory, string_rhs); 
       if (val==NULL) {
         printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", string_rhs, line);
         return false; 
@@ -472,7 +602,7 @@ bool execute_unary_expression(struct EXPR* expr, struct RAM* memory, char* strin
       result->d=val->types.d; 
       *result_type=RAM_TYPE_REAL; 
     } else if (ram_type==RAM_TYPE_STR) {
-      result->s=val->types.s; 
+      result->s=rstr_retain(val->types.s); 
       *result_type=RAM_TYPE_STR;
     } else if( ram_type==RAM_TYPE_BOOLEAN) {
       result->i=val->types.i; 
@@ -487,6 +617,7 @@ bool execute_unary_expression(struct EXPR* expr, struct RAM* memory, char* strin
 //
 // Executes ANY expression, conditionally determines whether to execute_binary_expression or execute_unary_expression 
 // based on expression type, returns result and result_type back to caller (execute_assignment)
+// A str result is an rstring (see rstring.h) that the caller must rstr_release
 //
 bool execute_expression(struct EXPR* expr, struct RAM* memory, ResultUnion* result_main, int* result_type_main, int line) {
   // Encapsulates binary expression and unary expression, captures value and type of evaluation result and returns to caller which is execute_assignment!
@@ -533,24 +664,20 @@ bool execute_expression(struct EXPR* expr, struct RAM* memory, ResultUnion* resu
 //
 // execute_input
 //
-// Handles the input function, taking the user input, allocating space for it, and then writing this string value 
-// to memory via a RAM_VALUE 
+// Handles the input function, taking the user input and writing this string value to memory via a RAM_VALUE 
+// (the line is read as an rstring, which memory shares rather than copies)
 //
 void execute_input(struct VALUE* rhs, struct RAM* memory, char* var_name) {
     struct FUNCTION_CALL* func = rhs->types.function_call; 
     char* func_name = func->function_name; 
     printf("%s", func->parameter->element_value); //get user input 
+    output_flush(); // the prompt, and everything printed so far, before waiting on the user
 
-    char line[256]; 
-    fgets(line, sizeof(line), stdin); 
-    line[strcspn(line, "\r\n")] = '\0';
-
-    char* input_string = (char*)malloc(sizeof(line)+1); // malloc space for input string 
-    strcpy(input_string, line); 
     struct RAM_VALUE i; 
-    i.types.s=input_string; 
+    i.types.s=input_string(); 
     i.value_type=RAM_TYPE_STR; 
-    ram_write_cell_by_name(memory, i, var_name); // construct ram value of type str with the input string and write to memory 
+    ram_share_cell_by_name(memory, i, var_name); // construct ram value of type str with the input string and write to memory 
+    rstr_release(i.types.s); 
 }
 
 //
@@ -561,7 +688,7 @@ void execute_input(struct VALUE* rhs, struct RAM* memory, char* var_name) {
 //
 bool execute_int(struct VALUE* rhs, struct RAM* memory, char* var_name, int line) {
   char* identifier = rhs->types.function_call->parameter->element_value;
-  struct RAM_VALUE* ram_return_value = ram_read_cell_by_name(memory, identifier); 
+  const struct RAM_VALUE* ram_return_value = ram_peek_cell_by_name(memory, identifier); 
   struct RAM_VALUE i; 
   char* string_val = ram_return_value->types.s; // extract string value from identifier and then convert to integer
   int string_to_num = atoi(string_val); 
@@ -584,7 +711,7 @@ bool execute_int(struct VALUE* rhs, struct RAM* memory, char* var_name, int line
 //
 bool execute_real(struct VALUE* rhs, struct RAM* memory, char* var_name, int line) {
   char* identifier = rhs->types.function_call->parameter->element_value;
-  struct RAM_VALUE* ram_return_value = ram_read_cell_by_name(memory, identifier); 
+  const struct RAM_VALUE* ram_return_value = ram_peek_cell_by_name(memory, identifier); 
   struct RAM_VALUE i; 
   char* string_val = ram_return_value->types.s; // extract string value from identifier and then convert to real
   double string_to_real = atof(string_val); 
@@ -649,6 +776,46 @@ struct RAM_VALUE create_ram_value (ResultUnion result, int result_type) {
   return i; // create and return ram value to helper 
 }
 
+//
+// execute_self_append
+//
+// Handles the string-building assignment x = x + <str>, where x holds a string and the rhs is a str literal or an 
+// identifier holding a string. The rhs is appended to x's string in place (see ram_append_cell_by_addr), so a loop of 
+// appends is amortized O(1) per append instead of copying all of x every time 
+// Returns true if the append was done, false if the assignment is not of this form (nothing is output, and the caller 
+// executes it as usual, which also reports any semantic errors)
+//
+bool execute_self_append(struct EXPR* expr, struct RAM* memory, char* var_name) {
+  if (!expr->isBinaryExpr || expr->operator!=OPERATOR_PLUS || expr->rhs==NULL) {
+    return false; 
+  }
+  struct ELEMENT* lhs = expr->lhs->element; 
+  struct ELEMENT* rhs = expr->rhs->element; 
+  if (expr->lhs->expr_type!=UNARY_ELEMENT || lhs->element_type!=ELEMENT_IDENTIFIER || strcmp(lhs->element_value, var_name)!=0) {
+    return false; // not x = x + ...
+  }
+  int address = ram_get_addr(memory, var_name); 
+  const struct RAM_VALUE* lhs_value = ram_peek_cell_by_addr(memory, address); 
+  if (lhs_value==NULL || lhs_value->value_type!=RAM_TYPE_STR || expr->rhs->expr_type!=UNARY_ELEMENT) {
+    return false; 
+  }
+  if (rhs->element_type==ELEMENT_STR_LITERAL) {
+    ram_append_cell_by_addr(memory, rhs->element_value, strlen(rhs->element_value), address); 
+    return true; 
+  }
+  if (rhs->element_type==ELEMENT_IDENTIFIER) {
+    const struct RAM_VALUE* rhs_value = ram_peek_cell_by_name(memory, rhs->element_value); 
+    if (rhs_value==NULL || rhs_value->value_type!=RAM_TYPE_STR) {
+      return false; 
+    }
+    char* tail = rstr_retain(rhs_value->types.s); // retained in case it is x's own string (x = x + x) 
+    ram_append_cell_by_addr(memory, tail, rstr_length(tail), address); 
+    rstr_release(tail); 
+    return true; 
+  }
+  return false; 
+}
+
 //
 // execute_assignment
 //
@@ -668,7 +835,7 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory) {
   struct VALUE* rhs = stmt->types.assignment->rhs; 
 
   if (isPtrDeref) { //PtrDeref case, the lhs var_name is now achieved through following the pointer and getting the identifier of the cell the pointer references, handles three semantic error cases
-    struct RAM_VALUE* address_val = ram_read_cell_by_name(memory, var_name); 
+    const struct RAM_VALUE* address_val = ram_peek_cell_by_name(memory, var_name); 
       if (address_val==NULL) {
         printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", var_name, line);
         return false;   
@@ -678,7 +845,7 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory) {
         return false; 
       }
       int address = address_val->types.i; 
-      struct RAM_VALUE* pointer_deref_ram_value = ram_read_cell_by_addr(memory, address); 
+      const struct RAM_VALUE* pointer_deref_ram_value = ram_peek_cell_by_addr(memory, address); 
       if (pointer_deref_ram_value==NULL) {
         printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", var_name, line); 
         return false; 
@@ -686,6 +853,10 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory) {
       var_name = memory->cells[address].identifier; 
   }
 
+  if (rhs->value_type==VALUE_EXPR && !isPtrDeref && execute_self_append(rhs->types.expr, memory, var_name)) {
+    return true; // x = x + <str> was appended in place 
+  }
+
   if (rhs->value_type==VALUE_EXPR) { // expression case
     struct EXPR* expr = rhs->types.expr; 
     ResultUnion result_main; 
@@ -695,7 +866,10 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory) {
       return false; 
     }
     struct RAM_VALUE i = create_ram_value(result_main, result_type_main); // create ram value from result anda type
-    ram_write_cell_by_name(memory, i, var_name); // finally, write assignment result to memory! note: the lhs var_name is handled for pointer-based assignment as in the isPtrDeref branch
+    ram_share_cell_by_name(memory, i, var_name); // finally, write assignment result to memory! note: the lhs var_name is handled for pointer-based assignment as in the isPtrDeref branch
+    if (result_type_main==RAM_TYPE_STR) {
+      rstr_release(i.types.s); // memory holds its own reference to the string
+    }
 
   } else if (rhs->value_type==VALUE_FUNCTION_CALL) { // function case
     struct FUNCTION_CALL* func_call=rhs->types.function_call; 
@@ -720,49 +894,47 @@ bool execute_function_call(struct STMT* stmt, struct RAM* memory) {
   // STRICTLY FOR THE PRINT FUNCTION
   struct ELEMENT* element = stmt->types.function_call->parameter; 
   if (element==NULL) {
-    printf("\n"); 
+    output_newline(); 
     return true; 
   }
   int line = stmt->line; 
   int elem_type = element->element_type; 
 
     if (elem_type==ELEMENT_INT_LITERAL) { // handle different print cases, int, real, str, true, false, and identifier 
-    char* str_literal = element->element_value;
-    int num = atoi(str_literal); 
-    printf("%d\n", num);
+    int num = literal_value(element).i; 
+    output_int(num);
   } else if (elem_type == ELEMENT_REAL_LITERAL) {
-    char* str_literal = element->element_value;
-    double num = atof(str_literal); 
-    printf("%f\n", num); 
+    double num = literal_value(element).d; 
+    output_real(num); 
   } else if (elem_type==ELEMENT_STR_LITERAL) { 
     char* str_literal = element->element_value; 
-    printf("%s\n", str_literal); 
+    output_string(str_literal); 
   } else if (elem_type==ELEMENT_TRUE) {
-    printf("True\n");
+    output_string("True");
   } else if (elem_type==ELEMENT_FALSE) {
-    printf("False\n");
+    output_string("False");
   } else if (elem_type==ELEMENT_IDENTIFIER) { // identifier for print encapsulates real, int, str, boolean, and ptr cases
     char* identifier = element->element_value;  
-    struct RAM_VALUE* cell_ram_value = ram_read_cell_by_name(memory, identifier); 
+    const struct RAM_VALUE* cell_ram_value = ram_peek_cell_by_name(memory, identifier); 
     if (cell_ram_value==NULL) {
       printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", identifier, line); 
       return false; 
     }
     int ram_type = cell_ram_value->value_type; 
     if (ram_type==RAM_TYPE_REAL) {
-      printf("%f\n", cell_ram_value->types.d);
+      output_real(cell_ram_value->types.d);
     } else if (ram_type==RAM_TYPE_INT) {
-        printf("%d\n", cell_ram_value->types.i);
+        output_int(cell_ram_value->types.i);
     } else if (ram_type==RAM_TYPE_STR) {
-      printf("%s\n", cell_ram_value->types.s);
+      output_string(cell_ram_value->types.s);
     } else if (ram_type==RAM_TYPE_BOOLEAN) {
       if (cell_ram_value->types.i==1) {
-        printf("True\n");
+        output_string("True");
       } else {
-        printf("False\n"); 
+        output_string("False"); 
       }
     } else if (ram_type==RAM_TYPE_PTR) {
-      printf("%d\n", cell_ram_value->types.i); 
+      output_int(cell_ram_value->types.i); 
     }
   } 
   return true; 
@@ -784,17 +956,19 @@ void execute(struct STMT* program, struct RAM* memory)
 {
   struct STMT* stmt = program; 
 
+  decode_literals(program, NULL); // numeric literals are parsed once, up front 
+
   while (stmt!=NULL) {
     if (stmt->stmt_type==STMT_ASSIGNMENT) {
       bool success = execute_assignment(stmt, memory); // assignment case, (rhs is either an expression-unary/binary OR a function call to input, real, float)
       if (!success) {
-        return; 
+        break; // semantic error, stop execution 
       }
       stmt=stmt->types.assignment->next_stmt; 
     } else if (stmt->stmt_type==STMT_FUNCTION_CALL) {
       bool success = execute_function_call(stmt, memory); // STRICTLY for print function 
       if (!success) {
-        return; 
+        break; // semantic error, stop execution 
       }
       stmt=stmt->types.function_call->next_stmt; 
     } else if (stmt->stmt_type==STMT_WHILE_LOOP) {
@@ -807,9 +981,12 @@ void execute(struct STMT* program, struct RAM* memory)
       int result_type; 
       bool success = execute_expression(while_loop_condition, memory, &result_while_loop, &result_type, stmt->line); 
       if (!success) {
-        return; 
+        break; // semantic error, stop execution 
       }
       bool condition = ((result_type==RAM_TYPE_BOOLEAN || result_type==RAM_TYPE_INT) && result_while_loop.i!=0); 
+      if (result_type==RAM_TYPE_STR) {
+        rstr_release(result_while_loop.s); // a str condition is false, but the caller still owns the string 
+      }
       if (condition) {
         stmt=while_loop->loop_body; 
       } else {
@@ -819,4 +996,9 @@ void execute(struct STMT* program, struct RAM* memory)
       stmt=stmt->types.pass->next_stmt; //done for pass, just move onto next statement
     } 
   }
-}
\ No newline at end of file
+
+  free(literals); 
+  literals = NULL; 
+  literals_size = 0; 
+  literals_count = 0; 
+}
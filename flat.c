@@ -0,0 +1,750 @@
+/*flat.c*/
+
+//
+// Flattened, index-based nuPython programs (see flat.h): the converter
+// from the program graph, and an executor that runs on the flat arrays.
+//
+// The converter walks the graph in program order, so the statements of
+// a loop body follow the loop in the array, and each expression sits
+// right before the unary expressions and elements it uses. Variables
+// get the same slots as in the bytecode (see resolve.h).
+//
+// The executor follows vm.c operation for operation --- the same reads
+// of operands, in the same order, with the same checks --- and uses the
+// VM's own binary operators, print, input and conversions, so output
+// and error messages are identical.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stdint.h>   // int32_t, uint32_t
+
+#include "programgraph.h"
+#include "ram.h"
+#include "rstring.h"
+#include "resolve.h"
+#include "bytecode.h"  // OP_ADD, OP_INT, ...
+#include "vm.h"
+#include "flat.h"
+#include "output.h"
+
+
+//
+// The state of a conversion: the program being built, the capacity of
+// each of its arrays, and the symbol table that gives out slots.
+//
+struct CONVERTER
+{
+  struct FLAT_PROGRAM* program;
+  uint32_t stmts_capacity;
+  uint32_t exprs_capacity;
+  uint32_t unaries_capacity;
+  uint32_t elements_capacity;
+  uint32_t calls_capacity;
+  uint32_t strings_capacity;
+  struct SYMTAB* symbols;
+};
+
+//
+// The state of a running flat program:
+//
+struct FLAT_VM
+{
+  struct FLAT_PROGRAM* program;
+  struct RAM* memory;
+  int* addresses;  // slot -> memory address, -1 => not known yet
+  char** strs;     // element -> rstring of a string literal, else NULL
+};
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**FLAT ERROR\n");
+  printf("**FLAT ERROR: %s\n", msg);
+  printf("**FLAT ERROR\n");
+
+  exit(-123);
+}
+
+//
+// grow
+//
+// Makes room for one more entry of the given size at the end of the
+// array, doubling its capacity if it is full. Returns the array.
+//
+static void* grow(void* array, uint32_t count, uint32_t* capacity, size_t size)
+{
+  if (count < *capacity)
+    return array;
+
+  *capacity = (*capacity == 0) ? 16 : *capacity * 2;
+  array = realloc(array, (size_t)*capacity * size);
+  if (array == NULL)
+    panic("out of memory (grow)");
+
+  return array;
+}
+
+//
+// add_string
+//
+// Appends the given string to the strings pool, and returns its offset.
+//
+static uint32_t add_string(struct CONVERTER* c, char* s)
+{
+  struct FLAT_PROGRAM* p = c->program;
+  uint32_t length = (uint32_t)strlen(s) + 1;
+
+  while (p->strings_size + length > c->strings_capacity) {
+    c->strings_capacity = (c->strings_capacity == 0) ? 256 : c->strings_capacity * 2;
+    p->strings = (char*)realloc(p->strings, c->strings_capacity);
+    if (p->strings == NULL)
+      panic("out of memory (add_string)");
+  }
+
+  uint32_t offset = p->strings_size;
+  memcpy(p->strings + offset, s, length);
+  p->strings_size += length;
+
+  return offset;
+}
+
+//
+// convert_element
+//
+// Adds the given element, and returns its index. If variable is true
+// the text is given a slot even when the element is not an identifier
+// (int() and float() look their parameter up as a variable).
+//
+static uint32_t convert_element(struct CONVERTER* c, struct ELEMENT* element, bool variable)
+{
+  struct FLAT_PROGRAM* p = c->program;
+
+  p->elements = (struct FLAT_ELEMENT*)grow(p->elements, p->num_elements, &c->elements_capacity, sizeof(struct FLAT_ELEMENT));
+  uint32_t index = p->num_elements++;
+
+  struct FLAT_ELEMENT* flat = &p->elements[index];
+  flat->element_type = element->element_type;
+  flat->slot = FLAT_NULL;
+  flat->i = 0;
+  flat->d = 0.0;
+
+  if (element->element_type == ELEMENT_IDENTIFIER || variable)
+    flat->slot = (uint32_t)symtab_slot(c->symbols, element->element_value);
+  if (element->element_type == ELEMENT_INT_LITERAL)
+    flat->i = atoi(element->element_value);
+  else if (element->element_type == ELEMENT_REAL_LITERAL)
+    flat->d = atof(element->element_value);
+
+  uint32_t text = add_string(c, element->element_value);
+  p->elements[index].text = text;  // the strings moved, not the elements
+
+  return index;
+}
+
+//
+// convert_unary
+//
+// Adds the given unary expression, and returns its index.
+//
+static uint32_t convert_unary(struct CONVERTER* c, struct UNARY_EXPR* unary)
+{
+  struct FLAT_PROGRAM* p = c->program;
+
+  p->unaries = (struct FLAT_UNARY*)grow(p->unaries, p->num_unaries, &c->unaries_capacity, sizeof(struct FLAT_UNARY));
+  uint32_t index = p->num_unaries++;
+
+  uint32_t element = convert_element(c, unary->element, false);
+  p->unaries[index].expr_type = unary->expr_type;
+  p->unaries[index].element = element;
+
+  return index;
+}
+
+//
+// convert_expr
+//
+// Adds the given expression, and returns its index.
+//
+static uint32_t convert_expr(struct CONVERTER* c, struct EXPR* expr)
+{
+  struct FLAT_PROGRAM* p = c->program;
+
+  p->exprs = (struct FLAT_EXPR*)grow(p->exprs, p->num_exprs, &c->exprs_capacity, sizeof(struct FLAT_EXPR));
+  uint32_t index = p->num_exprs++;
+
+  uint32_t lhs = convert_unary(c, expr->lhs);
+  uint32_t rhs = FLAT_NULL;
+  int operator = OPERATOR_NO_OP;
+
+  if (expr->isBinaryExpr) {
+    operator = expr->operator;
+    if (expr->rhs != NULL)
+      rhs = convert_unary(c, expr->rhs);
+  }
+
+  p->exprs[index].operator = operator;
+  p->exprs[index].lhs = lhs;
+  p->exprs[index].rhs = rhs;
+
+  return index;
+}
+
+//
+// convert_call
+//
+// Adds the given function call, and returns its index.
+//
+static uint32_t convert_call(struct CONVERTER* c, char* function_name, struct ELEMENT* parameter)
+{
+  struct FLAT_PROGRAM* p = c->program;
+
+  p->calls = (struct FLAT_CALL*)grow(p->calls, p->num_calls, &c->calls_capacity, sizeof(struct FLAT_CALL));
+  uint32_t index = p->num_calls++;
+
+  bool variable = (strcmp(function_name, "int") == 0 || strcmp(function_name, "float") == 0);
+
+  uint32_t function = add_string(c, function_name);
+  uint32_t element = (parameter == NULL) ? FLAT_NULL : convert_element(c, parameter, variable);
+
+  p->calls[index].function = function;
+  p->calls[index].parameter = element;
+
+  return index;
+}
+
+//
+// convert_stmts
+//
+// Adds the statements from stmt up to stop (or the end of the program),
+// and returns the index of the first, or FLAT_NULL if there are none.
+// The last one leads to the given statement after.
+//
+static uint32_t convert_stmts(struct CONVERTER* c, struct STMT* stmt, struct STMT* stop, uint32_t after)
+{
+  struct FLAT_PROGRAM* p = c->program;
+  uint32_t first = FLAT_NULL;
+  uint32_t prev = FLAT_NULL;
+
+  while (stmt != NULL && stmt != stop) {
+    p->stmts = (struct FLAT_STMT*)grow(p->stmts, p->num_stmts, &c->stmts_capacity, sizeof(struct FLAT_STMT));
+    uint32_t index = p->num_stmts++;
+
+    memset(&p->stmts[index], 0, sizeof(struct FLAT_STMT));
+    p->stmts[index].stmt_type = stmt->stmt_type;
+    p->stmts[index].line = stmt->line;
+    p->stmts[index].next = FLAT_NULL;
+
+    if (prev == FLAT_NULL)
+      first = index;
+    else
+      p->stmts[prev].next = index;
+    prev = index;
+
+    // the arrays may move while the parts are added, so p->stmts[index]
+    // is only written once each part is done:
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+      uint32_t var = (uint32_t)symtab_slot(c->symbols, assignment->var_name);
+      uint32_t value;
+
+      if (assignment->rhs->value_type == VALUE_EXPR)
+        value = convert_expr(c, assignment->rhs->types.expr);
+      else
+        value = convert_call(c, assignment->rhs->types.function_call->function_name, assignment->rhs->types.function_call->parameter);
+
+      p->stmts[index].u.assignment.var = var;
+      p->stmts[index].u.assignment.deref = assignment->isPtrDeref;
+      p->stmts[index].u.assignment.value_type = assignment->rhs->value_type;
+      p->stmts[index].u.assignment.value = value;
+      stmt = assignment->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+      uint32_t value = convert_call(c, call->function_name, call->parameter);
+
+      p->stmts[index].u.function_call.call = value;
+      stmt = call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
+      uint32_t condition = convert_expr(c, while_loop->condition);
+      uint32_t body = convert_stmts(c, while_loop->loop_body, stmt, index);
+
+      p->stmts[index].u.while_loop.condition = condition;
+      p->stmts[index].u.while_loop.body = body;
+      stmt = while_loop->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_PASS) {
+      stmt = stmt->types.pass->next_stmt;
+    }
+    else {
+      panic("unexpected statement type (convert_stmts)");
+    }
+  }
+
+  if (prev != FLAT_NULL)
+    p->stmts[prev].next = after;
+
+  return first;
+}
+
+//
+// flat_convert
+//
+// Converts the given program graph into a new flat program, which
+// the caller frees with flat_destroy. The graph is not changed.
+//
+struct FLAT_PROGRAM* flat_convert(struct STMT* program)
+{
+  struct CONVERTER c;
+  memset(&c, 0, sizeof(struct CONVERTER));
+
+  c.program = (struct FLAT_PROGRAM*)calloc(1, sizeof(struct FLAT_PROGRAM));
+  if (c.program == NULL)
+    panic("out of memory (flat_convert)");
+
+  c.symbols = resolve_program(program);
+  convert_stmts(&c, program, NULL, FLAT_NULL);
+
+  struct FLAT_PROGRAM* p = c.program;
+  p->num_slots = (uint32_t)c.symbols->num_slots;
+  p->names = (uint32_t*)malloc((p->num_slots + 1) * sizeof(uint32_t));
+  if (p->names == NULL)
+    panic("out of memory (flat_convert)");
+
+  for (uint32_t slot = 0; slot < p->num_slots; slot++)
+    p->names[slot] = add_string(&c, c.symbols->names[slot]);
+
+  symtab_destroy(c.symbols);
+  return p;
+}
+
+//
+// flat_destroy
+//
+// Frees the flat program.
+//
+void flat_destroy(struct FLAT_PROGRAM* program)
+{
+  if (program == NULL)
+    return;
+
+  free(program->stmts);
+  free(program->exprs);
+  free(program->unaries);
+  free(program->elements);
+  free(program->calls);
+  free(program->names);
+  free(program->strings);
+  free(program);
+}
+
+
+//
+// flat_address
+//
+// Returns the memory address of the variable in the given slot, or -1
+// if the variable has not been written to memory yet.
+//
+static int flat_address(struct FLAT_VM* vm, uint32_t slot)
+{
+  int address = vm->addresses[slot];
+
+  if (address < 0) {
+    address = ram_get_addr(vm->memory, vm->program->strings + vm->program->names[slot]);
+    vm->addresses[slot] = address;
+  }
+  return address;
+}
+
+//
+// flat_constant
+//
+// Returns the value of a literal element. A string is borrowed.
+//
+static struct RAM_VALUE flat_constant(struct FLAT_VM* vm, uint32_t index)
+{
+  struct FLAT_ELEMENT* element = &vm->program->elements[index];
+  struct RAM_VALUE value;
+
+  switch (element->element_type) {
+  case ELEMENT_INT_LITERAL:
+    value.value_type = RAM_TYPE_INT;
+    value.types.i = element->i;
+    break;
+  case ELEMENT_REAL_LITERAL:
+    value.value_type = RAM_TYPE_REAL;
+    value.types.d = element->d;
+    break;
+  case ELEMENT_STR_LITERAL:
+    value.value_type = RAM_TYPE_STR;
+    value.types.s = vm->strs[index];
+    break;
+  case ELEMENT_TRUE:
+  case ELEMENT_FALSE:
+    value.value_type = RAM_TYPE_BOOLEAN;
+    value.types.i = (element->element_type == ELEMENT_TRUE);
+    break;
+  default:
+    value.value_type = RAM_TYPE_NONE;
+    value.types.i = 0;
+  }
+  return value;
+}
+
+//
+// flat_variable
+//
+// Fetches the value of the variable in the given slot into *value,
+// following the pointer it holds if deref is true. The value is
+// borrowed. Returns false if a semantic error occurred (error msg
+// is output).
+//
+static bool flat_variable(struct FLAT_VM* vm, uint32_t slot, bool deref, int line, struct RAM_VALUE* value)
+{
+  char* name = vm->program->strings + vm->program->names[slot];
+  int address = flat_address(vm, slot);
+
+  if (address == -1) {
+    printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line);
+    return false;
+  }
+  const struct RAM_VALUE* cell = ram_peek_cell_by_addr(vm->memory, address);
+
+  if (deref) { // follow the pointer to the cell it refers to
+    if (cell->value_type != RAM_TYPE_PTR) {
+      printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+      return false;
+    }
+    cell = ram_peek_cell_by_addr(vm->memory, cell->types.i);
+    if (cell == NULL) {
+      printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", name, line);
+      return false;
+    }
+  }
+
+  *value = *cell;
+  return true;
+}
+
+//
+// flat_fetch
+//
+// Fetches the value of a unary expression into *value, like vm_fetch.
+// In a binary expression &x reads x itself (see unary_operand in
+// bytecode.c). Returns false if a semantic error occurred (error msg
+// is output).
+//
+static bool flat_fetch(struct FLAT_VM* vm, uint32_t index, bool binary_context, int line, struct RAM_VALUE* value)
+{
+  struct FLAT_UNARY* unary = &vm->program->unaries[index];
+  struct FLAT_ELEMENT* element = &vm->program->elements[unary->element];
+
+  if (element->element_type != ELEMENT_IDENTIFIER) {
+    *value = flat_constant(vm, unary->element);
+    return true;
+  }
+
+  if (unary->expr_type == UNARY_ADDRESS_OF && !binary_context) {
+    int address = flat_address(vm, element->slot);
+    if (address == -1) {
+      printf("**SEMANTIC ERROR: name '%s' is not defined (line '%d')\n", vm->program->strings + element->text, line);
+      return false;
+    }
+    value->value_type = RAM_TYPE_PTR;
+    value->types.i = address;
+    return true;
+  }
+
+  return flat_variable(vm, element->slot, unary->expr_type == UNARY_PTR_DEREF, line, value);
+}
+
+//
+// flat_store
+//
+// Stores a value into the variable in the given slot. If owned is true
+// the caller's reference to the value's string is consumed.
+//
+static void flat_store(struct FLAT_VM* vm, uint32_t slot, struct RAM_VALUE value, bool owned)
+{
+  int address = flat_address(vm, slot);
+
+  if (address >= 0) {
+    ram_share_cell_by_addr(vm->memory, value, address);
+  } else { // first write, the variable gets its address now
+    char* name = vm->program->strings + vm->program->names[slot];
+    ram_share_cell_by_name(vm->memory, value, name);
+    vm->addresses[slot] = ram_get_addr(vm->memory, name);
+  }
+
+  if (owned && value.value_type == RAM_TYPE_STR) // memory has its own reference
+    rstr_release(value.types.s);
+}
+
+//
+// flat_expr
+//
+// Evaluates an expression into *result, which the caller owns. Returns
+// false if a semantic error occurred (error msg is output), or if the
+// expression is malformed, which stops the program silently like the VM.
+//
+static bool flat_expr(struct FLAT_VM* vm, uint32_t index, int line, struct RAM_VALUE* result)
+{
+  struct FLAT_EXPR* expr = &vm->program->exprs[index];
+
+  if (expr->operator == OPERATOR_NO_OP) {
+    if (!flat_fetch(vm, expr->lhs, false, line, result))
+      return false;
+    if (result->value_type == RAM_TYPE_STR)
+      rstr_retain(result->types.s);
+    return true;
+  }
+
+  if (expr->rhs == FLAT_NULL)
+    return false;
+
+  int opcode = OP_ADD + expr->operator;
+  if (expr->operator < OPERATOR_PLUS || expr->operator > OPERATOR_IN)
+    opcode = OP_IS;
+
+  // both operands are fetched (and errors reported) before stopping:
+  struct RAM_VALUE lhs, rhs;
+  bool lhs_success = flat_fetch(vm, expr->lhs, true, line, &lhs);
+  bool rhs_success = flat_fetch(vm, expr->rhs, true, line, &rhs);
+  if (!(lhs_success && rhs_success))
+    return false;
+
+  return vm_binary(opcode, &lhs, &rhs, result, line);
+}
+
+//
+// flat_deref_target
+//
+// Resolves the target of *p = ..., like vm_deref_target. Returns false
+// if a semantic error occurred (error msg is output).
+//
+static bool flat_deref_target(struct FLAT_VM* vm, uint32_t slot, int line, int* address)
+{
+  char* name = vm->program->strings + vm->program->names[slot];
+
+  int pointer_address = flat_address(vm, slot);
+  if (pointer_address == -1) {
+    printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line);
+    return false;
+  }
+  const struct RAM_VALUE* cell = ram_peek_cell_by_addr(vm->memory, pointer_address);
+  if (cell->value_type != RAM_TYPE_PTR) {
+    printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+    return false;
+  }
+  *address = cell->types.i;
+
+  if (ram_peek_cell_by_addr(vm->memory, *address) == NULL) {
+    printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", name, line);
+    return false;
+  }
+
+  return true;
+}
+
+//
+// flat_call_value
+//
+// Computes the value of x = f(...) into *result, which the caller owns:
+// input, int, and float; any other function is ignored (returns false
+// in *assign). Returns false if a semantic error occurred (error msg is
+// output).
+//
+static bool flat_call_value(struct FLAT_VM* vm, uint32_t index, int line, struct RAM_VALUE* result, bool* assign)
+{
+  struct FLAT_CALL* call = &vm->program->calls[index];
+  char* function = vm->program->strings + call->function;
+  struct RAM_VALUE value;
+
+  *assign = false;
+  value.value_type = RAM_TYPE_NONE;
+  value.types.i = 0;
+
+  if (strcmp(function, "input") == 0) {
+    // the prompt is output as written, whatever the element type:
+    if (call->parameter != FLAT_NULL) {
+      value.value_type = RAM_TYPE_STR;
+      value.types.s = vm->program->strings + vm->program->elements[call->parameter].text;
+    }
+    vm_input(&value, result);
+    *assign = true;
+    return true;
+  }
+
+  bool is_int = (strcmp(function, "int") == 0);
+  if (!is_int && strcmp(function, "float") != 0)
+    return true;
+
+  // the parameter is always looked up as a variable:
+  if (call->parameter != FLAT_NULL && !flat_variable(vm, vm->program->elements[call->parameter].slot, false, line, &value))
+    return false;
+  if (!vm_convert(is_int ? OP_INT : OP_FLOAT, &value, result, line))
+    return false;
+
+  *assign = true;
+  return true;
+}
+
+//
+// flat_assignment
+//
+// Executes x = ..., *p = ..., and x = f(...). For *p the target is
+// resolved before the right-hand side is evaluated, like the VM.
+// Returns false if the program should stop.
+//
+static bool flat_assignment(struct FLAT_VM* vm, struct FLAT_STMT* stmt)
+{
+  int address = -1;
+  struct RAM_VALUE result;
+  bool assign = true;
+
+  if (stmt->u.assignment.deref && !flat_deref_target(vm, stmt->u.assignment.var, stmt->line, &address))
+    return false;
+
+  if (stmt->u.assignment.value_type == VALUE_EXPR) {
+    if (!flat_expr(vm, stmt->u.assignment.value, stmt->line, &result))
+      return false;
+  }
+  else if (!flat_call_value(vm, stmt->u.assignment.value, stmt->line, &result, &assign)) {
+    return false;
+  }
+
+  if (!assign)
+    return true;
+
+  if (stmt->u.assignment.deref) {
+    ram_share_cell_by_addr(vm->memory, result, address);
+    if (result.value_type == RAM_TYPE_STR)
+      rstr_release(result.types.s);
+  }
+  else {
+    flat_store(vm, stmt->u.assignment.var, result, true);
+  }
+  return true;
+}
+
+//
+// flat_print
+//
+// Executes a function call statement, which is always print. Returns
+// false if a semantic error occurred (error msg is output).
+//
+static bool flat_print(struct FLAT_VM* vm, struct FLAT_STMT* stmt)
+{
+  struct FLAT_CALL* call = &vm->program->calls[stmt->u.function_call.call];
+  struct RAM_VALUE value;
+
+  if (call->parameter == FLAT_NULL) {
+    output_newline();
+    return true;
+  }
+
+  struct FLAT_ELEMENT* element = &vm->program->elements[call->parameter];
+  if (element->element_type != ELEMENT_IDENTIFIER)
+    value = flat_constant(vm, call->parameter);
+  else if (!flat_variable(vm, element->slot, false, stmt->line, &value))
+    return false;
+
+  vm_print(&value);
+  return true;
+}
+
+//
+// flat_condition
+//
+// Evaluates the condition of a while loop into *condition: true only
+// for non-zero int or boolean values, like the executor. Returns false
+// if the program should stop.
+//
+static bool flat_condition(struct FLAT_VM* vm, struct FLAT_STMT* stmt, bool* condition)
+{
+  struct RAM_VALUE value;
+
+  if (!flat_expr(vm, stmt->u.while_loop.condition, stmt->line, &value))
+    return false;
+
+  *condition = ((value.value_type == RAM_TYPE_BOOLEAN || value.value_type == RAM_TYPE_INT) && value.types.i != 0);
+
+  if (value.value_type == RAM_TYPE_STR)
+    rstr_release(value.types.s);
+  return true;
+}
+
+//
+// flat_execute
+//
+// Given a flat program and a memory, executes the program. If a
+// semantic error occurs (e.g. type error), an error message is
+// output, execution stops, and the function returns.
+//
+void flat_execute(struct FLAT_PROGRAM* program, struct RAM* memory)
+{
+  struct FLAT_VM vm;
+  vm.program = program;
+  vm.memory = memory;
+  vm.addresses = (int*)malloc((program->num_slots + 1) * sizeof(int));
+  vm.strs = (char**)calloc(program->num_elements + 1, sizeof(char*));
+  if (vm.addresses == NULL || vm.strs == NULL)
+    panic("out of memory (flat_execute)");
+
+  for (uint32_t slot = 0; slot < program->num_slots; slot++)
+    vm.addresses[slot] = -1;
+  for (uint32_t i = 0; i < program->num_elements; i++) {
+    if (program->elements[i].element_type == ELEMENT_STR_LITERAL)
+      vm.strs[i] = rstr_from(program->strings + program->elements[i].text);
+  }
+
+  uint32_t pc = (program->num_stmts > 0) ? 0 : FLAT_NULL;
+
+  while (pc != FLAT_NULL) {
+    struct FLAT_STMT* stmt = &program->stmts[pc];
+    bool ok = true;
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      ok = flat_assignment(&vm, stmt);
+      pc = stmt->next;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      ok = flat_print(&vm, stmt);
+      pc = stmt->next;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      bool condition = false;
+      ok = flat_condition(&vm, stmt, &condition);
+      pc = (condition && stmt->u.while_loop.body != FLAT_NULL) ? stmt->u.while_loop.body : stmt->next;
+    }
+    else if (stmt->stmt_type == STMT_PASS) {
+      pc = stmt->next;
+    }
+    else {
+      ok = false;
+    }
+
+    if (!ok)
+      break;
+  }
+
+  for (uint32_t i = 0; i < program->num_elements; i++) {
+    if (vm.strs[i] != NULL)
+      rstr_release(vm.strs[i]);
+  }
+  free(vm.strs);
+  free(vm.addresses);
+}
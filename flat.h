@@ -0,0 +1,137 @@
+/*flat.h*/
+
+//
+// Flattened, index-based layout of a nuPython program graph. Instead
+// of a web of separately allocated nodes, the program is kept in a few
+// contiguous arrays --- statements, expressions, unary expressions,
+// elements, and function calls --- that refer to each other by 32-bit
+// index, plus one pool holding all of the program's strings. Names are
+// resolved to variable slots and numeric literals are decoded once, by
+// the converter, so running an assignment touches a handful of array
+// entries that sit next to each other. Since nothing in the layout is
+// a pointer, the arrays can also be written out and read back as is.
+//
+// flat_execute runs the flat program with exactly the semantics and
+// error messages of the VM (see -flat in main.c).
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdint.h>   // int32_t, uint32_t
+
+#include "programgraph.h"
+#include "ram.h"
+
+
+#define FLAT_NULL 0xFFFFFFFFu  // the index of nothing
+
+
+//
+// A statement. The last statement of a loop body leads back to the
+// loop, just like the program graph.
+//
+struct FLAT_STMT
+{
+  int32_t  stmt_type;  // enum STMT_TYPES
+  int32_t  line;       // line # the stmt starts on
+  uint32_t next;       // the stmt that follows, FLAT_NULL => end of program
+
+  union
+  {
+    struct {
+      uint32_t var;         // slot of the variable (of the pointer, if deref)
+      int32_t  deref;       // true => *var = ...
+      int32_t  value_type;  // enum VALUE_TYPES
+      uint32_t value;       // index of the expr, or of the function call
+    } assignment;
+
+    struct {
+      uint32_t call;        // index of the function call
+    } function_call;
+
+    struct {
+      uint32_t condition;   // index of the expr
+      uint32_t body;        // first stmt of the body
+    } while_loop;
+  } u;
+};
+
+struct FLAT_EXPR
+{
+  int32_t  operator;   // enum OPERATORS, OPERATOR_NO_OP => just lhs
+  uint32_t lhs;        // index of the unary expr
+  uint32_t rhs;        // index of the unary expr, FLAT_NULL => none
+};
+
+struct FLAT_UNARY
+{
+  int32_t  expr_type;  // enum UNARY_EXPR_TYPES
+  uint32_t element;    // index of the element
+};
+
+struct FLAT_ELEMENT
+{
+  int32_t  element_type;  // enum ELEMENT_TYPES
+  uint32_t text;          // offset of the element's text in the strings
+  uint32_t slot;          // variable slot of the text, FLAT_NULL => not a variable
+  int32_t  i;             // value of an int literal
+  double   d;             // value of a real literal
+};
+
+struct FLAT_CALL
+{
+  uint32_t function;   // offset of the function name in the strings
+  uint32_t parameter;  // index of the element, FLAT_NULL => none
+};
+
+struct FLAT_PROGRAM
+{
+  struct FLAT_STMT*    stmts;     // stmts[0] is the first, if any
+  struct FLAT_EXPR*    exprs;
+  struct FLAT_UNARY*   unaries;
+  struct FLAT_ELEMENT* elements;
+  struct FLAT_CALL*    calls;
+  uint32_t*            names;     // slot -> offset of its name in the strings
+  char*                strings;   // every string, each ending in '\0'
+
+  uint32_t num_stmts;
+  uint32_t num_exprs;
+  uint32_t num_unaries;
+  uint32_t num_elements;
+  uint32_t num_calls;
+  uint32_t num_slots;
+  uint32_t strings_size;          // # of bytes in strings
+};
+
+
+//
+// Public functions:
+//
+
+//
+// flat_convert
+//
+// Converts the given program graph into a new flat program, which
+// the caller frees with flat_destroy. The graph is not changed.
+//
+struct FLAT_PROGRAM* flat_convert(struct STMT* program);
+
+//
+// flat_execute
+//
+// Given a flat program and a memory, executes the program. If a
+// semantic error occurs (e.g. type error), an error message is
+// output, execution stops, and the function returns.
+//
+void flat_execute(struct FLAT_PROGRAM* program, struct RAM* memory);
+
+//
+// flat_destroy
+//
+// Frees the flat program.
+//
+void flat_destroy(struct FLAT_PROGRAM* program);
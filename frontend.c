@@ -0,0 +1,557 @@
+/*frontend.c*/
+
+//
+// Front end for nuPython (see frontend.h): one recursive-descent pass
+// over the token array that checks the syntax and builds the program
+// graph as it goes. The grammar, and every syntax error message, is
+// that of parser_parse, function by function. The graph is exactly the
+// one programgraph_build returns --- same nodes, same line numbers,
+// same loop-back links --- so everything downstream works on either.
+// The difference is where it lives: all of it comes from one arena, in
+// the order it is built, which is also the order the graph is walked,
+// instead of from a separate malloc per node and string.
+//
+// programgraph_build only runs once the whole program is known to be
+// legal, so a statement it rejects (if) must not stop the pass: a
+// later syntax error is still the one reported. The first such problem
+// is remembered instead, and handed back once the parse succeeds.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "token.h"
+#include "tokens.h"
+#include "programgraph.h"
+#include "arena.h"
+#include "frontend.h"
+
+
+//
+// The state of the pass: where the nodes come from, the next token,
+// and the first problem programgraph_build would have with the graph.
+//
+struct BUILDER
+{
+  struct ARENA* arena;
+  struct TOKENS* tokens;  // the cursor is on the next token
+  char* unsupported;      // NULL => none so far
+};
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program. The
+// messages are those of programgraph_build.
+//
+static void panic(char* msg)
+{
+  printf("**PROGRAMGRAPH ERROR\n");
+  printf("**PROGRAMGRAPH ERROR: %s\n", msg);
+  printf("**PROGRAMGRAPH ERROR\n");
+
+  exit(-123);
+}
+
+//
+// unsupported
+//
+// Remembers a problem programgraph_build would have with the graph,
+// unless an earlier one already was.
+//
+static void unsupported(struct BUILDER* b, char* msg)
+{
+  if (b->unsupported == NULL)
+    b->unsupported = msg;
+}
+
+//
+// syntax_error
+//
+// Outputs a syntax error at the current token.
+//
+static void syntax_error(struct BUILDER* b, char* expecting)
+{
+  struct Token token = tokens_peek(b->tokens);
+
+  printf("**SYNTAX ERROR @ (%d,%d): expecting %s, found '%s'\n", token.line, token.col, expecting, tokens_value(b->tokens));
+}
+
+//
+// peek / peek2
+//
+// Returns the id of the current token, or of the one after it.
+//
+static int peek(struct BUILDER* b)
+{
+  return tokens_peek(b->tokens).id;
+}
+
+static int peek2(struct BUILDER* b)
+{
+  return tokens_peek2(b->tokens).id;
+}
+
+//
+// match
+//
+// Moves past the current token if it has the given id; otherwise
+// outputs a syntax error and returns false.
+//
+static bool match(struct BUILDER* b, int id, char* expecting)
+{
+  if (peek(b) != id) {
+    syntax_error(b, expecting);
+    return false;
+  }
+
+  tokens_advance(b->tokens);
+  return true;
+}
+
+//
+// starts_stmt
+//
+// Returns true if the given token can start a statement.
+//
+static bool starts_stmt(int id)
+{
+  return id == nuPy_EOLN || id == nuPy_ASTERISK || id == nuPy_IDENTIFIER ||
+         id == nuPy_KEYW_IF || id == nuPy_KEYW_PASS || id == nuPy_KEYW_WHILE;
+}
+
+//
+// element_type
+//
+// Returns the ELEMENT_TYPES value of the given token, or -1 if the
+// token is not an element: x, 123, 'a string', ...
+//
+static int element_type(int id)
+{
+  switch (id) {
+    case nuPy_IDENTIFIER:   return ELEMENT_IDENTIFIER;
+    case nuPy_INT_LITERAL:  return ELEMENT_INT_LITERAL;
+    case nuPy_REAL_LITERAL: return ELEMENT_REAL_LITERAL;
+    case nuPy_STR_LITERAL:  return ELEMENT_STR_LITERAL;
+    case nuPy_KEYW_TRUE:    return ELEMENT_TRUE;
+    case nuPy_KEYW_FALSE:   return ELEMENT_FALSE;
+    case nuPy_KEYW_NONE:    return ELEMENT_NONE;
+    default:                return -1;
+  }
+}
+
+//
+// operator_of
+//
+// Returns the OPERATORS value of the given token, or OPERATOR_NO_OP
+// if the token is not a binary operator.
+//
+static int operator_of(int id)
+{
+  switch (id) {
+    case nuPy_PLUS:       return OPERATOR_PLUS;
+    case nuPy_MINUS:      return OPERATOR_MINUS;
+    case nuPy_ASTERISK:   return OPERATOR_ASTERISK;
+    case nuPy_POWER:      return OPERATOR_POWER;
+    case nuPy_PERCENT:    return OPERATOR_MOD;
+    case nuPy_SLASH:      return OPERATOR_DIV;
+    case nuPy_EQUALEQUAL: return OPERATOR_EQUAL;
+    case nuPy_NOTEQUAL:   return OPERATOR_NOT_EQUAL;
+    case nuPy_LT:         return OPERATOR_LT;
+    case nuPy_LTE:        return OPERATOR_LTE;
+    case nuPy_GT:         return OPERATOR_GT;
+    case nuPy_GTE:        return OPERATOR_GTE;
+    case nuPy_KEYW_IS:    return OPERATOR_IS;
+    case nuPy_KEYW_IN:    return OPERATOR_IN;
+    default:              return OPERATOR_NO_OP;
+  }
+}
+
+//
+// new_element
+//
+// Returns the element for the current token, which must be one,
+// and moves past it.
+//
+static struct ELEMENT* new_element(struct BUILDER* b)
+{
+  struct ELEMENT* element = (struct ELEMENT*)arena_alloc(b->arena, sizeof(struct ELEMENT));
+
+  element->element_type = element_type(peek(b));
+  element->element_value = arena_strdup(b->arena, tokens_value(b->tokens));
+  tokens_advance(b->tokens);
+
+  return element;
+}
+
+//
+// parse_unary_expr
+//
+// unary_expr ::= * IDENTIFIER | & IDENTIFIER | + (IDENTIFIER | INT | REAL)
+//              | - (IDENTIFIER | INT | REAL) | element
+//
+static bool parse_unary_expr(struct BUILDER* b, struct UNARY_EXPR** result)
+{
+  struct UNARY_EXPR* unary = (struct UNARY_EXPR*)arena_alloc(b->arena, sizeof(struct UNARY_EXPR));
+  *result = unary;
+
+  int id = peek(b);
+
+  if (id == nuPy_ASTERISK || id == nuPy_AMPERSAND) {
+    unary->expr_type = (id == nuPy_ASTERISK) ? UNARY_PTR_DEREF : UNARY_ADDRESS_OF;
+    tokens_advance(b->tokens);
+
+    if (peek(b) != nuPy_IDENTIFIER) {
+      syntax_error(b, "identifier");
+      return false;
+    }
+    unary->element = new_element(b);
+    return true;
+  }
+
+  if (id == nuPy_PLUS || id == nuPy_MINUS) {
+    unary->expr_type = (id == nuPy_PLUS) ? UNARY_PLUS : UNARY_MINUS;
+    tokens_advance(b->tokens);
+
+    id = peek(b);
+    if (id != nuPy_IDENTIFIER && id != nuPy_INT_LITERAL && id != nuPy_REAL_LITERAL) {
+      syntax_error(b, "identifier or numeric literal");
+      return false;
+    }
+    unary->element = new_element(b);
+    return true;
+  }
+
+  if (element_type(id) < 0) {
+    syntax_error(b, "a value such as x, 123, or 'a string'");
+    return false;
+  }
+  unary->expr_type = UNARY_ELEMENT;
+  unary->element = new_element(b);
+  return true;
+}
+
+//
+// parse_expr
+//
+// expr ::= unary_expr [op unary_expr]
+//
+static bool parse_expr(struct BUILDER* b, struct EXPR** result)
+{
+  struct EXPR* expr = (struct EXPR*)arena_alloc(b->arena, sizeof(struct EXPR));
+  *result = expr;
+
+  expr->isBinaryExpr = false;
+  expr->operator = OPERATOR_NO_OP;
+  expr->rhs = NULL;
+
+  if (!parse_unary_expr(b, &expr->lhs))
+    return false;
+
+  int operator = operator_of(peek(b));
+  if (operator == OPERATOR_NO_OP)
+    return true;
+
+  tokens_advance(b->tokens);
+  expr->isBinaryExpr = true;
+  expr->operator = operator;
+  return parse_unary_expr(b, &expr->rhs);
+}
+
+//
+// parse_function_call
+//
+// function_call ::= IDENTIFIER ( [element] )
+//
+static bool parse_function_call(struct BUILDER* b, char** function_name, struct ELEMENT** parameter)
+{
+  *function_name = arena_strdup(b->arena, tokens_value(b->tokens));
+  *parameter = NULL;
+
+  if (!match(b, nuPy_IDENTIFIER, "identifier"))
+    return false;
+  if (!match(b, nuPy_LEFT_PAREN, "("))
+    return false;
+
+  if (element_type(peek(b)) >= 0)
+    *parameter = new_element(b);
+
+  return match(b, nuPy_RIGHT_PAREN, ")");
+}
+
+//
+// new_stmt
+//
+// Allocates a statement of the given type, starting on the given
+// line, and links it in where *link points.
+//
+static struct STMT* new_stmt(struct BUILDER* b, struct STMT** link, int stmt_type, int line)
+{
+  struct STMT* stmt = (struct STMT*)arena_alloc(b->arena, sizeof(struct STMT));
+  stmt->stmt_type = stmt_type;
+  stmt->line = line;
+
+  switch (stmt_type) {
+    case STMT_ASSIGNMENT:
+      stmt->types.assignment = (struct STMT_ASSIGNMENT*)arena_alloc(b->arena, sizeof(struct STMT_ASSIGNMENT));
+      break;
+    case STMT_FUNCTION_CALL:
+      stmt->types.function_call = (struct STMT_FUNCTION_CALL*)arena_alloc(b->arena, sizeof(struct STMT_FUNCTION_CALL));
+      break;
+    case STMT_WHILE_LOOP:
+      stmt->types.while_loop = (struct STMT_WHILE_LOOP*)arena_alloc(b->arena, sizeof(struct STMT_WHILE_LOOP));
+      break;
+    case STMT_PASS:
+      stmt->types.pass = (struct STMT_PASS*)arena_alloc(b->arena, sizeof(struct STMT_PASS));
+      break;
+    default:
+      panic("unexpected stmt_type (pg_alloc_stmt)");
+  }
+
+  *link = stmt;
+  return stmt;
+}
+
+//
+// parse_assignment
+//
+// assignment ::= [*] IDENTIFIER = (function_call | expr) EOLN
+//
+// The statement's line is that of the identifier. Sets *link to
+// the link after the statement.
+//
+static bool parse_assignment(struct BUILDER* b, struct STMT*** link)
+{
+  bool deref = (peek(b) == nuPy_ASTERISK);
+  if (deref)
+    tokens_advance(b->tokens);
+
+  struct STMT* stmt = new_stmt(b, *link, STMT_ASSIGNMENT, tokens_peek(b->tokens).line);
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+  assignment->var_name = arena_strdup(b->arena, tokens_value(b->tokens));
+  assignment->isPtrDeref = deref;
+  *link = &assignment->next_stmt;
+
+  if (!match(b, nuPy_IDENTIFIER, "identifier"))
+    return false;
+  if (!match(b, nuPy_EQUAL, "="))
+    return false;
+
+  struct VALUE* value = (struct VALUE*)arena_alloc(b->arena, sizeof(struct VALUE));
+  assignment->rhs = value;
+  bool success;
+
+  if (peek(b) == nuPy_IDENTIFIER && peek2(b) == nuPy_LEFT_PAREN) {
+    struct FUNCTION_CALL* call = (struct FUNCTION_CALL*)arena_alloc(b->arena, sizeof(struct FUNCTION_CALL));
+    value->value_type = VALUE_FUNCTION_CALL;
+    value->types.function_call = call;
+    success = parse_function_call(b, &call->function_name, &call->parameter);
+  }
+  else {
+    value->value_type = VALUE_EXPR;
+    success = parse_expr(b, &value->types.expr);
+  }
+
+  return success && match(b, nuPy_EOLN, "EOLN");
+}
+
+static bool parse_stmts(struct BUILDER* b, struct STMT*** link);
+
+//
+// parse_body
+//
+// body ::= { EOLN stmts } EOLN
+//
+// The statements are linked in where *link points, and *link is
+// set to the link after the last one.
+//
+static bool parse_body(struct BUILDER* b, struct STMT*** link)
+{
+  return match(b, nuPy_LEFT_BRACE, "{") &&
+         match(b, nuPy_EOLN, "EOLN") &&
+         parse_stmts(b, link) &&
+         match(b, nuPy_RIGHT_BRACE, "}") &&
+         match(b, nuPy_EOLN, "EOLN");
+}
+
+//
+// parse_while
+//
+// while_loop ::= while expr : EOLN body
+//
+// The last statement of the body links back to the loop, as in
+// programgraph_build; the loop's line is that of its condition.
+// Sets *link to the link after the loop.
+//
+static bool parse_while(struct BUILDER* b, struct STMT*** link)
+{
+  tokens_advance(b->tokens);  // while
+
+  struct STMT* stmt = new_stmt(b, *link, STMT_WHILE_LOOP, tokens_peek(b->tokens).line);
+  struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
+  *link = &while_loop->next_stmt;
+
+  if (!(parse_expr(b, &while_loop->condition) &&
+        match(b, nuPy_COLON, ":") && match(b, nuPy_EOLN, "EOLN")))
+    return false;
+
+  struct STMT** body_end = &while_loop->loop_body;
+  if (!parse_body(b, &body_end))
+    return false;
+
+  if (while_loop->loop_body == NULL)
+    unsupported(b, "while loop has an empty body (frontend_build)");
+  else
+    *body_end = stmt;
+
+  return true;
+}
+
+//
+// parse_if
+//
+// if_then_else ::= if expr : EOLN body [else]
+// else ::= elif expr : EOLN body [else] | else : EOLN body
+//
+// The program graph has no if statements yet, so the syntax is only
+// checked; the statements built along the way are not linked in.
+//
+static bool parse_if(struct BUILDER* b)
+{
+  struct EXPR* condition;
+  struct STMT* body = NULL;
+  struct STMT** body_end = &body;
+
+  unsupported(b, "if statements are not yet supported (programgraph_build)");
+
+  if (!(match(b, nuPy_KEYW_IF, "if") && parse_expr(b, &condition) &&
+        match(b, nuPy_COLON, ":") && match(b, nuPy_EOLN, "EOLN") &&
+        parse_body(b, &body_end)))
+    return false;
+
+  while (peek(b) == nuPy_KEYW_ELIF) {
+    if (!(match(b, nuPy_KEYW_ELIF, "elif") && parse_expr(b, &condition) &&
+          match(b, nuPy_COLON, ":") && match(b, nuPy_EOLN, "EOLN") &&
+          parse_body(b, &body_end)))
+      return false;
+  }
+
+  if (peek(b) == nuPy_KEYW_ELSE) {
+    return match(b, nuPy_KEYW_ELSE, "else") && match(b, nuPy_COLON, ":") &&
+           match(b, nuPy_EOLN, "EOLN") && parse_body(b, &body_end);
+  }
+
+  return true;
+}
+
+//
+// parse_stmt
+//
+// stmt ::= assignment | function_call EOLN | if_then_else
+//        | while_loop | pass EOLN | EOLN
+//
+// The statement is linked in where *link points, and *link is set
+// to the link after it (empty statements build nothing).
+//
+static bool parse_stmt(struct BUILDER* b, struct STMT*** link)
+{
+  int id = peek(b);
+
+  if (!starts_stmt(id)) {
+    syntax_error(b, "start of a statement");
+    return false;
+  }
+
+  switch (id) {
+    case nuPy_IDENTIFIER:
+      if (peek2(b) == nuPy_EQUAL)
+        return parse_assignment(b, link);
+
+      if (peek2(b) == nuPy_LEFT_PAREN) {
+        struct STMT* stmt = new_stmt(b, *link, STMT_FUNCTION_CALL, tokens_peek(b->tokens).line);
+        struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+        *link = &call->next_stmt;
+
+        return parse_function_call(b, &call->function_name, &call->parameter) &&
+               match(b, nuPy_EOLN, "EOLN");
+      }
+
+      syntax_error(b, "assignment or function call");
+      return false;
+
+    case nuPy_ASTERISK:
+      return parse_assignment(b, link);
+
+    case nuPy_KEYW_IF:
+      return parse_if(b);
+
+    case nuPy_KEYW_WHILE:
+      return parse_while(b, link);
+
+    case nuPy_KEYW_PASS: {
+      struct STMT* stmt = new_stmt(b, *link, STMT_PASS, tokens_peek(b->tokens).line);
+      *link = &stmt->types.pass->next_stmt;
+
+      return match(b, nuPy_KEYW_PASS, "pass") && match(b, nuPy_EOLN, "EOLN");
+    }
+
+    default:  // empty stmt:
+      return match(b, nuPy_EOLN, "EOLN");
+  }
+}
+
+//
+// parse_stmts
+//
+// stmts ::= stmt [stmts]
+//
+static bool parse_stmts(struct BUILDER* b, struct STMT*** link)
+{
+  do {
+    if (!parse_stmt(b, link))
+      return false;
+  } while (starts_stmt(peek(b)));
+
+  return true;
+}
+
+//
+// frontend_parse
+//
+// Checks the syntax of the program in the given tokens and builds its
+// program graph, allocated from the given arena, in one pass.
+//
+bool frontend_parse(struct TOKENS* tokens, struct ARENA* arena, struct STMT** program, char** unsupported)
+{
+  struct BUILDER b;
+  b.arena = arena;
+  b.tokens = tokens;
+  b.unsupported = NULL;
+  tokens->cursor = 0;
+
+  *program = NULL;
+  struct STMT** link = program;
+
+  bool success = parse_stmts(&b, &link) && match(&b, nuPy_EOS, "$");
+
+  *unsupported = success ? b.unsupported : NULL;
+  return success;
+}
+
+//
+// frontend_unsupported
+//
+// Outputs the given message, as returned by frontend_parse, the way
+// programgraph_build does, and exits the program.
+//
+void frontend_unsupported(char* msg)
+{
+  panic(msg);
+}
@@ -0,0 +1,48 @@
+/*frontend.h*/
+
+//
+// Front end for nuPython, over the token array (see tokens.h): checks
+// the syntax exactly like parser_parse and, in the same pass, builds
+// the same program graph as programgraph_build. Every node and string
+// of the graph is allocated from an arena owned by the caller, so the
+// graph is laid out contiguously and is freed with one call to
+// arena_destroy --- it must NOT be passed to programgraph_destroy.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "tokens.h"
+#include "arena.h"
+
+
+//
+// Public functions:
+//
+
+//
+// frontend_parse
+//
+// Checks the syntax of the program in the given tokens and builds its
+// program graph, allocated from the given arena, in one pass. Returns
+// false if the program has a syntax error, after outputting the same
+// message as parser_parse. Otherwise returns true, with the graph in
+// *program --- unless the program uses a statement programgraph_build
+// rejects (e.g. if), in which case *unsupported is the message it
+// would fail with, for frontend_unsupported, else NULL.
+//
+bool frontend_parse(struct TOKENS* tokens, struct ARENA* arena, struct STMT** program, char** unsupported);
+
+//
+// frontend_unsupported
+//
+// Outputs the given message, as returned by frontend_parse, the way
+// programgraph_build does, and exits the program.
+//
+void frontend_unsupported(char* msg);
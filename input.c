@@ -0,0 +1,162 @@
+/*input.c*/
+
+//
+// Keyboard input for nuPython (see input.h). The buffer holds the
+// bytes read but not yet handed out, from start to end; when no '\n'
+// is left in them, they are moved to the front, the buffer doubled if
+// it is full, and the next block read in behind them. On Unix a block
+// is whatever read() returns, so a line typed at the keyboard, or
+// written to a pipe, is handed out as soon as it arrives.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#define _DEFAULT_SOURCE  // fileno
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>   // read
+#include <errno.h>    // EINTR
+#define INPUT_READ
+#endif
+
+#include "rstring.h"
+#include "input.h"
+
+
+#define INPUT_BLOCK (1 << 16)  // initial size of the buffer, in bytes
+
+static char*  buffer = NULL;
+static size_t capacity = 0;
+static size_t start = 0;     // the next byte to hand out
+static size_t end = 0;       // just past the last byte read
+static size_t searched = 0;  // # of bytes from start known to hold no '\n'
+static bool   eof = false;
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**INPUT ERROR\n");
+  printf("**INPUT ERROR: %s\n", msg);
+  printf("**INPUT ERROR\n");
+
+  exit(-123);
+}
+
+//
+// fill
+//
+// Reads the next block of stdin into the buffer, after the bytes
+// not yet handed out. Returns false at the end of stdin.
+//
+static bool fill(void)
+{
+  if (eof)
+    return false;
+
+  if (start > 0) {
+    memmove(buffer, buffer + start, end - start);
+    end -= start;
+    start = 0;
+  }
+
+  if (end == capacity) {
+    capacity = (capacity == 0) ? INPUT_BLOCK : capacity * 2;
+    buffer = (char*)realloc(buffer, capacity);
+    if (buffer == NULL)
+      panic("out of memory (fill)");
+  }
+
+  size_t n = 0;
+
+#if defined(INPUT_READ)
+  ssize_t got;
+  do {
+    got = read(fileno(stdin), buffer + end, capacity - end);
+  } while (got < 0 && errno == EINTR);
+
+  if (got > 0)
+    n = (size_t)got;
+#else
+  size_t room = capacity - end;
+  if (room > 1 && fgets(buffer + end, (int)((room < 0x7FFFFFFF) ? room : 0x7FFFFFFF), stdin) != NULL)
+    n = strlen(buffer + end);
+#endif
+
+  if (n == 0) {
+    eof = true;
+    return false;
+  }
+
+  end += n;
+  return true;
+}
+
+//
+// input_line
+//
+// Returns the next line of stdin, '\n' and all, or NULL at the end.
+//
+const char* input_line(size_t* length)
+{
+  for (;;) {
+    if (end - start > searched) {
+      char* newline = (char*)memchr(buffer + start + searched, '\n', end - start - searched);
+      if (newline != NULL) {
+        char* line = buffer + start;
+        *length = (size_t)(newline + 1 - line);
+        start += *length;
+        searched = 0;
+        return line;
+      }
+      searched = end - start;
+    }
+
+    if (!fill())
+      break;
+  }
+
+  //
+  // the end of stdin: the last line, if it doesn't end in '\n':
+  //
+  if (end == start)
+    return NULL;
+
+  char* line = buffer + start;
+  *length = end - start;
+  start = end;
+  searched = 0;
+  return line;
+}
+
+//
+// input_string
+//
+// Returns the next line of stdin, up to the first '\r', '\n' or '\0',
+// as a new rstring.
+//
+char* input_string(void)
+{
+  size_t length = 0;
+  const char* line = input_line(&length);
+
+  if (line == NULL)
+    return rstr_new("", 0);
+
+  size_t n = 0;
+  while (n < length && line[n] != '\r' && line[n] != '\n' && line[n] != '\0')
+    n++;
+
+  return rstr_new(line, (int)n);
+}
@@ -0,0 +1,45 @@
+/*input.h*/
+
+//
+// Keyboard input for nuPython: stdin is read in large blocks, straight
+// into one buffer, and handed out a line at a time --- lines of any
+// length, with no call into stdio per line. The lexer reads a program
+// typed at the keyboard through here too (see lexer.h), so the lines
+// after the $ line are left in the buffer for input().
+//
+// NOTE: stdin must not also be read through stdio (fgets, fgetc, ...),
+// which reads ahead into a buffer of its own.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stddef.h>   // size_t
+
+
+//
+// Public functions:
+//
+
+//
+// input_line
+//
+// Reads the next line of stdin, and returns it, '\n' and all (there
+// is no '\n' on a last line that doesn't end in one); *length is set
+// to its # of bytes. The line is not '\0'-terminated, and is valid
+// until the next call. Returns NULL at the end of stdin.
+//
+const char* input_line(size_t* length);
+
+//
+// input_string
+//
+// Reads the next line of stdin for input(), and returns it as a new
+// rstring (see rstring.h) the caller owns. The line ends at the first
+// '\r' or '\n' (or '\0'), which is not part of it; at the end of stdin
+// the string is "".
+//
+char* input_string(void);
@@ -0,0 +1,654 @@
+/*jit.c*/
+
+//
+// Tracing JIT for the nuPython VM (see jit.h).
+//
+// A trace is a function int trace(struct RAM_CELL* cells) that runs
+// the loop until it exits or reaches something it cannot do, and
+// returns the index of the instruction the VM resumes at (-1 if its
+// type checks failed on entry). rdi holds the cells throughout, and
+// every variable is at a fixed offset from it: a variable's address
+// never changes once it has been written, and the memory may move
+// (when it grows) only between calls. ints are computed in eax and
+// ecx, reals in xmm0 and xmm1, and nothing is kept in registers from
+// one instruction to the next.
+//
+// A side exit is a conditional jump around "mov eax, index; ret", so
+// the trace needs no jump patching at all, and the only jump back is
+// the one to the top of the loop.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stddef.h>   // offsetof
+
+#if defined(__x86_64__)
+#include <sys/mman.h>  // mmap, mprotect, munmap
+#endif
+
+#include "bytecode.h"
+#include "ram.h"
+#include "jit.h"
+
+
+//
+// # of trips around a loop before it is compiled, and # of times a
+// trace may fail its type checks before the loop is left to the VM:
+//
+#define JIT_HOT      50
+#define JIT_FAILURES 8
+
+typedef int (*TRACE_FUNCTION)(struct RAM_CELL* cells);
+
+//
+// What the JIT knows about one loop, by header:
+//
+struct TRACE
+{
+  int trips;                // # of times the loop went back to its header
+  int failures;             // # of times the trace's type checks failed
+  bool blacklisted;         // true => could not compile, or types unstable
+  TRACE_FUNCTION function;  // the machine code, NULL => not compiled yet
+  void* region;             // the mmap'd region holding it
+  size_t size;
+};
+
+struct JIT
+{
+  struct BYTECODE* code;
+  struct TRACE* traces;  // one per instruction, only headers are used
+};
+
+//
+// Machine code being emitted:
+//
+struct EMITTER
+{
+  unsigned char* bytes;
+  int length;
+  int capacity;
+};
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**JIT ERROR\n");
+  printf("**JIT ERROR: %s\n", msg);
+  printf("**JIT ERROR\n");
+
+  exit(-123);
+}
+
+
+#if defined(__x86_64__)
+
+//
+// x86-64 condition codes, for jcc rel8 (0x70 + cc). Each code xor 1
+// is its opposite.
+//
+#define CC_B   0x2  // below (unsigned <), i.e. CF = 1
+#define CC_AE  0x3
+#define CC_E   0x4
+#define CC_NE  0x5
+#define CC_BE  0x6
+#define CC_A   0x7
+#define CC_L   0xC
+#define CC_GE  0xD
+#define CC_LE  0xE
+#define CC_G   0xF
+
+//
+// Operand kinds for a trace: every operand is an int or a real,
+// either a constant or a variable in memory.
+//
+enum TRACE_TYPES
+{
+  TRACE_NONE = 0,  // not supported, side exit
+  TRACE_INT,
+  TRACE_REAL
+};
+
+//
+// emit
+//
+// Appends bytes to the machine code.
+//
+static void emit(struct EMITTER* e, const unsigned char* bytes, int n)
+{
+  if (e->length + n > e->capacity) {
+    e->capacity = 2 * (e->length + n);
+    e->bytes = (unsigned char*)realloc(e->bytes, e->capacity);
+    if (e->bytes == NULL)
+      panic("out of memory (emit)");
+  }
+  memcpy(e->bytes + e->length, bytes, n);
+  e->length += n;
+}
+
+static void emit1(struct EMITTER* e, unsigned char byte)
+{
+  emit(e, &byte, 1);
+}
+
+static void emit4(struct EMITTER* e, int value)
+{
+  unsigned char bytes[4];
+  for (int i = 0; i < 4; i++)
+    bytes[i] = (unsigned char)((unsigned)value >> (8 * i));
+  emit(e, bytes, 4);
+}
+
+static void emit8(struct EMITTER* e, long long value)
+{
+  unsigned char bytes[8];
+  for (int i = 0; i < 8; i++)
+    bytes[i] = (unsigned char)((unsigned long long)value >> (8 * i));
+  emit(e, bytes, 8);
+}
+
+//
+// emit_exit
+//
+// Emits a side exit to the given instruction: mov eax, index; ret.
+//
+static void emit_exit(struct EMITTER* e, int index)
+{
+  emit1(e, 0xB8);
+  emit4(e, index);
+  emit1(e, 0xC3);
+}
+
+//
+// emit_exit_if
+//
+// Emits a side exit to the given instruction, taken if the flags
+// satisfy the condition code: a jump around the exit if they don't.
+//
+static void emit_exit_if(struct EMITTER* e, int cc, int index)
+{
+  emit1(e, 0x70 + (cc ^ 1));
+  emit1(e, 6);  // length of the exit
+  emit_exit(e, index);
+}
+
+//
+// value_offset, type_offset
+//
+// Offsets from the cells of the value and the type of the cell at
+// the given address.
+//
+static int value_offset(int address)
+{
+  return address * (int)sizeof(struct RAM_CELL) + (int)offsetof(struct RAM_CELL, value) + (int)offsetof(struct RAM_VALUE, types);
+}
+
+static int type_offset(int address)
+{
+  return address * (int)sizeof(struct RAM_CELL) + (int)offsetof(struct RAM_CELL, value) + (int)offsetof(struct RAM_VALUE, value_type);
+}
+
+//
+// The state of a trace being compiled:
+//
+struct RECORDER
+{
+  struct BYTECODE* code;
+  struct EMITTER e;
+
+  int* addresses;  // slot -> memory address, -1 => not defined
+  int* types;      // slot -> TRACE_ type its variable has, by address
+  bool* guarded;   // slot -> true => the trace reads or writes it
+};
+
+//
+// operand_type
+//
+// Returns the TRACE_ type of an operand, TRACE_NONE if the trace
+// cannot handle it.
+//
+static int operand_type(struct RECORDER* r, struct OPERAND operand)
+{
+  if (operand.kind == OPND_CONST) {
+    int type = r->code->constants[operand.index].value_type;
+    return (type == RAM_TYPE_INT) ? TRACE_INT : (type == RAM_TYPE_REAL) ? TRACE_REAL : TRACE_NONE;
+  }
+  if (operand.kind == OPND_VAR && r->addresses[operand.index] >= 0)
+    return r->types[operand.index];
+  return TRACE_NONE;
+}
+
+//
+// load_int
+//
+// Emits code to load an int operand into eax (reg 0) or ecx (reg 1).
+//
+static void load_int(struct RECORDER* r, struct OPERAND operand, int reg)
+{
+  if (operand.kind == OPND_CONST) {
+    emit1(&r->e, 0xB8 + reg);  // mov r32, imm32
+    emit4(&r->e, r->code->constants[operand.index].types.i);
+  } else {
+    r->guarded[operand.index] = true;
+    emit1(&r->e, 0x8B);  // mov r32, [rdi + disp32]
+    emit1(&r->e, 0x87 | (reg << 3));
+    emit4(&r->e, value_offset(r->addresses[operand.index]));
+  }
+}
+
+//
+// load_real
+//
+// Emits code to load a real operand into xmm0 (reg 0) or xmm1 (reg 1).
+//
+static void load_real(struct RECORDER* r, struct OPERAND operand, int reg)
+{
+  if (operand.kind == OPND_CONST) {
+    long long bits;
+    memcpy(&bits, &r->code->constants[operand.index].types.d, sizeof(bits));
+    emit(&r->e, (unsigned char[]) { 0x48, 0xB8 }, 2);  // mov rax, imm64
+    emit8(&r->e, bits);
+    emit(&r->e, (unsigned char[]) { 0x66, 0x48, 0x0F, 0x6E, 0xC0 | (reg << 3) }, 5);  // movq xmm, rax
+  } else {
+    r->guarded[operand.index] = true;
+    emit(&r->e, (unsigned char[]) { 0xF2, 0x0F, 0x10, 0x87 | (reg << 3) }, 4);  // movsd xmm, [rdi + disp32]
+    emit4(&r->e, value_offset(r->addresses[operand.index]));
+  }
+}
+
+//
+// store
+//
+// Emits code to store eax (TRACE_INT) or xmm0 (TRACE_REAL) into the
+// variable in the given slot.
+//
+static void store(struct RECORDER* r, int slot, int type)
+{
+  r->guarded[slot] = true;
+  if (type == TRACE_INT)
+    emit(&r->e, (unsigned char[]) { 0x89, 0x87 }, 2);  // mov [rdi + disp32], eax
+  else
+    emit(&r->e, (unsigned char[]) { 0xF2, 0x0F, 0x11, 0x87 }, 4);  // movsd [rdi + disp32], xmm0
+  emit4(&r->e, value_offset(r->addresses[slot]));
+}
+
+//
+// arithmetic_op
+//
+// Returns OP_ADD, OP_SUB, OP_MUL or OP_DIV for the instructions that
+// do one of them on two operands, -1 for anything else.
+//
+static int arithmetic_op(int opcode)
+{
+  switch (opcode) {
+  case OP_ADD: case OP_ADD_II: case OP_ADD_RR: case OP_APPEND:
+  case OP_INC_II: case OP_ADD_TO_II: case OP_LOOP_INC_LT:
+    return OP_ADD;
+  case OP_SUB: case OP_SUB_II: case OP_SUB_RR:
+    return OP_SUB;
+  case OP_MUL: case OP_MUL_II: case OP_MUL_RR:
+    return OP_MUL;
+  case OP_DIV: case OP_DIV_II: case OP_DIV_RR:
+    return OP_DIV;
+  default:
+    return -1;
+  }
+}
+
+//
+// relational_op
+//
+// Returns OP_LT ... OP_GTE for the instructions that compare two
+// operands, -1 for anything else.
+//
+static int relational_op(int opcode)
+{
+  if (opcode >= OP_EQ && opcode <= OP_GTE)
+    return opcode;
+  if (opcode >= OP_EQ_II && opcode <= OP_GTE_II)
+    return OP_EQ + (opcode - OP_EQ_II);
+  if (opcode >= OP_EQ_RR && opcode <= OP_GTE_RR)
+    return OP_EQ + (opcode - OP_EQ_RR);
+  if (opcode == OP_BRANCH_LT_II || opcode == OP_LOOP_LT)
+    return OP_LT;
+  return -1;
+}
+
+//
+// record_arithmetic
+//
+// Emits dst = a op b, for two ints or two reals stored to a variable
+// of the same type. Returns false if the trace cannot do it.
+//
+static bool record_arithmetic(struct RECORDER* r, struct INSTR* instr, int op, int index)
+{
+  int type = operand_type(r, instr->a);
+
+  if (type == TRACE_NONE || operand_type(r, instr->b) != type)
+    return false;
+  if (instr->dst.kind != OPND_VAR || operand_type(r, instr->dst) != type)
+    return false;
+
+  if (type == TRACE_INT) {
+    load_int(r, instr->a, 0);
+    load_int(r, instr->b, 1);
+    if (op == OP_ADD)
+      emit(&r->e, (unsigned char[]) { 0x01, 0xC8 }, 2);  // add eax, ecx
+    else if (op == OP_SUB)
+      emit(&r->e, (unsigned char[]) { 0x29, 0xC8 }, 2);  // sub eax, ecx
+    else if (op == OP_MUL)
+      emit(&r->e, (unsigned char[]) { 0x0F, 0xAF, 0xC1 }, 3);  // imul eax, ecx
+    else {
+      // the VM reports division by 0 (and does INT_MIN / -1):
+      emit(&r->e, (unsigned char[]) { 0x85, 0xC9 }, 2);  // test ecx, ecx
+      emit_exit_if(&r->e, CC_E, index);
+      emit(&r->e, (unsigned char[]) { 0x83, 0xF9, 0xFF }, 3);  // cmp ecx, -1
+      emit_exit_if(&r->e, CC_E, index);
+      emit(&r->e, (unsigned char[]) { 0x99, 0xF7, 0xF9 }, 3);  // cdq; idiv ecx
+    }
+  } else {
+    load_real(r, instr->a, 0);
+    load_real(r, instr->b, 1);
+    if (op == OP_ADD)
+      emit(&r->e, (unsigned char[]) { 0xF2, 0x0F, 0x58, 0xC1 }, 4);  // addsd xmm0, xmm1
+    else if (op == OP_SUB)
+      emit(&r->e, (unsigned char[]) { 0xF2, 0x0F, 0x5C, 0xC1 }, 4);  // subsd xmm0, xmm1
+    else if (op == OP_MUL)
+      emit(&r->e, (unsigned char[]) { 0xF2, 0x0F, 0x59, 0xC1 }, 4);  // mulsd xmm0, xmm1
+    else {
+      // the VM reports division by 0.0:
+      emit(&r->e, (unsigned char[]) { 0x66, 0x0F, 0x57, 0xD2 }, 4);  // xorpd xmm2, xmm2
+      emit(&r->e, (unsigned char[]) { 0x66, 0x0F, 0x2E, 0xCA }, 4);  // ucomisd xmm1, xmm2
+      emit_exit_if(&r->e, CC_E, index);
+      emit(&r->e, (unsigned char[]) { 0xF2, 0x0F, 0x5E, 0xC1 }, 4);  // divsd xmm0, xmm1
+    }
+  }
+
+  store(r, instr->dst.index, type);
+  return true;
+}
+
+//
+// record_condition
+//
+// Emits a loop test: the comparison a op b, and a side exit to the
+// given instruction (the loop exit) if it is false. Returns false if
+// the trace cannot do it.
+//
+static bool record_condition(struct RECORDER* r, struct INSTR* instr, int op, int exit)
+{
+  int type = operand_type(r, instr->a);
+
+  if (type == TRACE_NONE || operand_type(r, instr->b) != type)
+    return false;
+
+  if (type == TRACE_INT) {
+    static const int exit_cc[] = { CC_NE, CC_E, CC_GE, CC_G, CC_LE, CC_L };  // EQ ... GTE
+    load_int(r, instr->a, 0);
+    load_int(r, instr->b, 1);
+    emit(&r->e, (unsigned char[]) { 0x39, 0xC8 }, 2);  // cmp eax, ecx
+    emit_exit_if(&r->e, exit_cc[op - OP_EQ], exit);
+    return true;
+  }
+
+  // reals: a < b is b above a, and unordered (NaN) sets CF, so every
+  // comparison with a NaN is false, as in C:
+  if (op == OP_EQ || op == OP_NE)
+    return false;
+  load_real(r, instr->a, 0);
+  load_real(r, instr->b, 1);
+  if (op == OP_LT || op == OP_LTE)
+    emit(&r->e, (unsigned char[]) { 0x66, 0x0F, 0x2E, 0xC8 }, 4);  // ucomisd xmm1, xmm0
+  else
+    emit(&r->e, (unsigned char[]) { 0x66, 0x0F, 0x2E, 0xC1 }, 4);  // ucomisd xmm0, xmm1
+  emit_exit_if(&r->e, (op == OP_LT || op == OP_GT) ? CC_BE : CC_B, exit);
+  return true;
+}
+
+//
+// record_move
+//
+// Emits dst = a for an int or real. Returns false if the trace
+// cannot do it.
+//
+static bool record_move(struct RECORDER* r, struct INSTR* instr)
+{
+  int type = operand_type(r, instr->a);
+
+  if (type == TRACE_NONE || instr->dst.kind != OPND_VAR || operand_type(r, instr->dst) != type)
+    return false;
+
+  if (type == TRACE_INT)
+    load_int(r, instr->a, 0);
+  else
+    load_real(r, instr->a, 0);
+  store(r, instr->dst.index, type);
+  return true;
+}
+
+//
+// record_body
+//
+// Emits the trip around the loop, from the header to the back edge.
+// Stops with a side exit at the first instruction the trace cannot
+// do. Returns the # of instructions compiled.
+//
+static int record_body(struct RECORDER* r, int header, int back_edge, int top)
+{
+  struct INSTR* code = r->code->code;
+  int exit = back_edge + 1;
+
+  for (int index = header; index <= back_edge; index++) {
+    struct INSTR* instr = &code[index];
+    int opcode = instr->opcode;
+    bool done = false;
+
+    if (index == back_edge) {
+      // jmp rel32, back to the top of the loop:
+      emit1(&r->e, 0xE9);
+      emit4(&r->e, top - (r->e.length + 4));
+      return index - header + 1;
+    }
+
+    int op = relational_op(opcode);
+    if (op >= 0) {
+      // a loop test: the comparison, then jump_if_false to the exit
+      struct INSTR* branch = &code[index + 1];
+      if (branch->opcode == OP_JUMP_IF_FALSE && branch->target == exit
+        && (opcode == OP_BRANCH_LT_II || opcode == OP_LOOP_LT
+          || (instr->dst.kind == OPND_REG && branch->a.kind == OPND_REG && branch->a.index == instr->dst.index))) {
+        done = record_condition(r, instr, op, exit);
+        if (done)
+          index++;  // the jump_if_false is done too
+      }
+    }
+    else if ((op = arithmetic_op(opcode)) >= 0)
+      done = record_arithmetic(r, instr, op, index);
+    else if (opcode == OP_MOVE)
+      done = record_move(r, instr);
+
+    if (!done) {  // the VM takes it from here
+      emit_exit(&r->e, index);
+      return index - header;
+    }
+  }
+  return back_edge - header + 1;
+}
+
+//
+// compile_trace
+//
+// Records the loop from header to back_edge, specialized to the types
+// its variables have in memory right now, and installs the machine
+// code. Returns false if there is nothing worth compiling.
+//
+static bool compile_trace(struct JIT* jit, int header, int back_edge, struct RAM* memory)
+{
+  struct BYTECODE* code = jit->code;
+  struct SYMTAB* symbols = code->symbols;
+  struct TRACE* trace = &jit->traces[header];
+  int num_slots = symbols->num_slots + 1;  // + 1 so nothing is 0 bytes
+
+  struct RECORDER r;
+  r.code = code;
+  r.e.length = 0;
+  r.e.capacity = 256;
+  r.e.bytes = (unsigned char*)malloc(r.e.capacity);
+  r.addresses = (int*)malloc(num_slots * sizeof(int));
+  r.types = (int*)malloc(num_slots * sizeof(int));
+  r.guarded = (bool*)calloc(num_slots, sizeof(bool));
+
+  if (r.e.bytes == NULL || r.addresses == NULL || r.types == NULL || r.guarded == NULL)
+    panic("out of memory (compile_trace)");
+
+  for (int slot = 0; slot < symbols->num_slots; slot++) {
+    r.addresses[slot] = ram_get_addr(memory, symbols->names[slot]);
+    r.types[slot] = TRACE_NONE;
+    if (r.addresses[slot] >= 0) {
+      int type = ram_peek_cell_by_addr(memory, r.addresses[slot])->value_type;
+      r.types[slot] = (type == RAM_TYPE_INT) ? TRACE_INT : (type == RAM_TYPE_REAL) ? TRACE_REAL : TRACE_NONE;
+    }
+  }
+
+  //
+  // the body goes first, so we know which variables to check; the
+  // checks are put in front of it when the code is installed:
+  //
+  int compiled = record_body(&r, header, back_edge, 0);
+  struct EMITTER body = r.e;
+
+  struct EMITTER guards;
+  guards.length = 0;
+  guards.capacity = 256;
+  guards.bytes = (unsigned char*)malloc(guards.capacity);
+  if (guards.bytes == NULL)
+    panic("out of memory (compile_trace)");
+
+  for (int slot = 0; slot < symbols->num_slots; slot++) {
+    if (!r.guarded[slot])
+      continue;
+    // cmp dword [rdi + disp32], imm8; exit to the VM if it differs
+    emit(&guards, (unsigned char[]) { 0x83, 0xBF }, 2);
+    emit4(&guards, type_offset(r.addresses[slot]));
+    emit1(&guards, (r.types[slot] == TRACE_INT) ? RAM_TYPE_INT : RAM_TYPE_REAL);
+    emit_exit_if(&guards, CC_NE, -1);
+  }
+
+  bool success = (compiled > 0);
+  if (success) {
+    // the loop's jmp is relative to the top of the body, which is unchanged
+    size_t size = guards.length + body.length;
+    void* region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED)
+      success = false;
+    else {
+      memcpy(region, guards.bytes, guards.length);
+      memcpy((unsigned char*)region + guards.length, body.bytes, body.length);
+      if (mprotect(region, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(region, size);
+        success = false;
+      } else {
+        // the entry is the guards, and the loop goes back to the body:
+        memcpy(&trace->function, &region, sizeof(region));
+        trace->region = region;
+        trace->size = size;
+      }
+    }
+  }
+
+  free(guards.bytes);
+  free(r.e.bytes);
+  free(r.addresses);
+  free(r.types);
+  free(r.guarded);
+
+  return success;
+}
+
+#endif
+
+
+//
+// jit_init
+//
+// Returns a JIT for the given bytecode, with no traces yet.
+//
+struct JIT* jit_init(struct BYTECODE* code)
+{
+  struct JIT* jit = (struct JIT*)malloc(sizeof(struct JIT));
+  if (jit == NULL)
+    panic("out of memory (jit_init)");
+
+  jit->code = code;
+  jit->traces = (struct TRACE*)calloc(code->num_instrs + 1, sizeof(struct TRACE));
+  if (jit->traces == NULL)
+    panic("out of memory (jit_init)");
+
+  return jit;
+}
+
+//
+// jit_loop
+//
+// Profiles the loop, compiles it once it is hot, and runs its trace
+// if it has one. Returns the instruction the VM should go on with,
+// or -1 to go on with the header.
+//
+int jit_loop(struct JIT* jit, int header, int back_edge, struct RAM* memory)
+{
+#if defined(__x86_64__)
+  struct TRACE* trace = &jit->traces[header];
+
+  if (trace->blacklisted)
+    return -1;
+
+  if (trace->function == NULL) {
+    trace->trips++;
+    if (trace->trips < JIT_HOT)
+      return -1;
+    if (!compile_trace(jit, header, back_edge, memory)) {
+      trace->blacklisted = true;
+      return -1;
+    }
+  }
+
+  int resume = trace->function(memory->cells);
+  if (resume < 0) {  // the types changed since the loop was compiled
+    trace->failures++;
+    if (trace->failures >= JIT_FAILURES)
+      trace->blacklisted = true;
+  }
+  return resume;
+#else
+  return -1;  // nothing is ever compiled
+#endif
+}
+
+//
+// jit_destroy
+//
+// Frees the JIT and all of its machine code.
+//
+void jit_destroy(struct JIT* jit)
+{
+#if defined(__x86_64__)
+  for (int i = 0; i < jit->code->num_instrs; i++) {
+    if (jit->traces[i].region != NULL)
+      munmap(jit->traces[i].region, jit->traces[i].size);
+  }
+#endif
+  free(jit->traces);
+  free(jit);
+}
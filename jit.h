@@ -0,0 +1,63 @@
+/*jit.h*/
+
+//
+// Tracing JIT for the nuPython VM, for x86-64. The VM reports every
+// trip around a while loop; once a loop is hot, the JIT records a
+// trace of its body, specialized to the int and real types its
+// variables hold at that moment, and emits it as x86-64 machine code
+// into an executable mmap'd region. From then on the trip around the
+// loop runs the machine code instead.
+//
+// A trace checks the types of all its variables when it is entered,
+// and returns to the VM at once if any has changed. The parts of the
+// body it cannot compile --- strings, pointers, print(), input(), and
+// so on --- are side exits: the trace returns to the VM at that
+// instruction, and the VM runs the rest of the trip itself. Since a
+// trace stores every result straight to memory, the VM can pick up
+// wherever it left off.
+//
+// The JIT is off unless the VM is asked for it (see -jit in main.c).
+// On other platforms nothing is ever compiled, and the VM runs as is.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include "bytecode.h"
+#include "ram.h"
+
+
+struct JIT;  // the compiled traces, and each loop's profile (see jit.c)
+
+
+//
+// Public functions:
+//
+
+//
+// jit_init
+//
+// Returns a JIT for the given bytecode, with no traces yet.
+//
+struct JIT* jit_init(struct BYTECODE* code);
+
+//
+// jit_loop
+//
+// Called by the VM each time a loop goes back to its header (the
+// first instruction of the condition); back_edge is the jump at the
+// end of the loop. If the loop has a trace that could run, runs it
+// and returns the index of the instruction the VM should go on with.
+// Otherwise returns -1, and the VM goes on with the header as usual.
+//
+int jit_loop(struct JIT* jit, int header, int back_edge, struct RAM* memory);
+
+//
+// jit_destroy
+//
+// Frees the JIT and all of its machine code.
+//
+void jit_destroy(struct JIT* jit);
@@ -0,0 +1,641 @@
+/*lexer.c*/
+
+//
+// Bulk scanner for nuPython (see lexer.h). The rules are those of
+// scanner_nextToken, character for character --- e.g. "89." is a real,
+// a lone "." is unknown, "!" is unknown unless followed by "=", and a
+// comment counts towards the column of the next token on its line ---
+// so the two scanners can be used interchangeably.
+//
+// The inner loops --- runs of blanks, comments, identifiers, string
+// literals --- are kernels that find the first byte ending the run. On
+// x86-64 they test 16 (SSE2) or 32 (AVX2) bytes at a time, chosen when
+// the first lexer is opened by what the CPU supports; elsewhere, and
+// for the last few bytes of the source, they go a byte at a time.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#define _DEFAULT_SOURCE  // fileno, getline
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <ctype.h>    // isspace, isalpha, isdigit, isalnum
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>  // mmap, munmap
+#include <sys/stat.h>  // fstat
+#define LEXER_MMAP
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>  // SSE2, AVX2
+#define LEXER_SIMD
+#endif
+
+#include "token.h"
+#include "lexer.h"
+#include "input.h"
+
+
+//
+// keywords, in the order of their token ids (see token.h):
+//
+static const char* keywords[] = {
+  "and", "break", "continue", "def", "elif", "else", "False", "for", "if",
+  "in", "is", "None", "not", "or", "pass", "return", "True", "while"
+};
+
+#define NUM_KEYWORDS (int)(sizeof(keywords) / sizeof(keywords[0]))
+
+
+//
+// kernels: each returns the offset of the first byte at or after pos
+// that ends the run, or end if the run goes to the end of the source.
+// A blank is whitespace other than '\n'; a comment and a string literal
+// stop at '\n' (and the latter at its quote, too).
+//
+struct KERNELS
+{
+  size_t (*skip_blanks)(const char* bytes, size_t pos, size_t end);
+  size_t (*skip_identifier)(const char* bytes, size_t pos, size_t end);
+  size_t (*skip_comment)(const char* bytes, size_t pos, size_t end);
+  size_t (*skip_string)(const char* bytes, size_t pos, size_t end, char quote);
+};
+
+static struct KERNELS kernels;
+static int selected = -1;  // the LEXER_KERNELS in use, -1 => not yet chosen
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**LEXER ERROR\n");
+  printf("**LEXER ERROR: %s\n", msg);
+  printf("**LEXER ERROR\n");
+
+  exit(-123);
+}
+
+//
+// id_or_keyword
+//
+// Returns the token id of the given identifier: the keyword's id
+// if it is one, nuPy_IDENTIFIER otherwise.
+//
+static int id_or_keyword(const char* start, size_t length)
+{
+  if (length > 8)  // longer than "continue"
+    return nuPy_IDENTIFIER;
+
+  for (int i = 0; i < NUM_KEYWORDS; i++) {
+    if (keywords[i][0] == start[0] && strncmp(keywords[i], start, length) == 0 && keywords[i][length] == '\0')
+      return nuPy_KEYW_AND + i;
+  }
+  return nuPy_IDENTIFIER;
+}
+
+//
+// is_blank / is_identifier
+//
+// The character classes of the kernels, as isspace and isalnum in the
+// "C" locale.
+//
+static bool is_blank(unsigned char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static bool is_identifier(unsigned char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+//
+// scalar kernels, a byte at a time:
+//
+static size_t scalar_skip_blanks(const char* bytes, size_t pos, size_t end)
+{
+  while (pos < end && is_blank((unsigned char)bytes[pos]))
+    pos++;
+  return pos;
+}
+
+static size_t scalar_skip_identifier(const char* bytes, size_t pos, size_t end)
+{
+  while (pos < end && is_identifier((unsigned char)bytes[pos]))
+    pos++;
+  return pos;
+}
+
+static size_t scalar_skip_comment(const char* bytes, size_t pos, size_t end)
+{
+  while (pos < end && bytes[pos] != '\n')
+    pos++;
+  return pos;
+}
+
+static size_t scalar_skip_string(const char* bytes, size_t pos, size_t end, char quote)
+{
+  while (pos < end && bytes[pos] != quote && bytes[pos] != '\n')
+    pos++;
+  return pos;
+}
+
+#if defined(LEXER_SIMD)
+
+//
+// SSE2 kernels, 16 bytes at a time. Each builds a mask of the bytes
+// that end the run, and the first set bit is the answer; an unsigned
+// x <= n is min(x, n) == x, since SSE2 only compares signed bytes.
+//
+static size_t sse2_skip_blanks(const char* bytes, size_t pos, size_t end)
+{
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i four = _mm_set1_epi8(4);
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  for (; pos + 16 <= end; pos += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(bytes + pos));
+    __m128i controls = _mm_sub_epi8(x, tab);  // \t \n \v \f \r => 0..4
+    __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(x, space),
+                    _mm_andnot_si128(_mm_cmpeq_epi8(x, newline),
+                                     _mm_cmpeq_epi8(_mm_min_epu8(controls, four), controls)));
+    unsigned stops = ~(unsigned)_mm_movemask_epi8(blank) & 0xFFFF;
+    if (stops != 0)
+      return pos + __builtin_ctz(stops);
+  }
+  return scalar_skip_blanks(bytes, pos, end);
+}
+
+static size_t sse2_skip_identifier(const char* bytes, size_t pos, size_t end)
+{
+  const __m128i lower_a = _mm_set1_epi8('a');
+  const __m128i digit_0 = _mm_set1_epi8('0');
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+  const __m128i letters = _mm_set1_epi8(25);
+  const __m128i digits = _mm_set1_epi8(9);
+  const __m128i underscore = _mm_set1_epi8('_');
+
+  for (; pos + 16 <= end; pos += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(bytes + pos));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(x, case_bit), lower_a);  // A-Z, a-z => 0..25
+    __m128i digit = _mm_sub_epi8(x, digit_0);                          // 0-9 => 0..9
+    __m128i ident = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(letter, letters), letter),
+                                              _mm_cmpeq_epi8(_mm_min_epu8(digit, digits), digit)),
+                                 _mm_cmpeq_epi8(x, underscore));
+    unsigned stops = ~(unsigned)_mm_movemask_epi8(ident) & 0xFFFF;
+    if (stops != 0)
+      return pos + __builtin_ctz(stops);
+  }
+  return scalar_skip_identifier(bytes, pos, end);
+}
+
+static size_t sse2_skip_comment(const char* bytes, size_t pos, size_t end)
+{
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  for (; pos + 16 <= end; pos += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(bytes + pos));
+    unsigned stops = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, newline));
+    if (stops != 0)
+      return pos + __builtin_ctz(stops);
+  }
+  return scalar_skip_comment(bytes, pos, end);
+}
+
+static size_t sse2_skip_string(const char* bytes, size_t pos, size_t end, char quote)
+{
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i quotes = _mm_set1_epi8(quote);
+
+  for (; pos + 16 <= end; pos += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(bytes + pos));
+    unsigned stops = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, newline), _mm_cmpeq_epi8(x, quotes)));
+    if (stops != 0)
+      return pos + __builtin_ctz(stops);
+  }
+  return scalar_skip_string(bytes, pos, end, quote);
+}
+
+//
+// AVX2 kernels, the same 32 bytes at a time; compiled for AVX2 on
+// their own, so the rest of nuPython still runs on any x86-64:
+//
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static size_t avx2_skip_blanks(const char* bytes, size_t pos, size_t end)
+{
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i four = _mm256_set1_epi8(4);
+  const __m256i newline = _mm256_set1_epi8('\n');
+
+  for (; pos + 32 <= end; pos += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(bytes + pos));
+    __m256i controls = _mm256_sub_epi8(x, tab);
+    __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(x, space),
+                    _mm256_andnot_si256(_mm256_cmpeq_epi8(x, newline),
+                                        _mm256_cmpeq_epi8(_mm256_min_epu8(controls, four), controls)));
+    unsigned stops = ~(unsigned)_mm256_movemask_epi8(blank);
+    if (stops != 0)
+      return pos + __builtin_ctz(stops);
+  }
+  return sse2_skip_blanks(bytes, pos, end);
+}
+
+AVX2 static size_t avx2_skip_identifier(const char* bytes, size_t pos, size_t end)
+{
+  const __m256i lower_a = _mm256_set1_epi8('a');
+  const __m256i digit_0 = _mm256_set1_epi8('0');
+  const __m256i case_bit = _mm256_set1_epi8(0x20);
+  const __m256i letters = _mm256_set1_epi8(25);
+  const __m256i digits = _mm256_set1_epi8(9);
+  const __m256i underscore = _mm256_set1_epi8('_');
+
+  for (; pos + 32 <= end; pos += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(bytes + pos));
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(x, case_bit), lower_a);
+    __m256i digit = _mm256_sub_epi8(x, digit_0);
+    __m256i ident = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(letter, letters), letter),
+                                                    _mm256_cmpeq_epi8(_mm256_min_epu8(digit, digits), digit)),
+                                    _mm256_cmpeq_epi8(x, underscore));
+    unsigned stops = ~(unsigned)_mm256_movemask_epi8(ident);
+    if (stops != 0)
+      return pos + __builtin_ctz(stops);
+  }
+  return sse2_skip_identifier(bytes, pos, end);
+}
+
+AVX2 static size_t avx2_skip_comment(const char* bytes, size_t pos, size_t end)
+{
+  const __m256i newline = _mm256_set1_epi8('\n');
+
+  for (; pos + 32 <= end; pos += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(bytes + pos));
+    unsigned stops = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, newline));
+    if (stops != 0)
+      return pos + __builtin_ctz(stops);
+  }
+  return sse2_skip_comment(bytes, pos, end);
+}
+
+AVX2 static size_t avx2_skip_string(const char* bytes, size_t pos, size_t end, char quote)
+{
+  const __m256i newline = _mm256_set1_epi8('\n');
+  const __m256i quotes = _mm256_set1_epi8(quote);
+
+  for (; pos + 32 <= end; pos += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(bytes + pos));
+    unsigned stops = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, newline), _mm256_cmpeq_epi8(x, quotes)));
+    if (stops != 0)
+      return pos + __builtin_ctz(stops);
+  }
+  return sse2_skip_string(bytes, pos, end, quote);
+}
+
+#endif
+
+//
+// lexer_kernels
+//
+// Selects the fastest kernels the CPU supports, up to the given ones,
+// and returns those selected.
+//
+int lexer_kernels(int wanted)
+{
+  int best = LEXER_SCALAR;
+
+#if defined(LEXER_SIMD)
+  __builtin_cpu_init();
+  best = __builtin_cpu_supports("avx2") ? LEXER_AVX2 : LEXER_SSE2;  // SSE2 is part of x86-64
+#endif
+
+  selected = (wanted < best) ? wanted : best;
+
+  if (selected == LEXER_SCALAR) {
+    kernels.skip_blanks = scalar_skip_blanks;
+    kernels.skip_identifier = scalar_skip_identifier;
+    kernels.skip_comment = scalar_skip_comment;
+    kernels.skip_string = scalar_skip_string;
+  }
+#if defined(LEXER_SIMD)
+  else if (selected == LEXER_SSE2) {
+    kernels.skip_blanks = sse2_skip_blanks;
+    kernels.skip_identifier = sse2_skip_identifier;
+    kernels.skip_comment = sse2_skip_comment;
+    kernels.skip_string = sse2_skip_string;
+  }
+  else {
+    kernels.skip_blanks = avx2_skip_blanks;
+    kernels.skip_identifier = avx2_skip_identifier;
+    kernels.skip_comment = avx2_skip_comment;
+    kernels.skip_string = avx2_skip_string;
+  }
+#endif
+
+  return selected;
+}
+
+//
+// next_line
+//
+// Reads the next line of input, '\n' and all, as the bytes to scan.
+// Returns false at the end of the input.
+//
+static bool next_line(struct LEXER* lexer)
+{
+  size_t n = 0;
+
+  if (lexer->input == stdin) {  // read by input, into its buffer (see input.h):
+    const char* line = input_line(&n);
+    if (line == NULL)
+      return false;
+    lexer->bytes = (char*)line;
+  }
+  else {
+#if defined(LEXER_MMAP)
+    ssize_t read = getline(&lexer->bytes, &lexer->capacity, lexer->input);
+    if (read < 0)
+      return false;
+    n = (size_t)read;
+#else
+    int c = fgetc(lexer->input);
+    if (c == EOF)
+      return false;
+    while (c != EOF) {
+      if (n == lexer->capacity) {
+        lexer->capacity = (lexer->capacity == 0) ? 256 : lexer->capacity * 2;
+        lexer->bytes = (char*)realloc(lexer->bytes, lexer->capacity);
+        if (lexer->bytes == NULL)
+          panic("out of memory (next_line)");
+      }
+      lexer->bytes[n++] = (char)c;
+      if (c == '\n')
+        break;
+      c = fgetc(lexer->input);
+    }
+#endif
+  }
+
+  lexer->length = n;
+  lexer->pos = 0;
+  return true;
+}
+
+//
+// lexer_open
+//
+// Returns a lexer over the given input stream, from its current
+// position. The caller frees it with lexer_close.
+//
+struct LEXER* lexer_open(FILE* input)
+{
+  struct LEXER* lexer = (struct LEXER*)malloc(sizeof(struct LEXER));
+  if (lexer == NULL)
+    panic("out of memory (lexer_open)");
+
+  lexer->input = input;
+  lexer->bytes = NULL;
+  lexer->length = 0;
+  lexer->pos = 0;
+  lexer->capacity = 0;
+  lexer->mapped = false;
+  lexer->lines = true;
+  lexer->eof = false;
+  lexer->line = 1;
+  lexer->col = 1;
+
+  if (selected < 0)
+    lexer_kernels(LEXER_AVX2);
+
+#if defined(LEXER_MMAP)
+  //
+  // a file is mapped whole; stdin is left to be read line by line,
+  // even when it's a file, since input() reads on from where the
+  // program ends:
+  //
+  struct stat info;
+  long start = ftell(input);
+
+  if (input != stdin && start >= 0 && fstat(fileno(input), &info) == 0 && S_ISREG(info.st_mode)) {
+    lexer->lines = false;
+
+    if (info.st_size > start) {
+      void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+      if (data == MAP_FAILED) {
+        lexer->lines = true;  // read it line by line after all
+      }
+      else {
+        lexer->bytes = (char*)data;
+        lexer->length = (size_t)info.st_size;
+        lexer->pos = (size_t)start;
+        lexer->mapped = true;
+      }
+    }
+  }
+#endif
+
+  return lexer;
+}
+
+//
+// lexer_next
+//
+// Scans and returns the next token, with its value as a slice of
+// the source (see lexer.h).
+//
+struct Token lexer_next(struct LEXER* lexer, const char** value, size_t* length)
+{
+  struct Token token;
+
+  for (;;) {
+    if (lexer->pos == lexer->length && lexer->lines && !lexer->eof) {
+      if (!next_line(lexer))
+        lexer->eof = true;
+      continue;
+    }
+
+    const char* bytes = lexer->bytes;
+    size_t end = lexer->length;
+    size_t pos = lexer->pos;
+    int c = (pos < end) ? (unsigned char)bytes[pos] : EOF;
+
+    token.line = lexer->line;
+    token.col = lexer->col;
+    *length = 1;
+
+    if (c == EOF || c == '$') {
+      token.id = nuPy_EOS;
+      *value = "$";
+      if (c == '$')
+        lexer->pos++;
+      return token;
+    }
+
+    *value = bytes + pos;
+
+    if (c == '\n') {
+      token.id = nuPy_EOLN;
+      *value = "EOLN";
+      *length = 4;
+      lexer->pos++;
+      lexer->line++;
+      lexer->col = 1;
+      return token;
+    }
+
+    if (isspace(c)) {
+      lexer->pos = kernels.skip_blanks(bytes, pos + 1, end);
+      lexer->col += (int)(lexer->pos - pos);
+      continue;
+    }
+
+    if (c == '#') {  // the comment runs to the end of the line:
+      lexer->pos = kernels.skip_comment(bytes, pos + 1, end);
+      lexer->col += (int)(lexer->pos - pos);
+      continue;
+    }
+
+    pos++;
+    lexer->col++;
+
+    switch (c) {
+      case '(': token.id = nuPy_LEFT_PAREN; break;
+      case ')': token.id = nuPy_RIGHT_PAREN; break;
+      case '[': token.id = nuPy_LEFT_BRACKET; break;
+      case ']': token.id = nuPy_RIGHT_BRACKET; break;
+      case '{': token.id = nuPy_LEFT_BRACE; break;
+      case '}': token.id = nuPy_RIGHT_BRACE; break;
+      case '+': token.id = nuPy_PLUS; break;
+      case '-': token.id = nuPy_MINUS; break;
+      case '%': token.id = nuPy_PERCENT; break;
+      case '/': token.id = nuPy_SLASH; break;
+      case '&': token.id = nuPy_AMPERSAND; break;
+      case ':': token.id = nuPy_COLON; break;
+
+      case '*':
+      case '=':
+      case '!':
+      case '<':
+      case '>': {
+        char second = (c == '*') ? '*' : '=';
+        bool pair = (pos < end && bytes[pos] == second);
+
+        if (c == '*')
+          token.id = pair ? nuPy_POWER : nuPy_ASTERISK;
+        else if (c == '=')
+          token.id = pair ? nuPy_EQUALEQUAL : nuPy_EQUAL;
+        else if (c == '!')
+          token.id = pair ? nuPy_NOTEQUAL : nuPy_UNKNOWN;
+        else if (c == '<')
+          token.id = pair ? nuPy_LTE : nuPy_LT;
+        else
+          token.id = pair ? nuPy_GTE : nuPy_GT;
+
+        if (pair) {
+          pos++;
+          lexer->col++;
+          *length = 2;
+        }
+        break;
+      }
+
+      case '"':
+      case '\'': {
+        size_t start = pos;
+        pos = kernels.skip_string(bytes, pos, end, (char)c);
+        lexer->col += (int)(pos - start);
+
+        token.id = nuPy_STR_LITERAL;
+        *value = bytes + start;
+        *length = pos - start;
+
+        if (pos < end && bytes[pos] == c) {  // the closing quote:
+          pos++;
+          lexer->col++;
+        }
+        else {
+          printf("**WARNING: string literal @ (%d, %d) not terminated properly\n", token.line, token.col);
+        }
+
+        const char* nul = (const char*)memchr(*value, '\0', *length);  // a C string to the scanner
+        if (nul != NULL)
+          *length = nul - *value;
+        break;
+      }
+
+      default:
+        if (c == '_' || isalpha(c)) {
+          size_t start = pos;
+          pos = kernels.skip_identifier(bytes, pos, end);
+          lexer->col += (int)(pos - start);
+          *length = pos - lexer->pos;
+          token.id = id_or_keyword(*value, *length);
+        }
+        else if (c == '.' || isdigit(c)) {
+          if (c == '.' && !(pos < end && isdigit((unsigned char)bytes[pos]))) {
+            token.id = nuPy_UNKNOWN;  // a lone .
+          }
+          else {
+            token.id = (c == '.') ? nuPy_REAL_LITERAL : nuPy_INT_LITERAL;
+            while (pos < end && isdigit((unsigned char)bytes[pos])) {
+              pos++;
+              lexer->col++;
+            }
+            if (c != '.' && pos < end && bytes[pos] == '.') {  // e.g. 3.14 or 89.
+              token.id = nuPy_REAL_LITERAL;
+              pos++;
+              lexer->col++;
+              while (pos < end && isdigit((unsigned char)bytes[pos])) {
+                pos++;
+                lexer->col++;
+              }
+            }
+          }
+          *length = pos - lexer->pos;
+        }
+        else {
+          token.id = nuPy_UNKNOWN;
+          if (c == '\0')  // a C string to the scanner
+            *length = 0;
+        }
+        break;
+    }
+
+    lexer->pos = pos;
+    return token;
+  }
+}
+
+//
+// lexer_close
+//
+// Unmaps or frees the source, and frees the lexer.
+//
+void lexer_close(struct LEXER* lexer)
+{
+  if (lexer == NULL)
+    return;
+
+#if defined(LEXER_MMAP)
+  if (lexer->mapped)
+    munmap(lexer->bytes, lexer->length);
+  else if (lexer->input != stdin)
+    free(lexer->bytes);
+#else
+  if (lexer->input != stdin)
+    free(lexer->bytes);
+#endif
+
+  free(lexer);
+}
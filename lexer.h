@@ -0,0 +1,90 @@
+/*lexer.h*/
+
+//
+// Bulk scanner for nuPython: the same tokens, lines, columns and values
+// as scanner_nextToken (see scanner.h), but scanned straight out of the
+// source bytes rather than one fgetc at a time. A file is memory-mapped
+// and scanned as one range; the keyboard (through input.h), or any
+// other stream, is read a line at a time --- a token never spans lines,
+// and input() still gets the lines after the $ line. A token's value is
+// a slice of the source, (start, length), and is not copied.
+//
+// The runs of blanks, comments, identifiers and strings are skipped
+// with SSE2 or AVX2 where the CPU has them (see lexer_kernels).
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+#include <stddef.h>   // size_t
+
+#include "token.h"
+
+
+enum LEXER_KERNELS
+{
+  LEXER_SCALAR,  // a byte at a time
+  LEXER_SSE2,    // 16 bytes at a time
+  LEXER_AVX2     // 32 bytes at a time
+};
+
+struct LEXER
+{
+  FILE*  input;
+  char*  bytes;      // the source being scanned: the whole file, or one line
+  size_t length;     // # of bytes
+  size_t pos;        // offset of the next byte to scan
+  size_t capacity;   // size of the line buffer, if line by line
+  bool   mapped;     // true => bytes is mmap'ed
+  bool   lines;      // true => read a line at a time
+  bool   eof;        // true => nothing more to read
+  int    line;
+  int    col;
+};
+
+
+//
+// Public functions:
+//
+
+//
+// lexer_kernels
+//
+// Selects the fastest kernels the CPU supports, up to the given
+// LEXER_KERNELS, for every lexer from now on, and returns the ones
+// selected. Called by the first lexer_open with LEXER_AVX2; only
+// needed to compare the kernels (see scanbench.c).
+//
+int lexer_kernels(int wanted);
+
+//
+// lexer_open
+//
+// Returns a lexer over the given input stream, from its current
+// position. The caller frees it with lexer_close.
+//
+struct LEXER* lexer_open(FILE* input);
+
+//
+// lexer_next
+//
+// Scans and returns the next token. Its value is returned through
+// value and length; it is not '\0'-terminated, and is valid until the
+// next call (keyboard input) or until lexer_close (files). Once $ or
+// EOF is reached, the EOS token is returned, and the rest of the line
+// holding the $ has been read.
+//
+struct Token lexer_next(struct LEXER* lexer, const char** value, size_t* length);
+
+//
+// lexer_close
+//
+// Unmaps or frees the source, and frees the lexer; the input stream
+// itself is left open.
+//
+void lexer_close(struct LEXER* lexer);
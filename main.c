@@ -15,45 +15,116 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>  // true, false
-#include <string.h>   // strcspn
+#include <string.h>   // strcspn, strcmp
 
 #include "token.h"    // token defs
 #include "scanner.h" 
 #include "parser.h"
+#include "tokens.h"
 #include "programgraph.h"
 #include "ram.h"
 #include "execute.h"
+#include "optimize.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "check.h"
+#include "transpile.h"
+#include "arena.h"
+#include "frontend.h"
+#include "flat.h"
+#include "cache.h"
+#include "output.h"
 
 
 //
 // main
 //
-// usage: program.exe [filename.py]
+// usage: program.exe [-tree] [-O0] [-check] [-stats] [-hoisted] [-jit] [-flat] [-twophase] [-cache] [-transpile file.c] [filename.py]
 // 
 // If a filename is given, the file is opened and serves as
 // input to the program. If a filename is not given, then 
 // input is taken from the keyboard until $ is input.
 //
+// The program is compiled to bytecode and run on the virtual
+// machine; -tree runs the tree-walking executor instead, as
+// a reference. Before it runs, the program graph is optimized
+// (constant folding, etc.); -O0 turns the optimizer off.
+// The bytecode is checked before it runs, so instructions that
+// are proven safe skip the VM's run-time checks; -check also
+// reports the errors that are certain to happen, up front.
+// -stats outputs how often each VM superinstruction ran, and
+// -hoisted outputs the statements the optimizer moved out of loops.
+// -jit compiles hot while loops to native code as the VM runs
+// (x86-64 only, off by default). -flat runs the program on its
+// flattened, index-based layout instead (see flat.h). -transpile
+// writes the program out as C instead of running it (see transpile.h).
+// The syntax is checked and the program graph built in one pass over
+// the tokens (see frontend.h); -twophase runs the original parser and
+// program graph builder, one after the other, instead. -cache runs
+// the program on its flat layout, saved in a .nupyc file next to the
+// source the first time, and loaded from there (skipping the front end
+// and the optimizer) as long as the source doesn't change (see cache.h).
+//
 int main(int argc, char* argv[])
 {
   FILE* input = NULL;
   bool  keyboardInput = false;
+  bool  treeWalker = false;
+  bool  optimize = true;
+  bool  check = false;
+  bool  stats = false;
+  bool  hoisted = false;
+  bool  jit = false;
+  bool  flat = false;
+  bool  twophase = false;
+  bool  cache = false;
+  char* transpiled = NULL;
+  char* filename = NULL;
+
+  output_init();  // before anything is output
+
+  //
+  // options start with -, anything else is the nuPython file:
+  //
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-tree") == 0)
+      treeWalker = true;
+    else if (strcmp(argv[i], "-O0") == 0)
+      optimize = false;
+    else if (strcmp(argv[i], "-check") == 0)
+      check = true;
+    else if (strcmp(argv[i], "-stats") == 0)
+      stats = true;
+    else if (strcmp(argv[i], "-hoisted") == 0)
+      hoisted = true;
+    else if (strcmp(argv[i], "-jit") == 0)
+      jit = true;
+    else if (strcmp(argv[i], "-flat") == 0)
+      flat = true;
+    else if (strcmp(argv[i], "-twophase") == 0)
+      twophase = true;
+    else if (strcmp(argv[i], "-cache") == 0)
+      cache = true;
+    else if (strcmp(argv[i], "-transpile") == 0 && i + 1 < argc)
+      transpiled = argv[++i];
+    else
+      filename = argv[i];
+  }
 
   //
   // where is the input coming from?
   //
-  if (argc < 2) {
+  if (filename == NULL) {
     //
-    // no args, just the program name:
+    // no file, just the program name (and options):
     //
     input = stdin;
     keyboardInput = true;
   }
   else {
     //
-    // assume 2nd arg is a nuPython file:
+    // a nuPython file was given:
     //
-    char* filename = argv[1];
 
     input = fopen(filename, "r");
 
@@ -69,14 +140,59 @@ int main(int argc, char* argv[])
   if (keyboardInput)  // prompt the user if appropriate:
   {
     printf("nuPython input (enter $ when you're done)>\n");
+    output_flush();
   }
 
   //
-  // call parser to check program syntax:
+  // -cache: the program is run from its .nupyc file if the source is
+  // the one it was compiled from, otherwise the file is (re)written
+  // once the program is compiled. Only plain runs of a file are cached:
   //
-  struct TokenQueue* tokens = parser_parse(input);
+  bool use_cache = cache && !keyboardInput && !treeWalker && !check && !hoisted && !twophase && transpiled == NULL;
+  char* source = NULL;
+  size_t source_length = 0;
+  char* cache_file = NULL;
+  struct FLAT_PROGRAM* cached = NULL;
+
+  if (use_cache) {
+    source = cache_read_source(input, &source_length);
+    rewind(input);
+    cache_file = cache_path(filename);
+
+    use_cache = (source != NULL && cache_file != NULL);
+    if (use_cache)
+      cached = cache_load(cache_file, source, source_length, optimize);
+    flat = true;
+  }
+
+  //
+  // scan the program into the token array, then check its syntax
+  // and build the program graph in one pass; -twophase runs the
+  // parser and then the program graph builder instead:
+  //
+  struct TOKENS* tokens = NULL;
+  struct TokenQueue* queue = NULL;
+  struct STMT* program = NULL;
+  char* unsupported = NULL;
+  bool parsed;
+
+  struct ARENA* arena = arena_create(); 
 
-  if (tokens == NULL)
+  if (cached != NULL) {
+    parsed = true;
+  }
+  else if (twophase) {
+    if (keyboardInput)  // so the parser doesn't read ahead of the $ line, past what input() reads (see input.h)
+      setvbuf(stdin, NULL, _IONBF, 0);
+    queue = parser_parse(input);
+    parsed = (queue != NULL);
+  }
+  else {
+    tokens = tokens_scan(input);
+    parsed = frontend_parse(tokens, arena, &program, &unsupported);
+  }
+
+  if (!parsed)
   {
     // 
     // program has a syntax error, error msg already output:
@@ -87,20 +203,77 @@ int main(int argc, char* argv[])
   {
     printf("**parsing successful, valid syntax\n");
 
-    //
-    // TODO:
-    //
     printf("**building program graph...\n"); 
-    struct STMT* program = programgraph_build(tokens); 
+    if (twophase)
+      program = programgraph_build(queue);
+    else if (unsupported != NULL)
+      frontend_unsupported(unsupported);
+
+    if (optimize && cached == NULL)  // the two-phase graph is malloc'd, node by node
+      program = optimize_program(program, twophase ? NULL : arena, hoisted); 
     //programgraph_print(program); 
 
-    printf("**executing...\n"); 
-    struct RAM* memory = ram_init();
-    execute(program, memory); 
-    printf("**done\n"); 
-    ram_print(memory); 
-    tokenqueue_destroy(tokens);
+    //
+    // -transpile: the program is written out as C, and not run:
+    //
+    if (transpiled != NULL) {
+      FILE* output = fopen(transpiled, "w");
+      if (output == NULL) {
+        printf("**ERROR: unable to open output file '%s' for output.\n", transpiled);
+      }
+      else {
+        printf("**transpiling to %s...\n", transpiled);
+        transpile_program(program, output);
+        fclose(output);
+      }
+    }
+    else {
+      struct BYTECODE* code = NULL; 
+      if ((!treeWalker && !flat) || check) {
+        code = bytecode_compile(program); 
+        if (optimize || check)
+          check_program(code, optimize, check); 
+        if (optimize)
+          bytecode_fuse(code); 
+        //bytecode_print(code); 
+      }
+
+      printf("**executing...\n"); 
+      struct RAM* memory = ram_init();
+      if (treeWalker) {
+        execute(program, memory); 
+      }
+      else if (cached != NULL) {
+        flat_execute(cached, memory);
+      }
+      else if (flat) {
+        struct FLAT_PROGRAM* flat_program = flat_convert(program);
+        if (use_cache)
+          cache_save(cache_file, flat_program, source, source_length, optimize);
+        flat_execute(flat_program, memory);
+        flat_destroy(flat_program);
+      }
+      else {
+        vm_execute(code, memory, jit); 
+        if (stats)
+          bytecode_print_fires(code); 
+      }
+      if (code != NULL)
+        bytecode_destroy(code); 
+      printf("**done\n"); 
+      ram_print(memory); 
+      ram_destroy(memory); 
+    }
+    if (twophase)
+      programgraph_destroy(program);
   }
+  arena_destroy(arena);  // the whole program graph, unless -twophase
+  tokens_destroy(tokens);
+  if (queue != NULL)
+    tokenqueue_destroy(queue);
+  cache_close(cached);
+  free(cache_file);
+  free(source);
 
   //
   // done:
@@ -0,0 +1,1209 @@
+/*optimize.c*/
+
+//
+// Optimization pass over a nuPython program graph: constant folding,
+// constant propagation, algebraic simplification, and loop-invariant
+// code motion (see optimize.h).
+//
+// The passes repeat until nothing changes, since each can expose work
+// for the others: in a = 60 * 60 followed by b = a * 24, folding a
+// lets a be propagated, which lets b be folded.
+//
+// A fold only happens when the executor would compute the same value
+// without error; anything that could fail (division by zero, integer
+// overflow, mismatched types, ...) is left for run-time, so the error
+// is still reported with its line number. Propagation and identities
+// are only done when they are safe for every possible execution:
+//
+//  - a variable is propagated only if it is assigned exactly once, to
+//    a literal, by a statement at the top level (not in a loop) that
+//    comes before the use --- since nuPython has no branches, that
+//    assignment has always run when the use is reached.
+//  - an identity like x + 0 is simplified to x only if every value x
+//    can ever hold has the right numeric type.
+//  - an assignment x = e in a loop body is hoisted in front of the
+//    loop only if the loop is known to run at least once, e reads
+//    nothing the loop assigns and cannot fail, x is assigned nowhere
+//    else in the loop and not read before it, and the statements
+//    before it in the body can neither fail nor create a variable.
+//    It then makes the same change to memory, just once.
+//  - a *p = ... assignment could write to any variable, so a program
+//    that has one gets only constant folding.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <limits.h>   // INT_MIN, INT_MAX
+#include <math.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "resolve.h"
+#include "arena.h"
+#include "optimize.h"
+
+
+//
+// The types of value a variable (or expression) can hold, as bits:
+//
+#define TYPE_INT   0x01
+#define TYPE_REAL  0x02
+#define TYPE_STR   0x04
+#define TYPE_BOOL  0x08
+#define TYPE_PTR   0x10
+#define TYPE_OTHER 0x20  // None, or a value the pass can't know
+#define TYPE_ANY   0x3F
+
+//
+// A literal value:
+//
+struct CONSTANT
+{
+  int type;  // enum RAM_VALUE_TYPES: INT, REAL, STR, or BOOLEAN
+  int i;
+  double d;
+  char* s;   // STR
+};
+
+//
+// What loop-invariant code motion knows about the variables, by slot,
+// at a point in the program:
+//
+struct LOOP_STATE
+{
+  bool* defined;             // true => certainly defined
+  bool* known;               // true => certainly holds values[slot]
+  struct CONSTANT* values;
+};
+
+//
+// What the pass knows about the program's variables, by slot:
+//
+struct OPTIMIZER
+{
+  struct SYMTAB* symbols;
+
+  int* num_assignments;      // # of assignments to the variable
+  struct STMT** assignment;  // the assignment to the variable (if just one)
+  int* position;             // top-level position of the assignment, -1 => in a loop
+  int* types;                // TYPE_ bits of the values the variable can hold
+
+  bool deref_store;          // true => the program has a *p = ... assignment
+  bool dump;                 // true => output each statement that is hoisted
+
+  struct ARENA* arena;       // where the graph's nodes live, NULL => malloc
+};
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**OPTIMIZE ERROR\n");
+  printf("**OPTIMIZE ERROR: %s\n", msg);
+  printf("**OPTIMIZE ERROR\n");
+
+  exit(-123);
+}
+
+//
+// element_constant
+//
+// If the element is a literal, stores its value in *constant (decoded
+// the same way the executor decodes it) and returns true.
+//
+static bool element_constant(struct ELEMENT* element, struct CONSTANT* constant)
+{
+  int type = element->element_type;
+
+  if (type == ELEMENT_INT_LITERAL) {
+    constant->type = RAM_TYPE_INT;
+    constant->i = atoi(element->element_value);
+  } else if (type == ELEMENT_REAL_LITERAL) {
+    constant->type = RAM_TYPE_REAL;
+    constant->d = atof(element->element_value);
+  } else if (type == ELEMENT_STR_LITERAL) {
+    constant->type = RAM_TYPE_STR;
+    constant->s = element->element_value;
+  } else if (type == ELEMENT_TRUE || type == ELEMENT_FALSE) {
+    constant->type = RAM_TYPE_BOOLEAN;
+    constant->i = (type == ELEMENT_TRUE);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+//
+// set_element
+//
+// Turns the element into a literal holding the given constant. Reals
+// are written with 17 significant digits, which atof reads back as
+// exactly the same double. The old value is freed, unless the graph
+// lives in an arena.
+//
+static void set_element(struct OPTIMIZER* opt, struct ELEMENT* element, struct CONSTANT* constant)
+{
+  char buffer[64];
+  char* text = buffer;
+
+  if (constant->type == RAM_TYPE_INT) {
+    element->element_type = ELEMENT_INT_LITERAL;
+    snprintf(buffer, sizeof(buffer), "%d", constant->i);
+  } else if (constant->type == RAM_TYPE_REAL) {
+    element->element_type = ELEMENT_REAL_LITERAL;
+    snprintf(buffer, sizeof(buffer), "%.17g", constant->d);
+  } else if (constant->type == RAM_TYPE_STR) {
+    element->element_type = ELEMENT_STR_LITERAL;
+    text = constant->s;
+  } else {
+    element->element_type = (constant->i) ? ELEMENT_TRUE : ELEMENT_FALSE;
+    text = (constant->i) ? "True" : "False";
+  }
+
+  if (opt->arena != NULL) {
+    element->element_value = arena_strdup(opt->arena, text);
+    return;
+  }
+
+  char* value = (char*)malloc(strlen(text) + 1);
+  if (value == NULL)
+    panic("out of memory (set_element)");
+  strcpy(value, text);
+
+  free(element->element_value);
+  element->element_value = value;
+}
+
+//
+// compare
+//
+// Applies a relational operator to the result of a comparison
+// (negative, zero, or positive). Returns false if the operator
+// is not relational.
+//
+static bool compare(int operator, int comparison, struct CONSTANT* result)
+{
+  result->type = RAM_TYPE_BOOLEAN;
+
+  if (operator == OPERATOR_EQUAL) result->i = (comparison == 0);
+  else if (operator == OPERATOR_NOT_EQUAL) result->i = (comparison != 0);
+  else if (operator == OPERATOR_LT) result->i = (comparison < 0);
+  else if (operator == OPERATOR_LTE) result->i = (comparison <= 0);
+  else if (operator == OPERATOR_GT) result->i = (comparison > 0);
+  else if (operator == OPERATOR_GTE) result->i = (comparison >= 0);
+  else
+    return false;
+
+  return true;
+}
+
+//
+// fold_ints
+//
+// Folds lhs <operator> rhs for two integers. Returns false if the
+// executor would report an error, or the result overflows.
+//
+static bool fold_ints(int operator, int lhs, int rhs, struct CONSTANT* result)
+{
+  long long value;
+
+  if (operator == OPERATOR_PLUS)
+    value = (long long)lhs + rhs;
+  else if (operator == OPERATOR_MINUS)
+    value = (long long)lhs - rhs;
+  else if (operator == OPERATOR_ASTERISK)
+    value = (long long)lhs * rhs;
+  else if (operator == OPERATOR_DIV || operator == OPERATOR_MOD) {
+    if (rhs == 0 || (lhs == INT_MIN && rhs == -1))
+      return false;
+    value = (operator == OPERATOR_DIV) ? lhs / rhs : lhs % rhs;
+  } else if (operator == OPERATOR_POWER) {
+    double power = pow(lhs, rhs);
+    if (!(power >= INT_MIN && power <= INT_MAX))  // also rejects NaN
+      return false;
+    value = (int)power;
+  } else {
+    int comparison = (lhs < rhs) ? -1 : (lhs > rhs);
+    return compare(operator, comparison, result);
+  }
+
+  if (value < INT_MIN || value > INT_MAX)
+    return false;
+
+  result->type = RAM_TYPE_INT;
+  result->i = (int)value;
+  return true;
+}
+
+//
+// fold_reals
+//
+// Folds lhs <operator> rhs for two reals. Returns false if the
+// executor would report an error, or the result is not finite.
+//
+static bool fold_reals(int operator, double lhs, double rhs, struct CONSTANT* result)
+{
+  double value;
+
+  if (operator == OPERATOR_PLUS) value = lhs + rhs;
+  else if (operator == OPERATOR_MINUS) value = lhs - rhs;
+  else if (operator == OPERATOR_ASTERISK) value = lhs * rhs;
+  else if (operator == OPERATOR_POWER) value = pow(lhs, rhs);
+  else if (operator == OPERATOR_MOD) value = fmod(lhs, rhs);
+  else if (operator == OPERATOR_DIV) {
+    if (rhs == 0.0)
+      return false;
+    value = lhs / rhs;
+  } else {
+    int comparison = (lhs < rhs) ? -1 : (lhs > rhs);
+    if (isnan(lhs) || isnan(rhs))
+      return false;
+    return compare(operator, comparison, result);
+  }
+
+  if (!isfinite(value))
+    return false;
+
+  result->type = RAM_TYPE_REAL;
+  result->d = value;
+  return true;
+}
+
+//
+// fold_constants
+//
+// Folds lhs <operator> rhs. Returns false (and folds nothing) for
+// every combination that the executor reports as an error. The
+// string of a concatenation is new, and the caller must free it.
+//
+static bool fold_constants(int operator, struct CONSTANT* lhs, struct CONSTANT* rhs, struct CONSTANT* result)
+{
+  if (lhs->type == RAM_TYPE_INT && rhs->type == RAM_TYPE_INT)
+    return fold_ints(operator, lhs->i, rhs->i, result);
+
+  bool lhs_number = (lhs->type == RAM_TYPE_INT || lhs->type == RAM_TYPE_REAL);
+  bool rhs_number = (rhs->type == RAM_TYPE_INT || rhs->type == RAM_TYPE_REAL);
+  if (lhs_number && rhs_number) {
+    double lhs_real = (lhs->type == RAM_TYPE_INT) ? lhs->i : lhs->d;
+    double rhs_real = (rhs->type == RAM_TYPE_INT) ? rhs->i : rhs->d;
+    return fold_reals(operator, lhs_real, rhs_real, result);
+  }
+
+  if (lhs->type == RAM_TYPE_STR && rhs->type == RAM_TYPE_STR) {
+    if (operator != OPERATOR_PLUS)
+      return compare(operator, strcmp(lhs->s, rhs->s), result);
+
+    char* concat = (char*)malloc(strlen(lhs->s) + strlen(rhs->s) + 1);
+    if (concat == NULL)
+      panic("out of memory (fold_constants)");
+    strcpy(concat, lhs->s);
+    strcat(concat, rhs->s);
+
+    result->type = RAM_TYPE_STR;
+    result->s = concat;
+    return true;
+  }
+
+  return false;  // booleans, pointers, mismatched types: run-time errors
+}
+
+//
+// make_unary
+//
+// Turns a binary expression into the unary expression given by its
+// lhs (or its rhs, if use_rhs), freeing the other side.
+//
+static void make_unary(struct OPTIMIZER* opt, struct EXPR* expr, bool use_rhs)
+{
+  struct UNARY_EXPR* keep = (use_rhs) ? expr->rhs : expr->lhs;
+  struct UNARY_EXPR* drop = (use_rhs) ? expr->lhs : expr->rhs;
+
+  if (opt->arena == NULL) {  // else it goes when the arena does
+    free(drop->element->element_value);
+    free(drop->element);
+    free(drop);
+  }
+
+  expr->lhs = keep;
+  expr->rhs = NULL;
+  expr->isBinaryExpr = false;
+  expr->operator = OPERATOR_NO_OP;
+}
+
+//
+// fold_expr
+//
+// Folds a binary expression of two literals into one literal. In a
+// binary expression the executor ignores a literal's unary operator,
+// so only the elements matter. Returns true if the expression changed.
+//
+static bool fold_expr(struct OPTIMIZER* opt, struct EXPR* expr)
+{
+  struct CONSTANT lhs, rhs, result;
+
+  if (!expr->isBinaryExpr || expr->rhs == NULL)
+    return false;
+  if (!element_constant(expr->lhs->element, &lhs) || !element_constant(expr->rhs->element, &rhs))
+    return false;
+  if (!fold_constants(expr->operator, &lhs, &rhs, &result))
+    return false;
+
+  set_element(opt, expr->lhs->element, &result);
+  expr->lhs->expr_type = UNARY_ELEMENT;
+  make_unary(opt, expr, false);
+
+  if (result.type == RAM_TYPE_STR)
+    free(result.s);
+
+  return true;
+}
+
+//
+// operand_types
+//
+// Returns the TYPE_ bits of the values an operand can have. In a
+// binary expression &x reads x, elsewhere it is x's address; outside
+// a binary expression a pointer is not read reliably, so it is
+// treated as unknown.
+//
+static int operand_types(struct OPTIMIZER* opt, struct UNARY_EXPR* unary, bool binary_context)
+{
+  struct CONSTANT constant;
+  struct ELEMENT* element = unary->element;
+
+  if (element_constant(element, &constant)) {
+    if (constant.type == RAM_TYPE_INT) return TYPE_INT;
+    if (constant.type == RAM_TYPE_REAL) return TYPE_REAL;
+    if (constant.type == RAM_TYPE_STR) return TYPE_STR;
+    return TYPE_BOOL;
+  }
+  if (element->element_type != ELEMENT_IDENTIFIER)
+    return TYPE_OTHER;
+
+  if (unary->expr_type == UNARY_PTR_DEREF)
+    return TYPE_ANY;
+  if (unary->expr_type == UNARY_ADDRESS_OF && !binary_context)
+    return TYPE_PTR;
+
+  int types = opt->types[symtab_lookup(opt->symbols, element->element_value)];
+  if ((types & TYPE_PTR) && !binary_context)
+    types |= TYPE_OTHER;
+  return types;
+}
+
+//
+// binary_types
+//
+// Returns the TYPE_ bits of lhs <operator> rhs, for every pair of
+// operand types that the executor evaluates without error.
+//
+static int binary_types(int operator, int lhs_types, int rhs_types)
+{
+  bool relational = (operator >= OPERATOR_EQUAL && operator <= OPERATOR_GTE);
+  int types = 0;
+
+  if (operator == OPERATOR_IS || operator == OPERATOR_IN)
+    return 0;
+  if ((lhs_types & TYPE_OTHER) || (rhs_types & TYPE_OTHER))
+    types |= TYPE_ANY;
+
+  int numbers = TYPE_INT | TYPE_REAL;
+  if ((lhs_types & numbers) && (rhs_types & numbers)) {
+    if (relational)
+      types |= TYPE_BOOL;
+    else {
+      if ((lhs_types & TYPE_INT) && (rhs_types & TYPE_INT))
+        types |= TYPE_INT;
+      if ((lhs_types & TYPE_REAL) || (rhs_types & TYPE_REAL))
+        types |= TYPE_REAL;
+    }
+  }
+  if ((lhs_types & TYPE_STR) && (rhs_types & TYPE_STR))
+    types |= (relational) ? TYPE_BOOL : TYPE_STR;
+  if ((lhs_types & TYPE_PTR) && (rhs_types & TYPE_INT))
+    types |= TYPE_PTR;
+
+  return types;
+}
+
+//
+// rhs_types
+//
+// Returns the TYPE_ bits of the values an assignment can store.
+//
+static int rhs_types(struct OPTIMIZER* opt, struct VALUE* rhs)
+{
+  if (rhs->value_type == VALUE_FUNCTION_CALL) {
+    char* name = rhs->types.function_call->function_name;
+    if (strcmp(name, "input") == 0) return TYPE_STR;
+    if (strcmp(name, "int") == 0) return TYPE_INT;
+    if (strcmp(name, "float") == 0) return TYPE_REAL;
+    return 0;  // other functions are ignored, nothing is stored
+  }
+
+  struct EXPR* expr = rhs->types.expr;
+  if (!expr->isBinaryExpr)
+    return operand_types(opt, expr->lhs, false);
+  if (expr->rhs == NULL)
+    return 0;
+
+  return binary_types(expr->operator, operand_types(opt, expr->lhs, true), operand_types(opt, expr->rhs, true));
+}
+
+//
+// analyze_stmts
+//
+// Counts the assignments to each variable and records where they are,
+// from stmt until stop (or the end of the program). position is the
+// top-level position of the statements, -1 inside a loop body.
+//
+static void analyze_stmts(struct OPTIMIZER* opt, struct STMT* stmt, struct STMT* stop, int position)
+{
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+      if (assignment->isPtrDeref)
+        opt->deref_store = true;
+      else {
+        int slot = symtab_lookup(opt->symbols, assignment->var_name);
+        opt->num_assignments[slot]++;
+        opt->assignment[slot] = stmt;
+        opt->position[slot] = position;
+      }
+      stmt = assignment->next_stmt;
+    } else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      stmt = stmt->types.function_call->next_stmt;
+    } else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      analyze_stmts(opt, stmt->types.while_loop->loop_body, stmt, -1);
+      stmt = stmt->types.while_loop->next_stmt;
+    } else if (stmt->stmt_type == STMT_PASS) {
+      stmt = stmt->types.pass->next_stmt;
+    } else {
+      return;  // execution stops here
+    }
+    if (position >= 0)
+      position++;
+  }
+}
+
+//
+// infer_stmts
+//
+// Adds the types each assignment can store to its variable's types,
+// from stmt until stop. Returns true if any variable's types grew.
+//
+static bool infer_stmts(struct OPTIMIZER* opt, struct STMT* stmt, struct STMT* stop)
+{
+  bool changed = false;
+
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+      if (!assignment->isPtrDeref) {
+        int slot = symtab_lookup(opt->symbols, assignment->var_name);
+        int types = opt->types[slot] | rhs_types(opt, assignment->rhs);
+        changed = changed || (types != opt->types[slot]);
+        opt->types[slot] = types;
+      }
+      stmt = assignment->next_stmt;
+    } else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      stmt = stmt->types.function_call->next_stmt;
+    } else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      changed = infer_stmts(opt, stmt->types.while_loop->loop_body, stmt) || changed;
+      stmt = stmt->types.while_loop->next_stmt;
+    } else if (stmt->stmt_type == STMT_PASS) {
+      stmt = stmt->types.pass->next_stmt;
+    } else {
+      return changed;
+    }
+  }
+  return changed;
+}
+
+//
+// propagate
+//
+// If the element is a variable that always holds the same literal
+// when the statement at the given position runs, replaces it with
+// that literal. Returns true if the element changed.
+//
+static bool propagate(struct OPTIMIZER* opt, struct ELEMENT* element, int position)
+{
+  if (opt->deref_store || element->element_type != ELEMENT_IDENTIFIER)
+    return false;
+
+  int slot = symtab_lookup(opt->symbols, element->element_value);
+  if (slot < 0 || opt->num_assignments[slot] != 1)
+    return false;
+  if (opt->position[slot] < 0 || opt->position[slot] >= position)
+    return false;  // in a loop, or not yet run
+
+  struct VALUE* rhs = opt->assignment[slot]->types.assignment->rhs;
+  if (rhs->value_type != VALUE_EXPR || rhs->types.expr->isBinaryExpr)
+    return false;
+
+  struct UNARY_EXPR* unary = rhs->types.expr->lhs;
+  struct CONSTANT constant;
+  if (unary->expr_type != UNARY_ELEMENT || !element_constant(unary->element, &constant))
+    return false;
+
+  set_element(opt, element, &constant);
+  return true;
+}
+
+//
+// propagate_operand
+//
+// Propagates a constant into a read of a variable: x (or +x, -x, whose
+// operator the executor ignores), and in a binary expression also &x,
+// which reads x there.
+//
+static bool propagate_operand(struct OPTIMIZER* opt, struct UNARY_EXPR* unary, bool binary_context, int position)
+{
+  int type = unary->expr_type;
+  if (type == UNARY_PTR_DEREF || (type == UNARY_ADDRESS_OF && !binary_context))
+    return false;
+
+  if (!propagate(opt, unary->element, position))
+    return false;
+
+  unary->expr_type = UNARY_ELEMENT;
+  return true;
+}
+
+//
+// is_number
+//
+// Returns true if the operand is the int (or, if allow_real, int
+// or real) literal with the given value.
+//
+static bool is_number(struct UNARY_EXPR* unary, double value, bool allow_real)
+{
+  struct CONSTANT constant;
+  if (!element_constant(unary->element, &constant))
+    return false;
+
+  if (constant.type == RAM_TYPE_INT)
+    return constant.i == value;
+  if (constant.type == RAM_TYPE_REAL && allow_real)
+    return constant.d == value;
+  return false;
+}
+
+//
+// simplify_identity
+//
+// Simplifies x + 0, 0 + x, x - 0, x * 1, 1 * x and x / 1 to x, when
+// x is a plain variable that can only hold ints. When x can only hold
+// reals, x * 1, 1 * x, x - 0 and x / 1 are simplified (x + 0 is not:
+// for x = -0.0 the sum is 0.0). If x is not defined, reading x alone
+// reports the same error. Returns true if the expression changed.
+//
+static bool simplify_identity(struct OPTIMIZER* opt, struct EXPR* expr)
+{
+  if (opt->deref_store || !expr->isBinaryExpr || expr->rhs == NULL)
+    return false;
+
+  for (int side = 0; side < 2; side++) {
+    struct UNARY_EXPR* var = (side == 0) ? expr->lhs : expr->rhs;
+    struct UNARY_EXPR* other = (side == 0) ? expr->rhs : expr->lhs;
+
+    if (var->expr_type != UNARY_ELEMENT || var->element->element_type != ELEMENT_IDENTIFIER)
+      continue;
+
+    int types = opt->types[symtab_lookup(opt->symbols, var->element->element_value)];
+    bool is_int = (types == TYPE_INT);
+    bool is_real = (types == TYPE_REAL);
+    if (!is_int && !is_real)
+      continue;
+
+    int operator = expr->operator;
+    bool identity = false;
+
+    if (operator == OPERATOR_ASTERISK)
+      identity = is_number(other, 1, is_real);
+    else if (side == 0 && operator == OPERATOR_DIV)
+      identity = is_number(other, 1, is_real);
+    else if (side == 0 && operator == OPERATOR_MINUS)
+      identity = is_number(other, 0, is_real);
+    else if (operator == OPERATOR_PLUS)
+      identity = is_int && is_number(other, 0, false);
+
+    if (identity) {
+      make_unary(opt, expr, side == 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+//
+// optimize_expr
+//
+// Propagates constants into an expression, then folds or simplifies
+// it. Returns true if the expression changed.
+//
+static bool optimize_expr(struct OPTIMIZER* opt, struct EXPR* expr, int position)
+{
+  bool changed = false;
+
+  if (!expr->isBinaryExpr) {
+    changed = propagate_operand(opt, expr->lhs, false, position);
+  } else if (expr->rhs != NULL) {
+    changed = propagate_operand(opt, expr->lhs, true, position);
+    changed = propagate_operand(opt, expr->rhs, true, position) || changed;
+  }
+
+  if (fold_expr(opt, expr))
+    return true;
+
+  return simplify_identity(opt, expr) || changed;
+}
+
+//
+// optimize_stmts
+//
+// Optimizes the expressions in each statement from stmt until stop
+// (or the end of the program). position is the top-level position
+// of the statements; every statement in a loop body has the position
+// of its loop, since it runs after every statement before the loop
+// (and, possibly, before the ones after it). Returns true if anything
+// changed.
+//
+static bool optimize_stmts(struct OPTIMIZER* opt, struct STMT* stmt, struct STMT* stop, int position)
+{
+  bool in_loop = (stop != NULL);
+  bool changed = false;
+
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+      // NOTE: int(x) and float(x) always read x from memory, so they are left alone
+      if (assignment->rhs->value_type == VALUE_EXPR)
+        changed = optimize_expr(opt, assignment->rhs->types.expr, position) || changed;
+      stmt = assignment->next_stmt;
+    } else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      struct ELEMENT* parameter = stmt->types.function_call->parameter;
+      if (parameter != NULL)
+        changed = propagate(opt, parameter, position) || changed;
+      stmt = stmt->types.function_call->next_stmt;
+    } else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
+      changed = optimize_expr(opt, while_loop->condition, position) || changed;
+      changed = optimize_stmts(opt, while_loop->loop_body, stmt, position) || changed;
+      stmt = while_loop->next_stmt;
+    } else if (stmt->stmt_type == STMT_PASS) {
+      stmt = stmt->types.pass->next_stmt;
+    } else {
+      return changed;
+    }
+    if (!in_loop)
+      position++;
+  }
+  return changed;
+}
+
+//
+// next_link
+//
+// Returns the address of the statement's next_stmt field, so the
+// statement after it can be changed.
+//
+static struct STMT** next_link(struct STMT* stmt)
+{
+  if (stmt->stmt_type == STMT_ASSIGNMENT)
+    return &stmt->types.assignment->next_stmt;
+  if (stmt->stmt_type == STMT_FUNCTION_CALL)
+    return &stmt->types.function_call->next_stmt;
+  if (stmt->stmt_type == STMT_WHILE_LOOP)
+    return &stmt->types.while_loop->next_stmt;
+  if (stmt->stmt_type == STMT_PASS)
+    return &stmt->types.pass->next_stmt;
+
+  panic("unexpected statement type (next_link)");
+  return NULL;
+}
+
+//
+// element_slot
+//
+// Returns the slot of the variable the element names, -1 if the
+// element is a literal.
+//
+static int element_slot(struct OPTIMIZER* opt, struct ELEMENT* element)
+{
+  if (element == NULL || element->element_type != ELEMENT_IDENTIFIER)
+    return -1;
+  return symtab_lookup(opt->symbols, element->element_value);
+}
+
+//
+// expr_reads
+//
+// Returns true if the expression reads (or takes the address of)
+// the variable in the given slot.
+//
+static bool expr_reads(struct OPTIMIZER* opt, struct EXPR* expr, int slot)
+{
+  if (element_slot(opt, expr->lhs->element) == slot)
+    return true;
+  return expr->isBinaryExpr && expr->rhs != NULL && element_slot(opt, expr->rhs->element) == slot;
+}
+
+//
+// stmts_read
+//
+// Returns true if any statement from stmt until stop, including
+// those in loop bodies, reads the variable in the given slot.
+//
+static bool stmts_read(struct OPTIMIZER* opt, struct STMT* stmt, struct STMT* stop, int slot)
+{
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+      struct VALUE* rhs = assignment->rhs;
+      if (assignment->isPtrDeref && symtab_lookup(opt->symbols, assignment->var_name) == slot)
+        return true;
+      if (rhs->value_type == VALUE_EXPR && expr_reads(opt, rhs->types.expr, slot))
+        return true;
+      if (rhs->value_type == VALUE_FUNCTION_CALL && element_slot(opt, rhs->types.function_call->parameter) == slot)
+        return true;
+    } else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      if (element_slot(opt, stmt->types.function_call->parameter) == slot)
+        return true;
+    } else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
+      if (expr_reads(opt, while_loop->condition, slot) || stmts_read(opt, while_loop->loop_body, stmt, slot))
+        return true;
+    } else if (stmt->stmt_type != STMT_PASS) {
+      return false;
+    }
+    stmt = *next_link(stmt);
+  }
+  return false;
+}
+
+//
+// mark_assigned
+//
+// Counts the assignments to each variable from stmt until stop,
+// including those in loop bodies.
+//
+static void mark_assigned(struct OPTIMIZER* opt, struct STMT* stmt, struct STMT* stop, int* assigned)
+{
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT)
+      assigned[symtab_lookup(opt->symbols, stmt->types.assignment->var_name)]++;
+    else if (stmt->stmt_type == STMT_WHILE_LOOP)
+      mark_assigned(opt, stmt->types.while_loop->loop_body, stmt, assigned);
+    else if (stmt->stmt_type != STMT_FUNCTION_CALL && stmt->stmt_type != STMT_PASS)
+      return;
+    stmt = *next_link(stmt);
+  }
+}
+
+//
+// safe_operand
+//
+// Returns true if reading the operand cannot fail: it is a literal,
+// or a variable that is defined (a plain read, not *p or &x).
+//
+static bool safe_operand(struct OPTIMIZER* opt, struct UNARY_EXPR* unary, struct LOOP_STATE* state)
+{
+  struct CONSTANT constant;
+
+  if (unary->expr_type != UNARY_ELEMENT)
+    return false;
+  if (element_constant(unary->element, &constant))
+    return true;
+
+  int slot = element_slot(opt, unary->element);
+  return slot >= 0 && state->defined[slot];
+}
+
+//
+// safe_pair
+//
+// Returns true if lhs <operator> rhs cannot fail for one lhs type and
+// one rhs type. Division is only safe by a non-zero literal.
+//
+static bool safe_pair(int operator, int lhs, int rhs, bool nonzero_rhs)
+{
+  bool relational = (operator >= OPERATOR_EQUAL && operator <= OPERATOR_GTE);
+  bool division = (operator == OPERATOR_DIV || operator == OPERATOR_MOD);
+  int numbers = TYPE_INT | TYPE_REAL;
+
+  if (operator == OPERATOR_IS || operator == OPERATOR_IN)
+    return false;
+  if (division && !nonzero_rhs)
+    return false;
+  if ((lhs & numbers) && (rhs & numbers))
+    return true;
+  if (lhs == TYPE_STR && rhs == TYPE_STR)
+    return relational || operator == OPERATOR_PLUS;
+  return lhs == TYPE_PTR && rhs == TYPE_INT;
+}
+
+//
+// safe_expr
+//
+// Returns true if the expression cannot report a semantic error: its
+// operands are literals or defined variables, and every combination
+// of the types they can hold is supported.
+//
+static bool safe_expr(struct OPTIMIZER* opt, struct EXPR* expr, struct LOOP_STATE* state)
+{
+  if (!safe_operand(opt, expr->lhs, state))
+    return false;
+
+  if (!expr->isBinaryExpr)  // a pointer is not read reliably outside a binary expression
+    return !(operand_types(opt, expr->lhs, false) & (TYPE_PTR | TYPE_OTHER));
+
+  if (expr->rhs == NULL || !safe_operand(opt, expr->rhs, state))
+    return false;
+
+  int lhs_types = operand_types(opt, expr->lhs, true);
+  int rhs_types = operand_types(opt, expr->rhs, true);
+  if ((lhs_types & TYPE_OTHER) || (rhs_types & TYPE_OTHER) || lhs_types == 0 || rhs_types == 0)
+    return false;
+  bool nonzero_rhs = !is_number(expr->rhs, 0, true) && element_slot(opt, expr->rhs->element) < 0;
+
+  for (int lhs = TYPE_INT; lhs < TYPE_OTHER; lhs <<= 1) {
+    for (int rhs = TYPE_INT; rhs < TYPE_OTHER; rhs <<= 1) {
+      if ((lhs_types & lhs) && (rhs_types & rhs) && !safe_pair(expr->operator, lhs, rhs, nonzero_rhs))
+        return false;
+    }
+  }
+  return true;
+}
+
+//
+// operand_value
+//
+// If the operand's value is known when the loop is entered (it is a
+// literal, or a variable last assigned a literal), stores it in
+// *constant and returns true.
+//
+static bool operand_value(struct OPTIMIZER* opt, struct UNARY_EXPR* unary, struct LOOP_STATE* state, struct CONSTANT* constant)
+{
+  if (unary->expr_type != UNARY_ELEMENT)
+    return false;
+  if (element_constant(unary->element, constant))
+    return true;
+
+  int slot = element_slot(opt, unary->element);
+  if (slot < 0 || !state->known[slot])
+    return false;
+
+  *constant = state->values[slot];
+  return true;
+}
+
+//
+// runs_once
+//
+// Returns true if the loop's condition is known to be true when the
+// loop is entered, so the body runs at least once.
+//
+static bool runs_once(struct OPTIMIZER* opt, struct STMT_WHILE_LOOP* while_loop, struct LOOP_STATE* state)
+{
+  struct EXPR* condition = while_loop->condition;
+  struct CONSTANT lhs, rhs, result;
+
+  if (!operand_value(opt, condition->lhs, state, &lhs))
+    return false;
+
+  if (!condition->isBinaryExpr)
+    result = lhs;
+  else if (condition->rhs == NULL || !operand_value(opt, condition->rhs, state, &rhs))
+    return false;
+  else if (!fold_constants(condition->operator, &lhs, &rhs, &result))
+    return false;
+  else if (result.type == RAM_TYPE_STR) {
+    free(result.s);
+    return false;
+  }
+
+  // true only for non-zero int or boolean values, like the executor:
+  return (result.type == RAM_TYPE_INT || result.type == RAM_TYPE_BOOLEAN) && result.i != 0;
+}
+
+//
+// hoistable
+//
+// Returns true if the assignment x = e in the loop body can be run
+// once before the loop instead: e reads only literals and variables
+// that are defined before the loop and not assigned in it, e cannot
+// fail, this is the only assignment to x in the loop, and the loop
+// does not read x before it (in the condition or earlier statements).
+//
+static bool hoistable(struct OPTIMIZER* opt, struct STMT* stmt, struct STMT* loop, int* assigned, struct LOOP_STATE* state)
+{
+  if (stmt->stmt_type != STMT_ASSIGNMENT)
+    return false;
+
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+  struct STMT_WHILE_LOOP* while_loop = loop->types.while_loop;
+
+  if (assignment->isPtrDeref || assignment->rhs->value_type != VALUE_EXPR)
+    return false;
+
+  struct EXPR* expr = assignment->rhs->types.expr;
+  int slot = symtab_lookup(opt->symbols, assignment->var_name);
+
+  if (assigned[slot] != 1 || !safe_expr(opt, expr, state))
+    return false;
+
+  int lhs = element_slot(opt, expr->lhs->element);
+  int rhs = (expr->isBinaryExpr) ? element_slot(opt, expr->rhs->element) : -1;
+  if (lhs == slot || rhs == slot || (lhs >= 0 && assigned[lhs] > 0) || (rhs >= 0 && assigned[rhs] > 0))
+    return false;
+
+  if (expr_reads(opt, while_loop->condition, slot))
+    return false;
+  return !stmts_read(opt, while_loop->loop_body, stmt, slot);
+}
+
+//
+// quiet
+//
+// Returns true if the statement neither fails nor creates a variable,
+// so running it after a hoisted statement instead of before is not
+// visible: pass, print of a literal or defined variable, or an
+// assignment that cannot fail to a variable defined before the loop.
+//
+static bool quiet(struct OPTIMIZER* opt, struct STMT* stmt, struct LOOP_STATE* state)
+{
+  if (stmt->stmt_type == STMT_PASS)
+    return true;
+
+  if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+    struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+    if (strcmp(call->function_name, "print") != 0)
+      return false;
+    int slot = element_slot(opt, call->parameter);
+    return slot < 0 || state->defined[slot];
+  }
+
+  if (stmt->stmt_type != STMT_ASSIGNMENT)
+    return false;
+
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+  if (assignment->isPtrDeref || assignment->rhs->value_type != VALUE_EXPR)
+    return false;
+  return state->defined[symtab_lookup(opt->symbols, assignment->var_name)]
+    && safe_expr(opt, assignment->rhs->types.expr, state);
+}
+
+//
+// find_hoistable
+//
+// Returns the link to the first statement in the loop body that can
+// be hoisted out of the loop, or NULL if there is none. Only quiet
+// statements may come before it, and at least one statement must be
+// left in the body.
+//
+static struct STMT** find_hoistable(struct OPTIMIZER* opt, struct STMT* loop, int* assigned, struct LOOP_STATE* state)
+{
+  struct STMT_WHILE_LOOP* while_loop = loop->types.while_loop;
+  struct STMT** link = &while_loop->loop_body;
+
+  if (!runs_once(opt, while_loop, state))
+    return NULL;
+
+  while (*link != loop) {
+    struct STMT* stmt = *link;
+    bool alone = (stmt == while_loop->loop_body && *next_link(stmt) == loop);
+
+    if (!alone && hoistable(opt, stmt, loop, assigned, state))
+      return link;
+    if (!quiet(opt, stmt, state))
+      return NULL;
+    link = next_link(stmt);
+  }
+  return NULL;
+}
+
+//
+// assign_state
+//
+// Updates what is known about the variables after an assignment.
+//
+static void assign_state(struct OPTIMIZER* opt, struct STMT* stmt, struct LOOP_STATE* state)
+{
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+  int slot = symtab_lookup(opt->symbols, assignment->var_name);
+
+  state->defined[slot] = true;
+  state->known[slot] = false;
+
+  struct VALUE* rhs = assignment->rhs;
+  if (rhs->value_type == VALUE_EXPR && !rhs->types.expr->isBinaryExpr
+    && rhs->types.expr->lhs->expr_type == UNARY_ELEMENT)
+    state->known[slot] = element_constant(rhs->types.expr->lhs->element, &state->values[slot]);
+}
+
+//
+// new_state
+//
+// Returns a copy of the given state, or an empty state if NULL.
+//
+static struct LOOP_STATE* new_state(struct OPTIMIZER* opt, struct LOOP_STATE* from)
+{
+  int num_slots = opt->symbols->num_slots + 1;
+  struct LOOP_STATE* state = (struct LOOP_STATE*)malloc(sizeof(struct LOOP_STATE));
+  if (state == NULL)
+    panic("out of memory (new_state)");
+
+  state->defined = (bool*)calloc(num_slots, sizeof(bool));
+  state->known = (bool*)calloc(num_slots, sizeof(bool));
+  state->values = (struct CONSTANT*)calloc(num_slots, sizeof(struct CONSTANT));
+  if (state->defined == NULL || state->known == NULL || state->values == NULL)
+    panic("out of memory (new_state)");
+
+  if (from != NULL) {
+    memcpy(state->defined, from->defined, num_slots * sizeof(bool));
+    memcpy(state->known, from->known, num_slots * sizeof(bool));
+    memcpy(state->values, from->values, num_slots * sizeof(struct CONSTANT));
+  }
+  return state;
+}
+
+//
+// free_state
+//
+static void free_state(struct LOOP_STATE* state)
+{
+  free(state->defined);
+  free(state->known);
+  free(state->values);
+  free(state);
+}
+
+//
+// hoist_stmts
+//
+// Loop-invariant code motion, for the statements from *link until
+// stop: each while loop that is known to run at least once has its
+// invariant assignments moved in front of it, then its body is
+// processed the same way. state holds what is known about the
+// variables at *link, and is updated along the way. Returns true if
+// anything was hoisted.
+//
+static bool hoist_stmts(struct OPTIMIZER* opt, struct STMT** link, struct STMT* stop, struct LOOP_STATE* state)
+{
+  int num_slots = opt->symbols->num_slots + 1;
+  bool changed = false;
+
+  while (*link != NULL && *link != stop) {
+    struct STMT* stmt = *link;
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      assign_state(opt, stmt, state);
+    } else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
+      int* assigned = (int*)calloc(num_slots, sizeof(int));
+      if (assigned == NULL)
+        panic("out of memory (hoist_stmts)");
+      mark_assigned(opt, while_loop->loop_body, stmt, assigned);
+
+      struct STMT** hoist;
+      while ((hoist = find_hoistable(opt, stmt, assigned, state)) != NULL) {
+        struct STMT* invariant = *hoist;
+        *hoist = *next_link(invariant);  // out of the body...
+        *next_link(invariant) = stmt;    // ...and in front of the loop
+        *link = invariant;
+        link = next_link(invariant);
+
+        if (opt->dump)
+          printf("**hoisted line %d out of the while loop on line %d\n", invariant->line, stmt->line);
+
+        assigned[symtab_lookup(opt->symbols, invariant->types.assignment->var_name)]--;
+        assign_state(opt, invariant, state);
+        changed = true;
+      }
+
+      // in the body, only what the loop doesn't change is known:
+      struct LOOP_STATE* body = new_state(opt, state);
+      for (int slot = 0; slot < num_slots; slot++) {
+        if (assigned[slot] > 0)
+          state->known[slot] = body->known[slot] = false;
+      }
+      changed = hoist_stmts(opt, &while_loop->loop_body, stmt, body) || changed;
+
+      free_state(body);
+      free(assigned);
+    } else if (stmt->stmt_type != STMT_FUNCTION_CALL && stmt->stmt_type != STMT_PASS) {
+      return changed;
+    }
+    link = next_link(stmt);
+  }
+  return changed;
+}
+
+//
+// optimize_program
+//
+// Optimizes the given program graph in place, repeating the
+// passes until nothing changes. Loop-invariant code motion runs
+// once folding and propagation have done all they can. Returns
+// the first statement of the program, which is different if a
+// statement was hoisted in front of it.
+//
+struct STMT* optimize_program(struct STMT* program, struct ARENA* arena, bool dump_hoisted)
+{
+  struct OPTIMIZER opt;
+  opt.symbols = resolve_program(program);
+  opt.dump = dump_hoisted;
+  opt.arena = arena;
+
+  int num_slots = opt.symbols->num_slots + 1;  // + 1 so nothing is 0 bytes
+  opt.num_assignments = (int*)malloc(num_slots * sizeof(int));
+  opt.assignment = (struct STMT**)malloc(num_slots * sizeof(struct STMT*));
+  opt.position = (int*)malloc(num_slots * sizeof(int));
+  opt.types = (int*)malloc(num_slots * sizeof(int));
+
+  if (opt.num_assignments == NULL || opt.assignment == NULL || opt.position == NULL || opt.types == NULL)
+    panic("out of memory (optimize_program)");
+
+  bool changed = true;
+  while (changed) {
+    for (int slot = 0; slot < num_slots; slot++) {
+      opt.num_assignments[slot] = 0;
+      opt.assignment[slot] = NULL;
+      opt.position[slot] = -1;
+      opt.types[slot] = 0;
+    }
+    opt.deref_store = false;
+
+    analyze_stmts(&opt, program, NULL, 0);
+    while (infer_stmts(&opt, program, NULL))
+      ;
+
+    changed = optimize_stmts(&opt, program, NULL, 0);
+
+    if (!changed && !opt.deref_store) {  // a *p = ... could change any variable
+      struct LOOP_STATE* state = new_state(&opt, NULL);
+      changed = hoist_stmts(&opt, &program, NULL, state);
+      free_state(state);
+    }
+  }
+
+  free(opt.num_assignments);
+  free(opt.assignment);
+  free(opt.position);
+  free(opt.types);
+  symtab_destroy(opt.symbols);
+
+  return program;
+}
@@ -0,0 +1,45 @@
+/*optimize.h*/
+
+//
+// Optimization pass over a nuPython program graph, run between
+// programgraph_build and execution. Expressions whose operands are
+// all literals are folded into a single literal, variables that are
+// assigned a literal exactly once have that literal propagated into
+// their uses, identities such as x + 0 and x * 1 are simplified
+// when x is known to be a number, and assignments whose value cannot
+// change in a while loop are hoisted out of it, to run just once.
+//
+// The pass never changes what a program outputs: an expression that
+// would report a semantic error (e.g. a ZeroDivisionError) is left
+// alone, so the error is still reported at run-time, with its line.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "arena.h"
+
+
+//
+// Public functions:
+//
+
+//
+// optimize_program
+//
+// Optimizes the given program graph in place, and returns the
+// first statement of the optimized program (a statement may be
+// hoisted in front of it). If the graph was built in an arena
+// (see frontend.h), new nodes come from that arena too; if arena
+// is NULL, nodes that are no longer needed are freed, so the graph
+// must still be freed with programgraph_destroy as usual. If
+// dump_hoisted is true, each statement hoisted out of a loop is
+// output, for debugging.
+//
+struct STMT* optimize_program(struct STMT* program, struct ARENA* arena, bool dump_hoisted);
@@ -0,0 +1,304 @@
+/*output.c*/
+
+//
+// Output for nuPython's print() (see output.h). Integers are converted
+// a digit at a time, from the right. A real is converted exactly, like
+// printf("%f"): the double is m * 2^e, so its integer part is m shifted
+// --- a big number only when e is large --- and its fraction is m's low
+// bits, multiplied by 10 once per digit as a fixed-point big number;
+// the 7th digit on (the rest of the fraction) then rounds the 6th,
+// with ties going to the even digit.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#define _DEFAULT_SOURCE  // fwrite_unlocked
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>  // true, false
+#include <stdint.h>   // uint32_t, uint64_t
+
+#include "output.h"
+
+
+#if defined(__GLIBC__)
+#define WRITE fwrite_unlocked  // no lock per print
+#else
+#define WRITE fwrite
+#endif
+
+#define OUTPUT_SIZE  (1 << 16)  // bytes
+#define FRACTION_DIGITS 6       // as %f
+#define MAX_LIMBS    36         // 32-bit limbs, for 1024 + 64 bits
+
+static char buffer[OUTPUT_SIZE];
+
+
+//
+// output_init
+//
+// Makes stdout fully buffered, with the output buffer.
+//
+void output_init(void)
+{
+  setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+}
+
+//
+// format_unsigned
+//
+// Writes the digits of the given value so they end just before end,
+// and returns where they start.
+//
+static char* format_unsigned(uint64_t value, char* end)
+{
+  char* p = end;
+
+  do {
+    *--p = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  return p;
+}
+
+//
+// format_big
+//
+// Writes the digits of the given big number, limbs[0] least significant,
+// so they end just before end, and returns where they start. The limbs
+// are used up.
+//
+static char* format_big(uint32_t* limbs, int n, char* end)
+{
+  char* p = end;
+
+  while (n > 0 && limbs[n - 1] == 0)
+    n--;
+
+  while (n > 0) {
+    //
+    // divide by 10^9, and the remainder is the next 9 digits:
+    //
+    uint64_t remainder = 0;
+    for (int i = n - 1; i >= 0; i--) {
+      uint64_t part = (remainder << 32) | limbs[i];
+      limbs[i] = (uint32_t)(part / 1000000000u);
+      remainder = part % 1000000000u;
+    }
+    while (n > 0 && limbs[n - 1] == 0)
+      n--;
+
+    char* start = format_unsigned(remainder, p);
+    if (n > 0) {  // not the leading digits, so pad to 9:
+      while (p - start < 9)
+        *--start = '0';
+    }
+    p = start;
+  }
+
+  if (p == end)
+    *--p = '0';
+  return p;
+}
+
+//
+// format_real
+//
+// Writes the given value, as %f would, into text; returns the # of
+// characters.
+//
+static int format_real(double value, char* text)
+{
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  bool negative = (bits >> 63) != 0;
+  int exponent = (int)((bits >> 52) & 0x7FF);
+  uint64_t mantissa = bits & ((1ull << 52) - 1);
+
+  char* p = text;
+  if (negative)
+    *p++ = '-';
+
+  if (exponent == 0x7FF) {  // nan or inf, as glibc:
+    const char* name = (mantissa != 0) ? "nan" : "inf";
+    memcpy(p, name, 3);
+    return (int)(p + 3 - text);
+  }
+
+  int e;
+  if (exponent == 0) {  // subnormal
+    e = -1074;
+  }
+  else {
+    mantissa |= (1ull << 52);
+    e = exponent - 1075;
+  }
+
+  //
+  // the integer part: m << e, which is a big number when e > 11:
+  //
+  char digits[400];  // the integer part, at the end
+  char* end = digits + sizeof(digits);
+  char* start;
+  uint64_t integer = 0;
+  uint32_t limbs[MAX_LIMBS];
+
+  if (e > 11) {
+    memset(limbs, 0, sizeof(limbs));
+    int shift = e % 32;
+    int index = e / 32;
+    uint64_t low = mantissa << shift;  // m < 2^53, so m << shift fits in 85 bits
+    limbs[index] = (uint32_t)low;
+    limbs[index + 1] = (uint32_t)(low >> 32);
+    limbs[index + 2] = (uint32_t)((shift == 0) ? 0 : mantissa >> (64 - shift));
+    start = format_big(limbs, index + 3, end);
+
+    int length = (int)(end - start);
+    memcpy(p, start, length);
+    p += length;
+    memcpy(p, ".000000", 7);
+    return (int)(p + 7 - text);
+  }
+
+  //
+  // the fraction: the low k bits of m, as a fixed-point big number of n
+  // limbs (the point above the top limb), multiplied by 10 per digit:
+  //
+  char fraction[FRACTION_DIGITS];
+  int k = (e < 0) ? -e : 0;
+  int n = (k + 31) / 32;
+
+  if (e >= 0) {
+    integer = mantissa << e;
+  }
+  else if (k < 64) {
+    integer = mantissa >> k;
+  }
+
+  memset(limbs, 0, sizeof(limbs));
+  if (k > 0) {
+    uint64_t bits_below = (k < 64) ? (mantissa & ((1ull << k) - 1)) : mantissa;
+    int at = 32 * n - k;  // where the fraction's lowest bit goes
+    int shift = at % 32;
+    int index = at / 32;
+    uint64_t low = bits_below << shift;
+    limbs[index] = (uint32_t)low;
+    if (index + 1 < n)
+      limbs[index + 1] = (uint32_t)(low >> 32);
+    if (index + 2 < n && shift != 0)
+      limbs[index + 2] = (uint32_t)(bits_below >> (64 - shift));
+  }
+
+  for (int d = 0; d < FRACTION_DIGITS; d++) {
+    uint64_t carry = 0;
+    for (int i = 0; i < n; i++) {
+      uint64_t product = (uint64_t)limbs[i] * 10 + carry;
+      limbs[i] = (uint32_t)product;
+      carry = product >> 32;
+    }
+    fraction[d] = (char)('0' + carry);
+  }
+
+  //
+  // round on the rest of the fraction: above half up, below down, and
+  // exactly half to the even digit:
+  //
+  bool round_up = false;
+  if (n > 0 && limbs[n - 1] >= 0x80000000u) {
+    bool above = (limbs[n - 1] > 0x80000000u);
+    for (int i = 0; i < n - 1 && !above; i++)
+      above = (limbs[i] != 0);
+    round_up = above || ((fraction[FRACTION_DIGITS - 1] - '0') % 2 == 1);
+  }
+
+  if (round_up) {
+    int d = FRACTION_DIGITS - 1;
+    while (d >= 0 && fraction[d] == '9') {
+      fraction[d] = '0';
+      d--;
+    }
+    if (d >= 0)
+      fraction[d]++;
+    else
+      integer++;  // e.g. 0.9999996 => 1.000000
+  }
+
+  start = format_unsigned(integer, end);
+
+  int length = (int)(end - start);
+  memcpy(p, start, length);
+  p += length;
+  *p++ = '.';
+  memcpy(p, fraction, FRACTION_DIGITS);
+  return (int)(p + FRACTION_DIGITS - text);
+}
+
+//
+// output_int
+//
+// Outputs the integer, followed by a newline.
+//
+void output_int(int value)
+{
+  char text[16];
+  char* end = text + sizeof(text);
+
+  *--end = '\n';
+  uint64_t magnitude = (value < 0) ? (uint64_t)0 - (uint64_t)(int64_t)value : (uint64_t)value;
+  char* start = format_unsigned(magnitude, end);
+  if (value < 0)
+    *--start = '-';
+
+  WRITE(start, 1, text + sizeof(text) - start, stdout);
+}
+
+//
+// output_real
+//
+// Outputs the real, as printf("%f\n") would.
+//
+void output_real(double value)
+{
+  char text[352];  // a sign, 309 digits, the point, 6 digits, and \n
+
+  int length = format_real(value, text);
+  text[length++] = '\n';
+
+  WRITE(text, 1, length, stdout);
+}
+
+//
+// output_string
+//
+// Outputs the string, followed by a newline.
+//
+void output_string(const char* value)
+{
+  WRITE(value, 1, strlen(value), stdout);
+  WRITE("\n", 1, 1, stdout);
+}
+
+//
+// output_newline
+//
+// Outputs a newline.
+//
+void output_newline(void)
+{
+  WRITE("\n", 1, 1, stdout);
+}
+
+//
+// output_flush
+//
+// Writes out the output buffer.
+//
+void output_flush(void)
+{
+  fflush(stdout);
+}
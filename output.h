@@ -0,0 +1,54 @@
+/*output.h*/
+
+//
+// Output for nuPython's print(): values are formatted by hand --- no
+// printf format strings --- and written, unlocked, into one large,
+// fully-buffered stdout buffer (even when stdout is a terminal), which
+// is flushed when the buffer fills, before input() reads a line, and
+// on exit (including the error exits). Everything else written to
+// stdout, e.g. the error messages, goes through the same buffer, so
+// the output stays in order.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+
+//
+// Public functions:
+//
+
+//
+// output_init
+//
+// Makes stdout fully buffered, with the output buffer; must be called
+// before anything is written to stdout.
+//
+void output_init(void);
+
+//
+// output_int / output_real / output_string
+//
+// Outputs the value, followed by a newline, as print() does; a real
+// is output exactly as printf("%f") would.
+//
+void output_int(int value);
+void output_real(double value);
+void output_string(const char* value);
+
+//
+// output_newline
+//
+// Outputs just a newline, as print() with no arguments does.
+//
+void output_newline(void);
+
+//
+// output_flush
+//
+// Writes out whatever is in the output buffer.
+//
+void output_flush(void);
@@ -0,0 +1,543 @@
+/*ram.c*/
+
+//
+// Random access memory (RAM) for nuPython. Memory is an array of cells,
+// and a variable's address is the index of its cell. Cells are only
+// ever appended, so an address never changes once a variable has been
+// written; when the array grows it is reallocated, which moves the
+// cells but not their addresses.
+//
+// Identifiers are found through an open-addressing hash index (linear
+// probing) that maps identifier -> address, so every by-name operation
+// is O(1) on average instead of a linear search of the cells.
+//
+// String values are refcounted rstrings (see rstring.h), so reading a
+// string, or sharing one between cells, is a reference count bump.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+// Original: Prof. Joe Hummel
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "ram.h"
+#include "rstring.h"
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**RAM ERROR\n");
+  printf("**RAM ERROR: %s\n", msg);
+  printf("**RAM ERROR\n");
+
+  exit(-123);
+}
+
+//
+// dupString
+//
+// Duplicates the given string and returns a pointer to the copy.
+//
+static char* dupString(char* s)
+{
+  if (s == NULL)
+    panic("s is NULL (dupString)");
+
+  char* copy = (char*)malloc((strlen(s) + 1) * sizeof(char));
+  if (copy == NULL)
+    panic("out of memory (dupString)");
+
+  strcpy(copy, s);
+
+  return copy;
+}
+
+//
+// hash_identifier
+//
+// Returns the FNV-1a hash of the given identifier.
+//
+static unsigned int hash_identifier(char* identifier)
+{
+  unsigned int hash = 2166136261u;
+
+  for (char* p = identifier; *p != '\0'; p++) {
+    hash ^= (unsigned char)*p;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+//
+// find_bucket
+//
+// Returns the index bucket holding the given identifier, or the empty
+// bucket where the identifier would be inserted.
+//
+static int find_bucket(struct RAM* memory, char* identifier)
+{
+  int mask = memory->index_size - 1;
+  int bucket = (int)(hash_identifier(identifier) & (unsigned int)mask);
+
+  while (memory->index[bucket] != 0) {
+    int address = memory->index[bucket] - 1;
+    if (strcmp(memory->cells[address].identifier, identifier) == 0)
+      return bucket;
+    bucket = (bucket + 1) & mask;
+  }
+  return bucket;
+}
+
+//
+// find_identifier
+//
+// Returns the address of the given identifier, or -1 if the
+// identifier has not been written to memory.
+//
+static int find_identifier(struct RAM* memory, char* identifier)
+{
+  int bucket = find_bucket(memory, identifier);
+  return memory->index[bucket] - 1;
+}
+
+//
+// grow_index
+//
+// Doubles the number of buckets in the index and re-inserts every
+// identifier. Called to keep the index at most half full.
+//
+static void grow_index(struct RAM* memory)
+{
+  free(memory->index);
+
+  memory->index_size *= 2;
+  memory->index = (int*)calloc(memory->index_size, sizeof(int));
+  if (memory->index == NULL)
+    panic("out of memory (grow_index)");
+
+  for (int address = 0; address < memory->num_values; address++) {
+    int bucket = find_bucket(memory, memory->cells[address].identifier);
+    memory->index[bucket] = address + 1;
+  }
+}
+
+
+//
+// ram_init
+//
+// Returns a pointer to a dynamically-allocated memory
+// for storing nuPython variables and their values. All
+// memory cells are initialized to the value None.
+//
+struct RAM* ram_init(void)
+{
+  struct RAM* memory = (struct RAM*)malloc(sizeof(struct RAM));
+  if (memory == NULL)
+    panic("out of memory (ram_init)");
+
+  memory->num_values = 0;
+  memory->capacity = 4;
+
+  memory->cells = (struct RAM_CELL*)malloc(memory->capacity * sizeof(struct RAM_CELL));
+  if (memory->cells == NULL)
+    panic("out of memory (ram_init)");
+
+  for (int i = 0; i < memory->capacity; i++) {
+    memory->cells[i].identifier = NULL;
+    memory->cells[i].value.value_type = RAM_TYPE_NONE;
+  }
+
+  memory->index_size = 8;
+  memory->index = (int*)calloc(memory->index_size, sizeof(int));
+  if (memory->index == NULL)
+    panic("out of memory (ram_init)");
+
+  return memory;
+}
+
+//
+// ram_destroy
+//
+// Frees the dynamically-allocated memory associated with
+// the given memory. After the call returns, you cannot
+// use the memory.
+//
+void ram_destroy(struct RAM* memory)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_destroy)");
+
+  for (int i = 0; i < memory->num_values; i++) {
+    free(memory->cells[i].identifier);
+
+    if (memory->cells[i].value.value_type == RAM_TYPE_STR)
+      rstr_release(memory->cells[i].value.types.s);
+  }
+
+  free(memory->cells);
+  free(memory->index);
+  free(memory);
+}
+
+//
+// ram_get_addr
+//
+// If the given identifier (e.g. "x") has been written to
+// memory, returns the address of this value. Returns -1
+// if no such identifier exists in memory.
+//
+int ram_get_addr(struct RAM* memory, char* identifier)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_get_addr)");
+
+  return find_identifier(memory, identifier);
+}
+
+//
+// ram_read_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a COPY of the value contained in that memory cell.
+// Returns NULL if the address is not valid.
+//
+struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_read_cell_by_addr)");
+
+  if (address < 0 || address >= memory->num_values)
+    return NULL;
+
+  struct RAM_VALUE* value = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
+  if (value == NULL)
+    panic("out of memory (ram_read_cell_by_addr)");
+
+  *value = memory->cells[address].value;
+
+  //
+  // the copy shares the (immutable) string, the caller owns a reference:
+  //
+  if (value->value_type == RAM_TYPE_STR)
+    rstr_retain(value->types.s);
+
+  return value;
+}
+
+//
+// ram_read_cell_by_name
+//
+// If the given name (e.g. "x") has been written to
+// memory, returns a COPY of the value contained in memory.
+// Returns NULL if no such name exists in memory.
+//
+struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_read_cell_by_name)");
+  if (name == NULL)
+    panic("identifier ptr is null (ram_read_cell_by_name)");
+
+  int address = find_identifier(memory, name);
+
+  return ram_read_cell_by_addr(memory, address);
+}
+
+//
+// ram_free_value
+//
+// Frees the memory value returned by ram_read_cell_by_name and
+// ram_read_cell_by_addr.
+//
+void ram_free_value(struct RAM_VALUE* value)
+{
+  if (value == NULL)
+    return;
+
+  if (value->value_type == RAM_TYPE_STR)
+    rstr_release(value->types.s);
+
+  free(value);
+}
+
+//
+// ram_peek_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value contained in that memory
+// cell, without copying. Returns NULL if the address is not
+// valid. The value is borrowed (see ram.h).
+//
+const struct RAM_VALUE* ram_peek_cell_by_addr(struct RAM* memory, int address)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_peek_cell_by_addr)");
+
+  if (address < 0 || address >= memory->num_values)
+    return NULL;
+
+  return &memory->cells[address].value;
+}
+
+//
+// ram_peek_cell_by_name
+//
+// If the given name (e.g. "x") has been written to memory,
+// returns a pointer to the value contained in memory, without
+// copying. Returns NULL if no such name exists in memory. The
+// value is borrowed (see ram.h).
+//
+const struct RAM_VALUE* ram_peek_cell_by_name(struct RAM* memory, char* name)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_peek_cell_by_name)");
+  if (name == NULL)
+    panic("identifier ptr is null (ram_peek_cell_by_name)");
+
+  int address = find_identifier(memory, name);
+
+  return ram_peek_cell_by_addr(memory, address);
+}
+
+//
+// store_value
+//
+// Stores the given value in the cell at the given (valid) address,
+// releasing the cell's old string (if any). A string value must be
+// an rstring, and the cell takes over the caller's reference.
+//
+static void store_value(struct RAM* memory, struct RAM_VALUE value, int address)
+{
+  struct RAM_CELL* cell = &memory->cells[address];
+
+  if (cell->value.value_type == RAM_TYPE_STR)
+    rstr_release(cell->value.types.s);
+
+  cell->value = value;
+}
+
+//
+// ram_write_cell_by_addr
+//
+// Writes the given value to the memory cell at the given
+// address. If a value already exists at this address, that
+// value is overwritten by this new value. Returns true if
+// the value was successfully written, false if not (which
+// implies the memory address is invalid).
+//
+bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_write_cell_by_addr)");
+
+  if (address < 0 || address >= memory->num_values)
+    return false;
+
+  //
+  // store a copy of the new string so memory owns all of its
+  // strings. The copy is made before the existing string is 
+  // released, since the value may have been borrowed from this 
+  // very cell (e.g. x = x):
+  //
+  if (value.value_type == RAM_TYPE_STR)
+    value.types.s = rstr_from(value.types.s);
+
+  store_value(memory, value, address);
+
+  return true;
+}
+
+//
+// ram_share_cell_by_addr
+//
+// Like ram_write_cell_by_addr, except a string value must be an
+// rstring, and is shared (memory adds a reference) instead of
+// being copied.
+//
+bool ram_share_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_share_cell_by_addr)");
+
+  if (address < 0 || address >= memory->num_values)
+    return false;
+
+  //
+  // retain before the old string is released, in case they
+  // are the same string (e.g. x = x):
+  //
+  if (value.value_type == RAM_TYPE_STR)
+    rstr_retain(value.types.s);
+
+  store_value(memory, value, address);
+
+  return true;
+}
+
+//
+// ram_append_cell_by_addr
+//
+// Appends length chars of s to the string in the cell at the 
+// given address, in place if memory holds the only reference.
+// Returns false if the address is invalid or the cell does not
+// hold a string.
+//
+bool ram_append_cell_by_addr(struct RAM* memory, const char* s, int length, int address)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_append_cell_by_addr)");
+
+  if (address < 0 || address >= memory->num_values)
+    return false;
+
+  struct RAM_VALUE* value = &memory->cells[address].value;
+  if (value->value_type != RAM_TYPE_STR)
+    return false;
+
+  value->types.s = rstr_append(value->types.s, s, length);
+
+  return true;
+}
+
+//
+// cell_address
+//
+// Returns the address of the cell with the given name, appending
+// a new cell (with the value None) if there is no such cell yet.
+//
+static int cell_address(struct RAM* memory, char* name)
+{
+  int bucket = find_bucket(memory, name);
+  int address = memory->index[bucket] - 1;
+
+  if (address < 0) {
+    //
+    // new variable, append a cell (growing memory if full):
+    //
+    if (memory->num_values == memory->capacity) {
+      memory->capacity *= 2;
+      memory->cells = (struct RAM_CELL*)realloc(memory->cells, memory->capacity * sizeof(struct RAM_CELL));
+      if (memory->cells == NULL)
+        panic("out of memory (cell_address)");
+
+      for (int i = memory->num_values; i < memory->capacity; i++) {
+        memory->cells[i].identifier = NULL;
+        memory->cells[i].value.value_type = RAM_TYPE_NONE;
+      }
+    }
+
+    address = memory->num_values;
+    memory->num_values++;
+
+    memory->cells[address].identifier = dupString(name);
+    memory->index[bucket] = address + 1;
+
+    if (memory->num_values * 2 > memory->index_size)
+      grow_index(memory);
+  }
+
+  return address;
+}
+
+//
+// ram_write_cell_by_name
+//
+// Writes the given value to a memory cell named by the given
+// name. If a memory cell already exists with this name, the
+// existing value is overwritten by this new value. Returns
+// true since this operation always succeeds.
+//
+bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_write_cell_by_name)");
+  if (name == NULL)
+    panic("identifier ptr is null (ram_write_cell_by_name)");
+
+  int address = cell_address(memory, name);
+
+  return ram_write_cell_by_addr(memory, value, address);
+}
+
+//
+// ram_share_cell_by_name
+//
+// Like ram_write_cell_by_name, except a string value must be an
+// rstring, and is shared (memory adds a reference) instead of
+// being copied.
+//
+bool ram_share_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_share_cell_by_name)");
+  if (name == NULL)
+    panic("identifier ptr is null (ram_share_cell_by_name)");
+
+  int address = cell_address(memory, name);
+
+  return ram_share_cell_by_addr(memory, value, address);
+}
+
+//
+// ram_print
+//
+// Prints the contents of RAM to the console, for debugging.
+//
+void ram_print(struct RAM* memory)
+{
+  if (memory == NULL)
+    panic("memory ptr is null (ram_print)");
+
+  printf("**MEMORY PRINT**\n");
+
+  printf("Capacity: %d\n", memory->capacity);
+  printf("Num values: %d\n", memory->num_values);
+  printf("Contents:\n");
+
+  for (int i = 0; i < memory->num_values; i++) {
+    struct RAM_CELL* cell = &memory->cells[i];
+
+    printf(" %d: %s, ", i, cell->identifier);
+
+    switch (cell->value.value_type) {
+    case RAM_TYPE_INT:
+      printf("int, %d", cell->value.types.i);
+      break;
+    case RAM_TYPE_REAL:
+      printf("real, %lf", cell->value.types.d);
+      break;
+    case RAM_TYPE_STR:
+      printf("str, '%s'", cell->value.types.s);
+      break;
+    case RAM_TYPE_PTR:
+      printf("ptr, %d", cell->value.types.i);
+      break;
+    case RAM_TYPE_BOOLEAN:
+      if (cell->value.types.i == 0)
+        printf("boolean, False");
+      else
+        printf("boolean, True");
+      break;
+    case RAM_TYPE_NONE:
+      printf("none, None");
+      break;
+    default:
+      panic("unknown ram value type?! (ram_print)");
+    }
+
+    printf("\n");
+  }
+
+  printf("**END PRINT**\n");
+}
@@ -3,6 +3,14 @@
 //
 // Random access memory (RAM) for nuPython
 //
+// Variables are found by name through a hash index, so the by-name
+// functions below take O(1) time on average regardless of how many
+// variables are in memory.
+//
+// Strings in memory are reference-counted and immutable (see
+// rstring.h): reading a string value, or writing one with the
+// ram_share functions, shares the string instead of copying it.
+//
 // Prof. Joe Hummel
 // Northwestern University
 // CS 211
@@ -55,6 +63,9 @@ struct RAM
   struct RAM_CELL* cells;  // array of memory cells
   int num_values;  // # of values currently stored in memory
   int capacity;    // total # of cells available in memory
+
+  int* index;      // hash index by identifier: address+1, 0 => empty
+  int index_size;  // # of buckets in the index, always a power of 2
 };
 
 
@@ -105,6 +116,8 @@ int ram_get_addr(struct RAM* memory, char* identifier);
 // NOTE: this function allocates memory for the value that
 // is returned. The caller takes ownership of the copy and 
 // must eventually free this memory via ram_free_value().
+// A string is not duplicated: the copy holds a reference to
+// the string in memory, which must not be modified.
 //
 // NOTE: a variable has to be written to memory before its
 // address becomes valid. Once a variable is written to memory,
@@ -122,6 +135,7 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address);
 // NOTE: this function allocates memory for the value that
 // is returned. The caller takes ownership of the copy and 
 // must eventually free this memory via ram_free_value().
+// As with ram_read_cell_by_addr, a string is shared.
 //
 struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name);
 
@@ -133,6 +147,36 @@ struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name);
 //
 void ram_free_value(struct RAM_VALUE* value);
 
+//
+// ram_peek_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value contained in that memory
+// cell --- NOT a copy, nothing is allocated. Returns NULL if
+// the address is not valid.
+//
+// NOTE: the value is borrowed from memory. The caller must
+// not modify or free it (or its string). The pointer, and 
+// the string it holds, remain valid only until the next 
+// write to memory: a write can replace the string, and a
+// write by name can move the cells when memory grows. Copy
+// anything you need before writing, or rstr_retain() the
+// string to keep it.
+//
+const struct RAM_VALUE* ram_peek_cell_by_addr(struct RAM* memory, int address);
+
+//
+// ram_peek_cell_by_name
+//
+// If the given name (e.g. "x") has been written to memory,
+// returns a pointer to the value contained in memory --- NOT
+// a copy. Returns NULL if no such name exists in memory.
+//
+// NOTE: the value is borrowed, with the same rules as
+// ram_peek_cell_by_addr.
+//
+const struct RAM_VALUE* ram_peek_cell_by_name(struct RAM* memory, char* name);
+
 //
 // ram_write_cell_by_addr
 //
@@ -151,6 +195,31 @@ void ram_free_value(struct RAM_VALUE* value);
 //
 bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address);
 
+//
+// ram_share_cell_by_addr
+//
+// Like ram_write_cell_by_addr, except that a string value is 
+// shared rather than duplicated: the string MUST be an rstring
+// (see rstring.h), and memory adds its own reference to it. The
+// caller keeps its reference (and releases it when done).
+//
+bool ram_share_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address);
+
+//
+// ram_append_cell_by_addr
+//
+// Appends the first length chars of s to the string held in the
+// memory cell at the given address, i.e. x = x + s. If memory 
+// holds the only reference to the string, it is extended in 
+// place (amortized O(1) per append); see rstr_append. Returns 
+// true if the value was successfully appended, false if not 
+// (the address is invalid or the cell does not hold a string).
+//
+// NOTE: s must not point into the cell's string. If it may,
+// rstr_retain() it first.
+//
+bool ram_append_cell_by_addr(struct RAM* memory, const char* s, int length, int address);
+
 //
 // ram_write_cell_by_name
 //
@@ -168,6 +237,14 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 //
 bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name);
 
+//
+// ram_share_cell_by_name
+//
+// Like ram_write_cell_by_name, except that a string value is
+// shared rather than duplicated, as in ram_share_cell_by_addr.
+//
+bool ram_share_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name);
+
 //
 // ram_print
 //
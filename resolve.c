@@ -0,0 +1,238 @@
+/*resolve.c*/
+
+//
+// Resolves the variable names in a nuPython program graph to slot
+// numbers. Names are kept in an open-addressing hash table (linear
+// probing), so resolving a program is linear in its size no matter
+// how many distinct variables it uses.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+#include "programgraph.h"
+#include "resolve.h"
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**RESOLVE ERROR\n");
+  printf("**RESOLVE ERROR: %s\n", msg);
+  printf("**RESOLVE ERROR\n");
+
+  exit(-123);
+}
+
+//
+// hash_name
+//
+// Returns the FNV-1a hash of the given name.
+//
+static unsigned int hash_name(char* name)
+{
+  unsigned int hash = 2166136261u;
+
+  for (char* p = name; *p != '\0'; p++) {
+    hash ^= (unsigned char)*p;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+//
+// find_bucket
+//
+// Returns the hash table bucket holding the given name, or the empty
+// bucket where the name would be inserted.
+//
+static int find_bucket(struct SYMTAB* symtab, char* name)
+{
+  int mask = symtab->table_size - 1;
+  int bucket = (int)(hash_name(name) & (unsigned int)mask);
+
+  while (symtab->table[bucket] != 0) {
+    int slot = symtab->table[bucket] - 1;
+    if (strcmp(symtab->names[slot], name) == 0)
+      return bucket;
+    bucket = (bucket + 1) & mask;
+  }
+  return bucket;
+}
+
+//
+// grow_table
+//
+// Doubles the size of the hash table and re-inserts every name.
+//
+static void grow_table(struct SYMTAB* symtab)
+{
+  free(symtab->table);
+
+  symtab->table_size *= 2;
+  symtab->table = (int*)calloc(symtab->table_size, sizeof(int));
+  if (symtab->table == NULL)
+    panic("out of memory (grow_table)");
+
+  for (int slot = 0; slot < symtab->num_slots; slot++) {
+    int bucket = find_bucket(symtab, symtab->names[slot]);
+    symtab->table[bucket] = slot + 1;
+  }
+}
+
+//
+// symtab_lookup
+//
+// Returns the slot for the given name, or -1 if the name
+// is not in the symbol table.
+//
+int symtab_lookup(struct SYMTAB* symtab, char* name)
+{
+  int bucket = find_bucket(symtab, name);
+  return symtab->table[bucket] - 1;
+}
+
+//
+// symtab_slot
+//
+// Returns the slot for the given name, adding the name
+// to the symbol table if it has not been seen before.
+//
+int symtab_slot(struct SYMTAB* symtab, char* name)
+{
+  int bucket = find_bucket(symtab, name);
+  if (symtab->table[bucket] != 0)
+    return symtab->table[bucket] - 1;
+
+  if (symtab->num_slots == symtab->capacity) {
+    symtab->capacity *= 2;
+    symtab->names = (char**)realloc(symtab->names, symtab->capacity * sizeof(char*));
+    if (symtab->names == NULL)
+      panic("out of memory (symtab_slot)");
+  }
+
+  int slot = symtab->num_slots;
+  symtab->names[slot] = (char*)malloc(strlen(name) + 1);
+  if (symtab->names[slot] == NULL)
+    panic("out of memory (symtab_slot)");
+  strcpy(symtab->names[slot], name);
+  symtab->num_slots++;
+
+  symtab->table[bucket] = slot + 1;
+
+  if (symtab->num_slots * 2 > symtab->table_size) // keep the load factor <= 1/2
+    grow_table(symtab);
+
+  return slot;
+}
+
+//
+// resolve_expr
+//
+// Resolves the identifiers in an expression.
+//
+static void resolve_expr(struct SYMTAB* symtab, struct EXPR* expr)
+{
+  if (expr->lhs != NULL && expr->lhs->element->element_type == ELEMENT_IDENTIFIER)
+    symtab_slot(symtab, expr->lhs->element->element_value);
+
+  if (expr->isBinaryExpr && expr->rhs != NULL && expr->rhs->element->element_type == ELEMENT_IDENTIFIER)
+    symtab_slot(symtab, expr->rhs->element->element_value);
+}
+
+//
+// resolve_stmts
+//
+// Resolves the names in each statement until stop (or the end of the
+// program) is reached. The last stmt in a loop body links back to the
+// loop, which is where the body stops.
+//
+static void resolve_stmts(struct SYMTAB* symtab, struct STMT* stmt, struct STMT* stop)
+{
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+      symtab_slot(symtab, assignment->var_name);
+
+      if (assignment->rhs->value_type == VALUE_EXPR) {
+        resolve_expr(symtab, assignment->rhs->types.expr);
+      } else {
+        // int(x) and float(x) read their parameter as a variable:
+        struct FUNCTION_CALL* call = assignment->rhs->types.function_call;
+        bool is_conversion = (strcmp(call->function_name, "int") == 0 || strcmp(call->function_name, "float") == 0);
+        if (call->parameter != NULL && is_conversion)
+          symtab_slot(symtab, call->parameter->element_value);
+      }
+      stmt = assignment->next_stmt;
+    } else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      struct ELEMENT* parameter = stmt->types.function_call->parameter;
+      if (parameter != NULL && parameter->element_type == ELEMENT_IDENTIFIER)
+        symtab_slot(symtab, parameter->element_value);
+      stmt = stmt->types.function_call->next_stmt;
+    } else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
+      resolve_expr(symtab, while_loop->condition);
+      resolve_stmts(symtab, while_loop->loop_body, stmt);
+      stmt = while_loop->next_stmt;
+    } else if (stmt->stmt_type == STMT_PASS) {
+      stmt = stmt->types.pass->next_stmt;
+    } else {
+      return;
+    }
+  }
+}
+
+//
+// resolve_program
+//
+// Walks the program graph and gives each variable name a
+// slot, in order of first appearance. Returns the symbol table.
+//
+struct SYMTAB* resolve_program(struct STMT* program)
+{
+  struct SYMTAB* symtab = (struct SYMTAB*)malloc(sizeof(struct SYMTAB));
+  if (symtab == NULL)
+    panic("out of memory (resolve_program)");
+
+  symtab->num_slots = 0;
+  symtab->capacity = 8;
+  symtab->names = (char**)malloc(symtab->capacity * sizeof(char*));
+
+  symtab->table_size = 16;
+  symtab->table = (int*)calloc(symtab->table_size, sizeof(int));
+
+  if (symtab->names == NULL || symtab->table == NULL)
+    panic("out of memory (resolve_program)");
+
+  resolve_stmts(symtab, program, NULL);
+
+  return symtab;
+}
+
+//
+// symtab_destroy
+//
+// Frees all the memory associated with the symbol table.
+//
+void symtab_destroy(struct SYMTAB* symtab)
+{
+  if (symtab == NULL)
+    return;
+
+  for (int slot = 0; slot < symtab->num_slots; slot++)
+    free(symtab->names[slot]);
+
+  free(symtab->names);
+  free(symtab->table);
+  free(symtab);
+}
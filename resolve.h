@@ -0,0 +1,68 @@
+/*resolve.h*/
+
+//
+// Identifier resolution for nuPython. Before a program runs, every
+// variable name in the program graph is given a fixed slot number, so
+// the compiled code can refer to variables by slot instead of looking
+// them up by name on every access.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include "programgraph.h"
+
+
+//
+// Symbol table: slot # <-> variable name
+//
+struct SYMTAB
+{
+  char** names;   // slot -> name
+  int num_slots;  // # of names resolved so far
+  int capacity;   // size of the names array
+
+  int* table;     // hash table of slot+1 by name, 0 => empty
+  int table_size; // always a power of 2
+};
+
+
+//
+// Public functions:
+//
+
+//
+// resolve_program
+//
+// Walks the program graph and gives each variable name a
+// slot, in order of first appearance: assignment targets,
+// identifiers in expressions, and function call parameters
+// that are read as variables. Returns the symbol table.
+//
+struct SYMTAB* resolve_program(struct STMT* program);
+
+//
+// symtab_slot
+//
+// Returns the slot for the given name, adding the name
+// to the symbol table if it has not been seen before.
+//
+int symtab_slot(struct SYMTAB* symtab, char* name);
+
+//
+// symtab_lookup
+//
+// Returns the slot for the given name, or -1 if the name
+// is not in the symbol table.
+//
+int symtab_lookup(struct SYMTAB* symtab, char* name);
+
+//
+// symtab_destroy
+//
+// Frees all the memory associated with the symbol table.
+//
+void symtab_destroy(struct SYMTAB* symtab);
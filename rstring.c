@@ -0,0 +1,196 @@
+/*rstring.c*/
+
+//
+// Reference-counted, immutable strings for nuPython. The header
+// is allocated in the same block as the characters, directly in
+// front of them, so one malloc holds the whole string.
+//
+// rstr_append is the one exception to immutability: a string with
+// a single reference can have nobody else looking at it, so it is
+// extended in place. Its capacity grows by doubling, which makes a
+// loop of appends amortized O(1) per append.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>  // offsetof
+
+#include "rstring.h"
+
+
+struct RSTRING
+{
+  int refcount;  // # of references, the string is freed at 0
+  int length;    // # of chars, not counting the '\0'
+  int capacity;  // # of chars that fit, not counting the '\0'
+  char chars[];  // the string itself, NUL-terminated
+};
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**RSTRING ERROR\n");
+  printf("**RSTRING ERROR: %s\n", msg);
+  printf("**RSTRING ERROR\n");
+
+  exit(-123);
+}
+
+//
+// header
+//
+// Returns the header of the given rstring.
+//
+static struct RSTRING* header(const char* s)
+{
+  return (struct RSTRING*)(s - offsetof(struct RSTRING, chars));
+}
+
+//
+// rstr_alloc
+//
+// Allocates an rstring with room for length chars (plus the '\0'),
+// with a reference count of 1. The chars are not initialized.
+//
+static struct RSTRING* rstr_alloc(int length)
+{
+  struct RSTRING* rs = (struct RSTRING*)malloc(sizeof(struct RSTRING) + length + 1);
+  if (rs == NULL)
+    panic("out of memory (rstr_alloc)");
+
+  rs->refcount = 1;
+  rs->length = length;
+  rs->capacity = length;
+  rs->chars[length] = '\0';
+
+  return rs;
+}
+
+//
+// rstr_new
+//
+// Returns a new rstring holding a copy of the first length
+// chars of s, with a reference count of 1.
+//
+char* rstr_new(const char* s, int length)
+{
+  struct RSTRING* rs = rstr_alloc(length);
+  memcpy(rs->chars, s, length);
+
+  return rs->chars;
+}
+
+//
+// rstr_from
+//
+// Returns a new rstring holding a copy of the given C string.
+//
+char* rstr_from(const char* s)
+{
+  if (s == NULL)
+    panic("s is NULL (rstr_from)");
+
+  return rstr_new(s, (int)strlen(s));
+}
+
+//
+// rstr_concat
+//
+// Returns a new rstring holding lhs followed by rhs.
+//
+char* rstr_concat(const char* lhs, int length_lhs, const char* rhs, int length_rhs)
+{
+  struct RSTRING* rs = rstr_alloc(length_lhs + length_rhs);
+  memcpy(rs->chars, lhs, length_lhs);
+  memcpy(rs->chars + length_lhs, rhs, length_rhs);
+
+  return rs->chars;
+}
+
+//
+// rstr_append
+//
+// Appends length chars of tail to s, consuming the caller's
+// reference to s and returning a reference to the result. If s
+// is not shared it is extended in place, otherwise a new string
+// is made (with room to grow) and s is released.
+//
+char* rstr_append(char* s, const char* tail, int length)
+{
+  struct RSTRING* rs = header(s);
+  int new_length = rs->length + length;
+
+  if (rs->refcount > 1) {
+    struct RSTRING* copy = rstr_alloc(new_length);
+    copy->length = rs->length;
+    memcpy(copy->chars, rs->chars, rs->length);
+    rs->refcount--;
+    rs = copy;
+  }
+
+  if (new_length > rs->capacity) {
+    int capacity = 2 * rs->capacity;
+    if (capacity < new_length)
+      capacity = new_length;
+    if (capacity < 16)
+      capacity = 16;
+
+    rs = (struct RSTRING*)realloc(rs, sizeof(struct RSTRING) + capacity + 1);
+    if (rs == NULL)
+      panic("out of memory (rstr_append)");
+    rs->capacity = capacity;
+  }
+
+  memcpy(rs->chars + rs->length, tail, length);
+  rs->length = new_length;
+  rs->chars[new_length] = '\0';
+
+  return rs->chars;
+}
+
+//
+// rstr_retain
+//
+// Adds a reference to the given rstring, and returns it.
+//
+char* rstr_retain(char* s)
+{
+  header(s)->refcount++;
+  return s;
+}
+
+//
+// rstr_release
+//
+// Drops a reference, freeing the string with the last one.
+//
+void rstr_release(char* s)
+{
+  if (s == NULL)
+    return;
+
+  struct RSTRING* rs = header(s);
+  rs->refcount--;
+  if (rs->refcount == 0)
+    free(rs);
+}
+
+//
+// rstr_length
+//
+// Returns the length of the given rstring.
+//
+int rstr_length(const char* s)
+{
+  return header(s)->length;
+}
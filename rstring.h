@@ -0,0 +1,92 @@
+/*rstring.h*/
+
+//
+// Reference-counted, immutable strings for nuPython string values.
+//
+// An rstring is an ordinary NUL-terminated char* that is preceded in
+// memory by a small header holding a reference count and the length.
+// Because the char* points at the characters themselves, an rstring
+// can be passed anywhere a C string is expected (printf, strcmp, ...).
+// Copying a string value is a reference count bump instead of
+// malloc + strcpy: memory cells, VM registers and constants can all
+// share the same string. Since the string may be shared, its
+// characters must never be modified --- except by rstr_append,
+// which only modifies a string nobody else holds a reference to.
+//
+// NOTE: only strings created by the functions below are rstrings; a
+// plain C string (e.g. a literal from the program graph) must never
+// be passed to rstr_retain, rstr_release or rstr_length.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+
+//
+// Public functions:
+//
+
+//
+// rstr_new
+//
+// Returns a new rstring holding a copy of the first length
+// chars of s, with a reference count of 1.
+//
+char* rstr_new(const char* s, int length);
+
+//
+// rstr_from
+//
+// Returns a new rstring holding a copy of the given C string,
+// with a reference count of 1.
+//
+char* rstr_from(const char* s);
+
+//
+// rstr_concat
+//
+// Returns a new rstring holding lhs followed by rhs, with a
+// reference count of 1. The lengths of lhs and rhs are given
+// by the caller, so neither needs to be an rstring.
+//
+char* rstr_concat(const char* lhs, int length_lhs, const char* rhs, int length_rhs);
+
+//
+// rstr_append
+//
+// Appends the first length chars of tail to s, and returns the
+// result. The caller's reference to s is consumed, and the caller
+// owns a reference to the result instead. If s has no other
+// references it is extended in place (amortized O(1) per append),
+// so the result may be s itself, or s moved by realloc; otherwise
+// s is left unchanged and a new string is returned.
+//
+// NOTE: tail must not point into s. If tail may be s, retain tail
+// first, so that s is shared and is not modified.
+//
+char* rstr_append(char* s, const char* tail, int length);
+
+//
+// rstr_retain
+//
+// Adds a reference to the given rstring, and returns it.
+//
+char* rstr_retain(char* s);
+
+//
+// rstr_release
+//
+// Drops a reference to the given rstring, freeing the string
+// when the last reference is dropped. NULL is ignored.
+//
+void rstr_release(char* s);
+
+//
+// rstr_length
+//
+// Returns the length of the given rstring in O(1) time.
+//
+int rstr_length(const char* s);
@@ -0,0 +1,176 @@
+/*scanbench.c*/
+
+//
+// Scanner microbenchmark for nuPython: writes a large, synthetic
+// nuPython program to a temporary file, and reports how fast it is
+// scanned --- in MB/s --- by the original scanner (scanner_nextToken,
+// a character at a time) and by the lexer with each of its kernels
+// the CPU supports (see lexer.h).
+//
+// usage: make scanbench [mb=N]
+//        ./scanbench [N]       (N MB of source, 64 by default)
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>     // clock
+
+#include "token.h"
+#include "scanner.h"
+#include "lexer.h"
+
+
+#define ROUNDS 3  // the best of 3 is reported
+
+
+//
+// write_program
+//
+// Writes about the given # of bytes of nuPython to the given file:
+// indented statements, long names, comments, and string literals,
+// the runs the lexer's kernels skip.
+//
+static long write_program(FILE* output, long size)
+{
+  long written = 0;
+
+  for (int i = 0; written < size; i++) {
+    int n = 0;
+    switch (i % 4) {
+      case 0:
+        n = fprintf(output, "running_total_of_values_%d = previous_total_of_values + value_%d * 3.25\n", i % 97, i % 13);
+        break;
+      case 1:
+        n = fprintf(output, "        # the value is scaled before it is added to the running total, line %d\n", i);
+        break;
+      case 2:
+        n = fprintf(output, "message = 'a fairly long string literal, as generated programs have: %d'\n", i);
+        break;
+      default:
+        n = fprintf(output, "    while counter_%d <= limit_of_counter:    print(\"counter\", counter_%d)\n", i % 7, i % 7);
+        break;
+    }
+    written += n;
+  }
+  return written;
+}
+
+//
+// seconds
+//
+// Returns the processor time used so far, in seconds.
+//
+static double seconds(void)
+{
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+//
+// scan_original
+//
+// Scans the file with scanner_nextToken; returns the # of tokens.
+//
+static long scan_original(FILE* input)
+{
+  int line, col;
+  char value[256];
+  long count = 0;
+
+  rewind(input);
+  scanner_init(&line, &col, value);
+
+  struct Token token;
+  do {
+    token = scanner_nextToken(input, &line, &col, value);
+    count++;
+  } while (token.id != nuPy_EOS);
+
+  return count;
+}
+
+//
+// scan_lexer
+//
+// Scans the file with the lexer; returns the # of tokens.
+//
+static long scan_lexer(FILE* input)
+{
+  const char* value;
+  size_t length;
+  long count = 0;
+
+  rewind(input);
+  struct LEXER* lexer = lexer_open(input);
+
+  struct Token token;
+  do {
+    token = lexer_next(lexer, &value, &length);
+    count++;
+  } while (token.id != nuPy_EOS);
+
+  lexer_close(lexer);
+  return count;
+}
+
+//
+// report
+//
+// Times the given scan of the file, and outputs its speed.
+//
+static void report(char* name, long (*scan)(FILE*), FILE* input, long size)
+{
+  double best = 0.0;
+  long count = 0;
+
+  for (int round = 0; round < ROUNDS; round++) {
+    double start = seconds();
+    count = scan(input);
+    double elapsed = seconds() - start;
+
+    if (round == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  if (best <= 0.0)
+    best = 1.0 / CLOCKS_PER_SEC;
+
+  printf("%-22s %10.1f MB/s  (%ld tokens, %.3f secs)\n", name, size / (1024.0 * 1024.0) / best, count, best);
+}
+
+//
+// main
+//
+int main(int argc, char* argv[])
+{
+  long mb = (argc > 1) ? atol(argv[1]) : 64;
+  if (mb <= 0)
+    mb = 64;
+
+  FILE* input = tmpfile();
+  if (input == NULL) {
+    printf("**ERROR: unable to create a temporary file.\n");
+    return 0;
+  }
+
+  long size = write_program(input, mb * 1024 * 1024);
+  fflush(input);
+
+  printf("**scanning %.1f MB of nuPython, best of %d...\n", size / (1024.0 * 1024.0), ROUNDS);
+
+  report("scanner_nextToken", scan_original, input, size);
+
+  char* names[] = { "lexer, scalar", "lexer, SSE2", "lexer, AVX2" };
+
+  for (int kernels = LEXER_SCALAR; kernels <= LEXER_AVX2; kernels++) {
+    if (lexer_kernels(kernels) != kernels)  // not supported by the CPU
+      break;
+    report(names[kernels], scan_lexer, input, size);
+  }
+
+  fclose(input);
+  return 0;
+}
@@ -0,0 +1,23 @@
+#
+# loop body that never runs --- semantic error after it
+#
+print("starting")
+
+x = 1
+
+while x < 0:
+{
+    #
+    # never runs, so this is not an error (-check doesn't report it):
+    #
+    print(zz)
+}
+
+print("the loop is done")
+
+#
+# always runs, so -check reports this one up front:
+#
+print(ww)
+
+print("you should not see this")
@@ -0,0 +1,14 @@
+#
+# integer modulo by zero --- semantic error
+#
+print("starting")
+
+x = 17
+y = 5
+z = x % y
+print(z)
+
+y = 0
+z = x % y
+
+print("you should not see this")
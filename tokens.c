@@ -0,0 +1,256 @@
+/*tokens.c*/
+
+//
+// Token array for nuPython (see tokens.h). Values are interned in an
+// open-addressing hash table (linear probing) over the strings buffer,
+// which holds each distinct value once, back to back --- so growing
+// the table just re-walks the buffer. The values come from the lexer
+// as slices of the source, and are copied only the first time they
+// are seen.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>   // uint32_t
+
+#include "token.h"
+#include "lexer.h"
+#include "tokens.h"
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**TOKENS ERROR\n");
+  printf("**TOKENS ERROR: %s\n", msg);
+  printf("**TOKENS ERROR\n");
+
+  exit(-123);
+}
+
+//
+// hash_value
+//
+// Returns the FNV-1a hash of the given value, of the given length.
+//
+static uint32_t hash_value(const char* value, size_t length)
+{
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)value[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+//
+// find_bucket
+//
+// Returns the hash table bucket holding the given value, or the empty
+// bucket where it belongs.
+//
+static uint32_t find_bucket(struct TOKENS* tokens, const char* value, size_t length)
+{
+  uint32_t mask = tokens->table_size - 1;
+  uint32_t bucket = hash_value(value, length) & mask;
+
+  while (tokens->table[bucket] != 0) {
+    char* other = tokens->strings + tokens->table[bucket] - 1;
+    if (strncmp(other, value, length) == 0 && other[length] == '\0')
+      break;
+    bucket = (bucket + 1) & mask;
+  }
+  return bucket;
+}
+
+//
+// grow_table
+//
+// Doubles the size of the hash table and re-inserts every value.
+//
+static void grow_table(struct TOKENS* tokens)
+{
+  free(tokens->table);
+
+  tokens->table_size *= 2;
+  tokens->table = (uint32_t*)calloc(tokens->table_size, sizeof(uint32_t));
+  if (tokens->table == NULL)
+    panic("out of memory (grow_table)");
+
+  uint32_t offset = 0;
+  while (offset < tokens->strings_size) {
+    char* value = tokens->strings + offset;
+    size_t length = strlen(value);
+    tokens->table[find_bucket(tokens, value, length)] = offset + 1;
+    offset += (uint32_t)length + 1;
+  }
+}
+
+//
+// intern
+//
+// Returns the offset of the given value, of the given length, in the
+// strings, adding it (with a '\0') if it has not been seen before.
+//
+static uint32_t intern(struct TOKENS* tokens, const char* value, size_t length)
+{
+  uint32_t bucket = find_bucket(tokens, value, length);
+  if (tokens->table[bucket] != 0)
+    return tokens->table[bucket] - 1;
+
+  while (tokens->strings_size + length + 1 > tokens->strings_capacity) {
+    tokens->strings_capacity *= 2;
+    tokens->strings = (char*)realloc(tokens->strings, tokens->strings_capacity);
+    if (tokens->strings == NULL)
+      panic("out of memory (intern)");
+  }
+
+  uint32_t offset = tokens->strings_size;
+  memcpy(tokens->strings + offset, value, length);
+  tokens->strings[offset + length] = '\0';
+  tokens->strings_size += (uint32_t)length + 1;
+
+  tokens->table[bucket] = offset + 1;
+  tokens->num_values++;
+
+  if (tokens->num_values * 2 > tokens->table_size) // keep the load factor <= 1/2
+    grow_table(tokens);
+
+  return offset;
+}
+
+//
+// append
+//
+// Adds a token, with the given value, to the end of the array.
+//
+static void append(struct TOKENS* tokens, struct Token token, const char* value, size_t length)
+{
+  if (tokens->count == tokens->capacity) {
+    tokens->capacity *= 2;
+    tokens->entries = (struct TOKEN_ENTRY*)realloc(tokens->entries, tokens->capacity * sizeof(struct TOKEN_ENTRY));
+    if (tokens->entries == NULL)
+      panic("out of memory (append)");
+  }
+
+  struct TOKEN_ENTRY* entry = &tokens->entries[tokens->count];
+  entry->token = token;
+  entry->value = intern(tokens, value, length);
+  tokens->count++;
+}
+
+//
+// tokens_scan
+//
+// Uses the lexer to read the given input stream up to and including
+// the end of the stream ($ or EOF, along with the rest of the $ line),
+// and returns the array of tokens with the cursor on the first. The
+// caller frees it with tokens_destroy.
+//
+struct TOKENS* tokens_scan(FILE* input)
+{
+  struct TOKENS* tokens = (struct TOKENS*)malloc(sizeof(struct TOKENS));
+  if (tokens == NULL)
+    panic("out of memory (tokens_scan)");
+
+  tokens->count = 0;
+  tokens->capacity = 256;
+  tokens->cursor = 0;
+  tokens->entries = (struct TOKEN_ENTRY*)malloc(tokens->capacity * sizeof(struct TOKEN_ENTRY));
+
+  tokens->strings_size = 0;
+  tokens->strings_capacity = 1024;
+  tokens->strings = (char*)malloc(tokens->strings_capacity);
+
+  tokens->num_values = 0;
+  tokens->table_size = 64;
+  tokens->table = (uint32_t*)calloc(tokens->table_size, sizeof(uint32_t));
+
+  if (tokens->entries == NULL || tokens->strings == NULL || tokens->table == NULL)
+    panic("out of memory (tokens_scan)");
+
+  struct LEXER* lexer = lexer_open(input);
+  const char* value;
+  size_t length;
+
+  struct Token token;
+  do {
+    token = lexer_next(lexer, &value, &length);
+    append(tokens, token, value, length);
+  } while (token.id != nuPy_EOS);
+
+  lexer_close(lexer);
+
+  return tokens;
+}
+
+//
+// tokens_peek / tokens_peek2
+//
+// Returns the current token, or the one after it; at the end of the
+// array the EOS token is returned.
+//
+struct Token tokens_peek(struct TOKENS* tokens)
+{
+  return tokens->entries[tokens->cursor].token;
+}
+
+struct Token tokens_peek2(struct TOKENS* tokens)
+{
+  int next = (tokens->cursor + 1 < tokens->count) ? tokens->cursor + 1 : tokens->cursor;
+  return tokens->entries[next].token;
+}
+
+//
+// tokens_value / tokens_value2
+//
+// Returns the string value of the current token, or the one after it.
+// The value lives as long as the array.
+//
+char* tokens_value(struct TOKENS* tokens)
+{
+  return tokens->strings + tokens->entries[tokens->cursor].value;
+}
+
+char* tokens_value2(struct TOKENS* tokens)
+{
+  int next = (tokens->cursor + 1 < tokens->count) ? tokens->cursor + 1 : tokens->cursor;
+  return tokens->strings + tokens->entries[next].value;
+}
+
+//
+// tokens_advance
+//
+// Moves the cursor on to the next token; stays on EOS at the end.
+//
+void tokens_advance(struct TOKENS* tokens)
+{
+  if (tokens->cursor + 1 < tokens->count)
+    tokens->cursor++;
+}
+
+//
+// tokens_destroy
+//
+// Frees the array and all the token values.
+//
+void tokens_destroy(struct TOKENS* tokens)
+{
+  if (tokens == NULL)
+    return;
+
+  free(tokens->entries);
+  free(tokens->strings);
+  free(tokens->table);
+  free(tokens);
+}
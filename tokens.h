@@ -0,0 +1,91 @@
+/*tokens.h*/
+
+//
+// Token array for nuPython: every token of the input, scanned up front
+// into one growable array, with each token's string value interned in
+// a single buffer (identifiers such as x or print repeat a lot, and are
+// stored once). The parser and the program graph builder walk the array
+// with a cursor, so the tokens are neither copied nor freed one by one
+// --- tokens_destroy frees all of it.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>   // uint32_t
+
+#include "token.h"
+
+
+struct TOKEN_ENTRY
+{
+  struct Token token;
+  uint32_t value;       // offset of the token's value in the strings
+};
+
+struct TOKENS
+{
+  struct TOKEN_ENTRY* entries;  // the last one is always EOS
+  int count;
+  int capacity;
+  int cursor;                   // index of the current token
+
+  char* strings;                // every distinct value, each ending in '\0'
+  uint32_t strings_size;
+  uint32_t strings_capacity;
+
+  uint32_t* table;              // hash table of value offset+1, 0 => empty
+  uint32_t table_size;          // always a power of 2
+  uint32_t num_values;          // # of distinct values
+};
+
+
+//
+// Public functions:
+//
+
+//
+// tokens_scan
+//
+// Uses the lexer to read the given input stream up to and including
+// the end of the stream ($ or EOF, along with the rest of the $ line),
+// and returns the array of tokens with the cursor on the first. The
+// caller frees it with tokens_destroy.
+//
+struct TOKENS* tokens_scan(FILE* input);
+
+//
+// tokens_peek / tokens_peek2
+//
+// Returns the current token, or the one after it; at the end of the
+// array the EOS token is returned.
+//
+struct Token tokens_peek(struct TOKENS* tokens);
+struct Token tokens_peek2(struct TOKENS* tokens);
+
+//
+// tokens_value / tokens_value2
+//
+// Returns the string value of the current token, or the one after it.
+// The value lives as long as the array.
+//
+char* tokens_value(struct TOKENS* tokens);
+char* tokens_value2(struct TOKENS* tokens);
+
+//
+// tokens_advance
+//
+// Moves the cursor on to the next token; stays on EOS at the end.
+//
+void tokens_advance(struct TOKENS* tokens);
+
+//
+// tokens_destroy
+//
+// Frees the array and all the token values.
+//
+void tokens_destroy(struct TOKENS* tokens);
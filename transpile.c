@@ -0,0 +1,1361 @@
+/*transpile.c*/
+
+//
+// nuPython to C compiler (see transpile.h).
+//
+// Before any code is written, the types each variable can hold are
+// inferred from its assignments, by iterating over the program until
+// nothing changes. A variable with exactly one type, int, real or
+// boolean, becomes a C local, v_<slot>, along with a flag d_<slot>
+// that is set once it is defined; the flag is only tested where the
+// variable is not certain to be defined already. Every other variable
+// is kept in memory, by slot, like the VM does.
+//
+// A local gets its memory cell the first time it is written, so the
+// cells are in the same order as in the VM, and its final value is
+// written to the cell when the program ends. Nothing reads a local's
+// cell before then: programs with pointers have no locals at all, and
+// int() and float() only ever read variables in memory.
+//
+// Each statement becomes a block of C; a semantic error outputs its
+// message and jumps to the end of the program, which then outputs
+// **done and the memory, as main.c does for the VM.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>   // INT_MIN
+#include <math.h>     // isinf
+
+#include "programgraph.h"
+#include "resolve.h"
+#include "transpile.h"
+
+
+//
+// Sets of types a variable or expression can have:
+//
+#define TYPE_INT   0x01
+#define TYPE_REAL  0x02
+#define TYPE_STR   0x04
+#define TYPE_PTR   0x08
+#define TYPE_BOOL  0x10
+#define TYPE_NONE  0x20
+#define TYPE_ANY   0x3F
+
+//
+// How an operand is accessed by the generated code:
+//
+enum OPERAND_KINDS
+{
+  KIND_CONST = 0,  // literal, type says which
+  KIND_LOCAL,      // typed local, type says which
+  KIND_VAR,        // variable in memory
+  KIND_DEREF,      // *var
+  KIND_ADDR        // &var
+};
+
+struct OPERAND
+{
+  int kind;     // enum OPERAND_KINDS
+  int type;     // TYPE_ of a constant or local
+  int slot;     // variable
+  int i;        // int / boolean constant
+  double d;     // real constant
+  int string;   // index of a str constant in the strings table
+};
+
+//
+// Where the value of an expression goes:
+//
+enum SINKS
+{
+  SINK_VAR = 0,   // variable in the slot
+  SINK_CELL,      // memory cell whose address is in target, for *p = ...
+  SINK_CONDITION  // C bool cond, for while loops
+};
+
+//
+// The state of the compiler:
+//
+struct TRANSPILER
+{
+  FILE* out;              // the code for main, written out last
+  struct SYMTAB* symbols;
+
+  int* types;     // slot -> TYPE_ set of the values it can hold
+  int* locals;    // slot -> TYPE_ of its C local, 0 => kept in memory
+  bool* defined;  // slot -> true => certain to be defined here
+  int num_slots;  // # of slots the arrays above have room for
+
+  bool pointers;  // true => the program uses & or *
+
+  char** strings;   // str constants, by index
+  int num_strings;
+  int string_capacity;
+
+  int indent;
+};
+
+//
+// The runtime for values kept in memory, which follows vm.c:
+//
+static const char* prelude[] = {
+  "enum RT_OPERATORS",
+  "{",
+  "  RT_ADD = 0, RT_SUB, RT_MUL, RT_POW, RT_MOD, RT_DIV,",
+  "  RT_EQ, RT_NE, RT_LT, RT_LTE, RT_GT, RT_GTE, RT_IS, RT_IN",
+  "};",
+  "",
+  "#define RT_VAR   0",
+  "#define RT_DEREF 1",
+  "#define RT_ADDR  2",
+  "",
+  "static struct RAM* memory;",
+  "",
+  "static struct RAM_VALUE rt_value(int type, int i)",
+  "{",
+  "  struct RAM_VALUE value;",
+  "  value.value_type = type;",
+  "  value.types.i = i;",
+  "  return value;",
+  "}",
+  "",
+  "static struct RAM_VALUE rt_int(int i) { return rt_value(RAM_TYPE_INT, i); }",
+  "static struct RAM_VALUE rt_bool(int i) { return rt_value(RAM_TYPE_BOOLEAN, i); }",
+  "static struct RAM_VALUE rt_none(void) { return rt_value(RAM_TYPE_NONE, 0); }",
+  "",
+  "static struct RAM_VALUE rt_real(double d)",
+  "{",
+  "  struct RAM_VALUE value;",
+  "  value.value_type = RAM_TYPE_REAL;",
+  "  value.types.d = d;",
+  "  return value;",
+  "}",
+  "",
+  "static struct RAM_VALUE rt_str(char* s)",
+  "{",
+  "  struct RAM_VALUE value;",
+  "  value.value_type = RAM_TYPE_STR;",
+  "  value.types.s = s;",
+  "  return value;",
+  "}",
+  "",
+  "static void rt_error(const char* msg, int line)",
+  "{",
+  "  printf(\"**SEMANTIC ERROR: %s (line %d)\\n\", msg, line);",
+  "}",
+  "",
+  "static int rt_address(int slot)",
+  "{",
+  "  if (addresses[slot] < 0)",
+  "    addresses[slot] = ram_get_addr(memory, names[slot]);",
+  "  return addresses[slot];",
+  "}",
+  "",
+  "static bool rt_defined(bool defined, int slot, int line)",
+  "{",
+  "  if (!defined)",
+  "    printf(\"**SEMANTIC ERROR: name '%s' is not defined (line %d)\\n\", names[slot], line);",
+  "  return defined;",
+  "}",
+  "",
+  "static bool rt_fetch(int kind, int slot, int line, struct RAM_VALUE* value)",
+  "{",
+  "  int address = rt_address(slot);",
+  "",
+  "  if (kind == RT_ADDR) {",
+  "    if (address == -1) {",
+  "      printf(\"**SEMANTIC ERROR: name '%s' is not defined (line '%d')\\n\", names[slot], line);",
+  "      return false;",
+  "    }",
+  "    *value = rt_value(RAM_TYPE_PTR, address);",
+  "    return true;",
+  "  }",
+  "  if (!rt_defined(address != -1, slot, line))",
+  "    return false;",
+  "",
+  "  const struct RAM_VALUE* cell = ram_peek_cell_by_addr(memory, address);",
+  "  if (kind == RT_DEREF) {",
+  "    if (cell->value_type != RAM_TYPE_PTR) {",
+  "      rt_error(\"invalid operand types\", line);",
+  "      return false;",
+  "    }",
+  "    cell = ram_peek_cell_by_addr(memory, cell->types.i);",
+  "    if (cell == NULL) {",
+  "      printf(\"**SEMANTIC ERROR: '%s' contains invalid address (line %d)\\n\", names[slot], line);",
+  "      return false;",
+  "    }",
+  "  }",
+  "  *value = *cell;",
+  "  return true;",
+  "}",
+  "",
+  "static void rt_store_cell(int address, struct RAM_VALUE value, bool owned)",
+  "{",
+  "  ram_share_cell_by_addr(memory, value, address);",
+  "  if (owned && value.value_type == RAM_TYPE_STR)",
+  "    rstr_release(value.types.s);",
+  "}",
+  "",
+  "static void rt_store(int slot, struct RAM_VALUE value, bool owned)",
+  "{",
+  "  int address = rt_address(slot);",
+  "",
+  "  if (address >= 0) {",
+  "    rt_store_cell(address, value, owned);",
+  "    return;",
+  "  }",
+  "  ram_share_cell_by_name(memory, value, names[slot]);",
+  "  addresses[slot] = ram_get_addr(memory, names[slot]);",
+  "  if (owned && value.value_type == RAM_TYPE_STR)",
+  "    rstr_release(value.types.s);",
+  "}",
+  "",
+  "static void rt_release(struct RAM_VALUE* value)",
+  "{",
+  "  if (value->value_type == RAM_TYPE_STR)",
+  "    rstr_release(value->types.s);",
+  "}",
+  "",
+  "static bool rt_int_op(int op, int lhs, int rhs, struct RAM_VALUE* result, int line)",
+  "{",
+  "  result->value_type = RAM_TYPE_INT;",
+  "",
+  "  switch (op) {",
+  "  case RT_ADD: result->types.i = lhs + rhs; return true;",
+  "  case RT_SUB: result->types.i = lhs - rhs; return true;",
+  "  case RT_MUL: result->types.i = lhs * rhs; return true;",
+  "  case RT_POW: result->types.i = (int)pow(lhs, rhs); return true;",
+  "  case RT_MOD:",
+  "    if (rhs == 0) {",
+  "      rt_error(\"ZeroDivisionError: integer modulo by zero\", line);",
+  "      return false;",
+  "    }",
+  "    result->types.i = lhs % rhs;",
+  "    return true;",
+  "  case RT_DIV:",
+  "    if (rhs == 0) {",
+  "      rt_error(\"ZeroDivisionError: division by zero\", line);",
+  "      return false;",
+  "    }",
+  "    result->types.i = lhs / rhs;",
+  "    return true;",
+  "  case RT_EQ: *result = rt_bool(lhs == rhs); return true;",
+  "  case RT_NE: *result = rt_bool(lhs != rhs); return true;",
+  "  case RT_LT: *result = rt_bool(lhs < rhs); return true;",
+  "  case RT_LTE: *result = rt_bool(lhs <= rhs); return true;",
+  "  case RT_GT: *result = rt_bool(lhs > rhs); return true;",
+  "  case RT_GTE: *result = rt_bool(lhs >= rhs); return true;",
+  "  default:",
+  "    rt_error(\"invalid operand types\", line);",
+  "    return false;",
+  "  }",
+  "}",
+  "",
+  "static bool rt_real_op(int op, double lhs, double rhs, struct RAM_VALUE* result, int line)",
+  "{",
+  "  switch (op) {",
+  "  case RT_ADD: *result = rt_real(lhs + rhs); return true;",
+  "  case RT_SUB: *result = rt_real(lhs - rhs); return true;",
+  "  case RT_MUL: *result = rt_real(lhs * rhs); return true;",
+  "  case RT_POW: *result = rt_real(pow(lhs, rhs)); return true;",
+  "  case RT_MOD: *result = rt_real(fmod(lhs, rhs)); return true;",
+  "  case RT_DIV:",
+  "    if (rhs == 0.0) {",
+  "      rt_error(\"ZeroDivisionError: division by zero\", line);",
+  "      return false;",
+  "    }",
+  "    *result = rt_real(lhs / rhs);",
+  "    return true;",
+  "  case RT_EQ: *result = rt_bool(lhs == rhs); return true;",
+  "  case RT_NE: *result = rt_bool(lhs != rhs); return true;",
+  "  case RT_LT: *result = rt_bool(lhs < rhs); return true;",
+  "  case RT_LTE: *result = rt_bool(lhs <= rhs); return true;",
+  "  case RT_GT: *result = rt_bool(lhs > rhs); return true;",
+  "  case RT_GTE: *result = rt_bool(lhs >= rhs); return true;",
+  "  default:",
+  "    rt_error(\"invalid operand types\", line);",
+  "    return false;",
+  "  }",
+  "}",
+  "",
+  "static bool rt_str_op(int op, char* lhs, char* rhs, struct RAM_VALUE* result, int line)",
+  "{",
+  "  if (op == RT_ADD) {",
+  "    *result = rt_str(rstr_concat(lhs, rstr_length(lhs), rhs, rstr_length(rhs)));",
+  "    return true;",
+  "  }",
+  "",
+  "  int str_comp = strcmp(lhs, rhs);",
+  "  switch (op) {",
+  "  case RT_EQ: *result = rt_bool(str_comp == 0); return true;",
+  "  case RT_NE: *result = rt_bool(str_comp != 0); return true;",
+  "  case RT_LT: *result = rt_bool(str_comp < 0); return true;",
+  "  case RT_LTE: *result = rt_bool(str_comp <= 0); return true;",
+  "  case RT_GT: *result = rt_bool(str_comp > 0); return true;",
+  "  case RT_GTE: *result = rt_bool(str_comp >= 0); return true;",
+  "  default:",
+  "    rt_error(\"invalid operand types\", line);",
+  "    return false;",
+  "  }",
+  "}",
+  "",
+  "static bool rt_binary(int op, struct RAM_VALUE* lhs, struct RAM_VALUE* rhs, struct RAM_VALUE* result, int line)",
+  "{",
+  "  int type_lhs = lhs->value_type;",
+  "  int type_rhs = rhs->value_type;",
+  "",
+  "  if (type_lhs == RAM_TYPE_INT && type_rhs == RAM_TYPE_INT)",
+  "    return rt_int_op(op, lhs->types.i, rhs->types.i, result, line);",
+  "",
+  "  if ((type_lhs == RAM_TYPE_INT || type_lhs == RAM_TYPE_REAL) && (type_rhs == RAM_TYPE_INT || type_rhs == RAM_TYPE_REAL)) {",
+  "    double lhs_real = (type_lhs == RAM_TYPE_INT) ? (double)lhs->types.i : lhs->types.d;",
+  "    double rhs_real = (type_rhs == RAM_TYPE_INT) ? (double)rhs->types.i : rhs->types.d;",
+  "    return rt_real_op(op, lhs_real, rhs_real, result, line);",
+  "  }",
+  "",
+  "  if (type_lhs == RAM_TYPE_STR && type_rhs == RAM_TYPE_STR)",
+  "    return rt_str_op(op, lhs->types.s, rhs->types.s, result, line);",
+  "",
+  "  if (type_lhs == RAM_TYPE_PTR && type_rhs == RAM_TYPE_INT) {",
+  "    if (!rt_int_op(op, lhs->types.i, rhs->types.i, result, line))",
+  "      return false;",
+  "    result->value_type = RAM_TYPE_PTR;",
+  "    return true;",
+  "  }",
+  "",
+  "  rt_error(\"invalid operand types\", line);",
+  "  return false;",
+  "}",
+  "",
+  "static bool rt_append(int slot, struct RAM_VALUE* lhs, struct RAM_VALUE* rhs, int line)",
+  "{",
+  "  if (lhs->value_type == RAM_TYPE_STR && rhs->value_type == RAM_TYPE_STR) {",
+  "    char* tail = rstr_retain(rhs->types.s);  // it may be the string appended to",
+  "    ram_append_cell_by_addr(memory, tail, rstr_length(tail), rt_address(slot));",
+  "    rstr_release(tail);",
+  "    return true;",
+  "  }",
+  "",
+  "  struct RAM_VALUE result;",
+  "  if (!rt_binary(RT_ADD, lhs, rhs, &result, line))",
+  "    return false;",
+  "  rt_store(slot, result, true);",
+  "  return true;",
+  "}",
+  "",
+  "static bool rt_true(struct RAM_VALUE* value)",
+  "{",
+  "  return (value->value_type == RAM_TYPE_BOOLEAN || value->value_type == RAM_TYPE_INT) && value->types.i != 0;",
+  "}",
+  "",
+  "static void rt_print(struct RAM_VALUE* value)",
+  "{",
+  "  int type = value->value_type;",
+  "",
+  "  if (type == RAM_TYPE_INT || type == RAM_TYPE_PTR)",
+  "    printf(\"%d\\n\", value->types.i);",
+  "  else if (type == RAM_TYPE_REAL)",
+  "    printf(\"%f\\n\", value->types.d);",
+  "  else if (type == RAM_TYPE_STR)",
+  "    printf(\"%s\\n\", value->types.s);",
+  "  else if (type == RAM_TYPE_BOOLEAN)",
+  "    printf(\"%s\\n\", (value->types.i == 1) ? \"True\" : \"False\");",
+  "}",
+  "",
+  "static void rt_input(char* prompt, struct RAM_VALUE* result)",
+  "{",
+  "  if (prompt != NULL)",
+  "    printf(\"%s\", prompt);",
+  "",
+  "  char line[256];",
+  "  if (fgets(line, sizeof(line), stdin) == NULL)",
+  "    line[0] = '\\0';",
+  "  line[strcspn(line, \"\\r\\n\")] = '\\0';",
+  "",
+  "  *result = rt_str(rstr_from(line));",
+  "}",
+  "",
+  "static bool rt_convert(bool to_int, struct RAM_VALUE* value, struct RAM_VALUE* result, int line)",
+  "{",
+  "  char* function = to_int ? \"int\" : \"float\";",
+  "",
+  "  if (value->value_type != RAM_TYPE_STR) {",
+  "    printf(\"**SEMANTIC ERROR: invalid string for %s() (line %d)\\n\", function, line);",
+  "    return false;",
+  "  }",
+  "",
+  "  char* s = value->types.s;",
+  "  if (to_int) {",
+  "    int num = atoi(s);",
+  "    if (num == 0 && !(strspn(s, \"0\") == strlen(s))) {",
+  "      rt_error(\"invalid string for int()\", line);",
+  "      return false;",
+  "    }",
+  "    *result = rt_int(num);",
+  "  } else {",
+  "    double num = atof(s);",
+  "    if (num == 0.0 && !(strspn(s, \"0.\") == strlen(s))) {",
+  "      rt_error(\"invalid string for float()\", line);",
+  "      return false;",
+  "    }",
+  "    *result = rt_real(num);",
+  "  }",
+  "  return true;",
+  "}",
+  "",
+  "static bool rt_deref_target(int slot, int line, int* address)",
+  "{",
+  "  int pointer_address = rt_address(slot);",
+  "  if (!rt_defined(pointer_address != -1, slot, line))",
+  "    return false;",
+  "",
+  "  const struct RAM_VALUE* cell = ram_peek_cell_by_addr(memory, pointer_address);",
+  "  if (cell->value_type != RAM_TYPE_PTR) {",
+  "    rt_error(\"invalid operand types\", line);",
+  "    return false;",
+  "  }",
+  "  *address = cell->types.i;",
+  "",
+  "  if (ram_peek_cell_by_addr(memory, *address) == NULL) {",
+  "    printf(\"**SEMANTIC ERROR: '%s' contains invalid address (line %d)\\n\", names[slot], line);",
+  "    return false;",
+  "  }",
+  "  return true;",
+  "}",
+  NULL
+};
+
+//
+// C names for the operators, by enum OPERATORS:
+//
+static const char* rt_operators[] = {
+  "RT_ADD", "RT_SUB", "RT_MUL", "RT_POW", "RT_MOD", "RT_DIV",
+  "RT_EQ", "RT_NE", "RT_LT", "RT_LTE", "RT_GT", "RT_GTE", "RT_IS", "RT_IN"
+};
+
+
+//
+// panic
+//
+// Outputs the given error message and exits the program.
+//
+static void panic(char* msg)
+{
+  printf("**TRANSPILE ERROR\n");
+  printf("**TRANSPILE ERROR: %s\n", msg);
+  printf("**TRANSPILE ERROR\n");
+
+  exit(-123);
+}
+
+//
+// line_out
+//
+// Outputs one line of C, indented, with printf-style formatting.
+//
+static void line_out(struct TRANSPILER* t, const char* format, ...)
+{
+  va_list args;
+
+  fprintf(t->out, "%*s", 2 * t->indent, "");
+  va_start(args, format);
+  vfprintf(t->out, format, args);
+  va_end(args);
+  fprintf(t->out, "\n");
+}
+
+//
+// string_literal
+//
+// Outputs s as a C string literal. Everything but printable ASCII is
+// written in octal, so no escape can run into the next char.
+//
+static void string_literal(FILE* out, const char* s)
+{
+  fputc('"', out);
+  for (const unsigned char* p = (const unsigned char*)s; *p != '\0'; p++) {
+    if (*p == '"' || *p == '\\')
+      fprintf(out, "\\%c", *p);
+    else if (*p < ' ' || *p > '~')
+      fprintf(out, "\\%03o", *p);
+    else
+      fputc(*p, out);
+  }
+  fputc('"', out);
+}
+
+//
+// reserve_slots
+//
+// Makes room in the per-slot arrays for slots 0..slot, all new slots
+// have no types, are kept in memory, and are not defined.
+//
+static void reserve_slots(struct TRANSPILER* t, int slot)
+{
+  if (slot >= t->num_slots) {
+    int n = 2 * slot + 1;
+    t->types = (int*)realloc(t->types, n * sizeof(int));
+    t->locals = (int*)realloc(t->locals, n * sizeof(int));
+    t->defined = (bool*)realloc(t->defined, n * sizeof(bool));
+    if (t->types == NULL || t->locals == NULL || t->defined == NULL)
+      panic("out of memory (slot_of)");
+    for (int i = t->num_slots; i < n; i++) {
+      t->types[i] = 0;
+      t->locals[i] = 0;
+      t->defined[i] = false;
+    }
+    t->num_slots = n;
+  }
+}
+
+//
+// slot_of
+//
+// Returns the slot of the given variable, making room for it in the
+// per-slot arrays if it is new.
+//
+static int slot_of(struct TRANSPILER* t, char* name)
+{
+  int slot = symtab_slot(t->symbols, name);
+
+  reserve_slots(t, slot);
+  return slot;
+}
+
+//
+// add_string
+//
+// Adds a str constant to the strings table, returns its index.
+//
+static int add_string(struct TRANSPILER* t, char* s)
+{
+  if (t->num_strings == t->string_capacity) {
+    t->string_capacity = 2 * t->string_capacity + 4;
+    t->strings = (char**)realloc(t->strings, t->string_capacity * sizeof(char*));
+    if (t->strings == NULL)
+      panic("out of memory (add_string)");
+  }
+  t->strings[t->num_strings] = s;
+  t->num_strings++;
+  return t->num_strings - 1;
+}
+
+
+//
+// Type inference:
+//
+
+//
+// unary_types
+//
+// Returns the types a unary expression can have. In a binary
+// expression &x reads x itself, as in the executor.
+//
+static int unary_types(struct TRANSPILER* t, struct UNARY_EXPR* unary, bool binary_context)
+{
+  struct ELEMENT* element = unary->element;
+
+  switch (element->element_type) {
+  case ELEMENT_INT_LITERAL: return TYPE_INT;
+  case ELEMENT_REAL_LITERAL: return TYPE_REAL;
+  case ELEMENT_STR_LITERAL: return TYPE_STR;
+  case ELEMENT_TRUE: case ELEMENT_FALSE: return TYPE_BOOL;
+  case ELEMENT_IDENTIFIER: break;
+  default: return TYPE_NONE;
+  }
+
+  if (unary->expr_type == UNARY_PTR_DEREF)
+    return TYPE_ANY;
+  if (unary->expr_type == UNARY_ADDRESS_OF && !binary_context)
+    return TYPE_PTR;
+  return t->types[slot_of(t, element->element_value)];
+}
+
+//
+// binary_types
+//
+// Returns the types lhs <operator> rhs can have, for every pair of
+// types the operands can have that is not a semantic error.
+//
+static int binary_types(int operator, int lhs, int rhs)
+{
+  bool arithmetic = (operator >= OPERATOR_PLUS && operator <= OPERATOR_DIV);
+  bool relational = (operator >= OPERATOR_EQUAL && operator <= OPERATOR_GTE);
+  int result = 0;
+
+  if (!arithmetic && !relational)
+    return 0;
+
+  for (int l = TYPE_INT; l <= TYPE_NONE; l <<= 1) {
+    for (int r = TYPE_INT; r <= TYPE_NONE; r <<= 1) {
+      if (!(lhs & l) || !(rhs & r))
+        continue;
+      if (((l | r) & ~(TYPE_INT | TYPE_REAL)) == 0)  // int-int, real-real, int-real
+        result |= relational ? TYPE_BOOL : ((l == TYPE_INT && r == TYPE_INT) ? TYPE_INT : TYPE_REAL);
+      else if (l == TYPE_STR && r == TYPE_STR && (relational || operator == OPERATOR_PLUS))
+        result |= relational ? TYPE_BOOL : TYPE_STR;
+      else if (l == TYPE_PTR && r == TYPE_INT)  // pointer arithmetic, always a pointer
+        result |= TYPE_PTR;
+    }
+  }
+  return result;
+}
+
+//
+// value_types
+//
+// Returns the types the right-hand side of an assignment can have.
+//
+static int value_types(struct TRANSPILER* t, struct VALUE* value)
+{
+  if (value->value_type == VALUE_FUNCTION_CALL) {
+    struct FUNCTION_CALL* call = value->types.function_call;
+    if (call->parameter != NULL && call->parameter->element_type == ELEMENT_IDENTIFIER)
+      slot_of(t, call->parameter->element_value);
+    if (strcmp(call->function_name, "input") == 0)
+      return TYPE_STR;
+    if (strcmp(call->function_name, "int") == 0)
+      return TYPE_INT;
+    if (strcmp(call->function_name, "float") == 0)
+      return TYPE_REAL;
+    return 0;  // nothing is assigned
+  }
+
+  struct EXPR* expr = value->types.expr;
+  if (!expr->isBinaryExpr)
+    return unary_types(t, expr->lhs, false);
+  if (expr->rhs == NULL)
+    return 0;
+  return binary_types(expr->operator, unary_types(t, expr->lhs, true), unary_types(t, expr->rhs, true));
+}
+
+//
+// uses_pointers
+//
+// Returns true if the unary expression is &x or *x.
+//
+static bool uses_pointers(struct UNARY_EXPR* unary)
+{
+  return unary != NULL && (unary->expr_type == UNARY_ADDRESS_OF || unary->expr_type == UNARY_PTR_DEREF);
+}
+
+//
+// infer_stmts
+//
+// One pass of type inference over the statements from stmt until stop
+// (or the end of the program). Returns true if any variable gained a
+// type. Also finds whether the program uses pointers, and keeps the
+// parameters of int() and float() in memory.
+//
+static bool infer_stmts(struct TRANSPILER* t, struct STMT* stmt, struct STMT* stop)
+{
+  bool changed = false;
+
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+      struct VALUE* rhs = assignment->rhs;
+      int slot = slot_of(t, assignment->var_name);
+
+      if (rhs->value_type == VALUE_EXPR)
+        t->pointers |= uses_pointers(rhs->types.expr->lhs) || uses_pointers(rhs->types.expr->rhs);
+      else if (rhs->types.function_call->parameter != NULL && rhs->types.function_call->parameter->element_type == ELEMENT_IDENTIFIER)
+        t->locals[slot_of(t, rhs->types.function_call->parameter->element_value)] = -1;  // never a local
+      t->pointers |= assignment->isPtrDeref;
+
+      int types = value_types(t, rhs);
+      if (!assignment->isPtrDeref && (t->types[slot] | types) != t->types[slot]) {
+        t->types[slot] |= types;
+        changed = true;
+      }
+      stmt = assignment->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      struct ELEMENT* parameter = stmt->types.function_call->parameter;
+      if (parameter != NULL && parameter->element_type == ELEMENT_IDENTIFIER)
+        slot_of(t, parameter->element_value);
+      stmt = stmt->types.function_call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct EXPR* condition = stmt->types.while_loop->condition;
+      t->pointers |= uses_pointers(condition->lhs) || uses_pointers(condition->rhs);
+      unary_types(t, condition->lhs, condition->isBinaryExpr);
+      if (condition->isBinaryExpr && condition->rhs != NULL)
+        unary_types(t, condition->rhs, true);
+      changed |= infer_stmts(t, stmt->types.while_loop->loop_body, stmt);
+      stmt = stmt->types.while_loop->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_PASS) {
+      stmt = stmt->types.pass->next_stmt;
+    }
+    else {
+      return changed;  // if-then-else is rejected by programgraph_build
+    }
+  }
+  return changed;
+}
+
+//
+// choose_locals
+//
+// Decides which variables become typed C locals.
+//
+static void choose_locals(struct TRANSPILER* t)
+{
+  for (int slot = 0; slot < t->symbols->num_slots; slot++) {
+    int type = t->types[slot];
+    bool typed = (type == TYPE_INT || type == TYPE_REAL || type == TYPE_BOOL);
+    t->locals[slot] = (typed && t->locals[slot] == 0 && !t->pointers) ? type : 0;
+  }
+}
+
+
+//
+// Code generation:
+//
+
+//
+// make_operand
+//
+// Returns how the generated code gets at a unary expression.
+//
+static struct OPERAND make_operand(struct TRANSPILER* t, struct UNARY_EXPR* unary, bool binary_context)
+{
+  struct ELEMENT* element = unary->element;
+  struct OPERAND operand;
+
+  operand.kind = KIND_CONST;
+  operand.type = TYPE_NONE;
+  operand.slot = 0;
+  operand.i = 0;
+  operand.d = 0.0;
+  operand.string = 0;
+
+  switch (element->element_type) {
+  case ELEMENT_INT_LITERAL:
+    operand.type = TYPE_INT;
+    operand.i = atoi(element->element_value);
+    return operand;
+  case ELEMENT_REAL_LITERAL:
+    operand.type = TYPE_REAL;
+    operand.d = atof(element->element_value);
+    return operand;
+  case ELEMENT_STR_LITERAL:
+    operand.type = TYPE_STR;
+    operand.string = add_string(t, element->element_value);
+    return operand;
+  case ELEMENT_TRUE:
+  case ELEMENT_FALSE:
+    operand.type = TYPE_BOOL;
+    operand.i = (element->element_type == ELEMENT_TRUE);
+    return operand;
+  case ELEMENT_IDENTIFIER:
+    break;
+  default:
+    return operand;  // None
+  }
+
+  operand.slot = slot_of(t, element->element_value);
+  if (unary->expr_type == UNARY_PTR_DEREF)
+    operand.kind = KIND_DEREF;
+  else if (unary->expr_type == UNARY_ADDRESS_OF && !binary_context)
+    operand.kind = KIND_ADDR;
+  else if (t->locals[operand.slot] != 0) {
+    operand.kind = KIND_LOCAL;
+    operand.type = t->locals[operand.slot];
+  } else
+    operand.kind = KIND_VAR;
+  return operand;
+}
+
+//
+// is_number
+//
+// Returns true if the operand is an int or real whose type is known,
+// so the generated code can use it as a plain C value.
+//
+static bool is_number(struct OPERAND* operand)
+{
+  return (operand->kind == KIND_CONST || operand->kind == KIND_LOCAL) && (operand->type == TYPE_INT || operand->type == TYPE_REAL);
+}
+
+//
+// c_value
+//
+// Writes the C expression for a constant or local into buf. Reals are
+// written in hex, which is exact.
+//
+static void c_value(struct OPERAND* operand, char* buf, int size)
+{
+  if (operand->kind == KIND_LOCAL)
+    snprintf(buf, size, "v_%d", operand->slot);
+  else if (operand->type == TYPE_REAL && isinf(operand->d))
+    snprintf(buf, size, "(%sHUGE_VAL)", (operand->d < 0) ? "-" : "");
+  else if (operand->type == TYPE_REAL)
+    snprintf(buf, size, "(%a)", operand->d);
+  else if (operand->i == INT_MIN)
+    snprintf(buf, size, "(-2147483647 - 1)");
+  else
+    snprintf(buf, size, "(%d)", operand->i);
+}
+
+//
+// ram_value
+//
+// Writes the C expression for the tagged value of a constant or local
+// into buf.
+//
+static void ram_value(struct OPERAND* operand, char* buf, int size)
+{
+  char value[32];  // e.g. (-0x1.fffffffffffffp+1023), the longest
+  c_value(operand, value, sizeof(value));
+
+  if (operand->type == TYPE_INT)
+    snprintf(buf, size, "rt_int(%s)", value);
+  else if (operand->type == TYPE_REAL)
+    snprintf(buf, size, "rt_real(%s)", value);
+  else if (operand->type == TYPE_BOOL)
+    snprintf(buf, size, "rt_bool(%s)", (operand->kind == KIND_LOCAL) ? value : (operand->i ? "1" : "0"));
+  else if (operand->type == TYPE_STR)
+    snprintf(buf, size, "rt_str(strings[%d])", operand->string);
+  else
+    snprintf(buf, size, "rt_none()");
+}
+
+//
+// fetch
+//
+// Outputs the declaration of ok, true if the operand could be read;
+// a variable that is not certain to be defined is checked, and one in
+// memory is fetched into the named RAM_VALUE. Returns false if there
+// is nothing to check (ok is not declared).
+//
+static bool fetch(struct TRANSPILER* t, struct OPERAND* operand, char* name, int line)
+{
+  static const char* kinds[] = { "", "", "RT_VAR", "RT_DEREF", "RT_ADDR" };
+
+  if (operand->kind == KIND_CONST || (operand->kind == KIND_LOCAL && t->defined[operand->slot]))
+    return false;
+  if (operand->kind == KIND_LOCAL)
+    line_out(t, "bool %s_ok = rt_defined(d_%d, %d, %d);", name, operand->slot, operand->slot, line);
+  else
+    line_out(t, "bool %s_ok = rt_fetch(%s, %d, %d, &%s);", name, kinds[operand->kind], operand->slot, line, name);
+  return true;
+}
+
+//
+// sink_c
+//
+// Outputs code that puts a C value of the given type where the value
+// of the expression goes.
+//
+static void sink_c(struct TRANSPILER* t, int sink, int slot, const char* value, int type)
+{
+  const char* wrap = (type == TYPE_INT) ? "rt_int" : (type == TYPE_REAL) ? "rt_real" : "rt_bool";
+
+  if (sink == SINK_CONDITION && type == TYPE_REAL)  // only ints and booleans are ever true
+    line_out(t, "cond = false;");
+  else if (sink == SINK_CONDITION)
+    line_out(t, "cond = (%s) != 0;", value);
+  else if (sink == SINK_CELL)
+    line_out(t, "rt_store_cell(target, %s(%s), false);", wrap, value);
+  else if (sink == SINK_VAR && t->locals[slot] == 0)
+    line_out(t, "rt_store(%d, %s(%s), false);", slot, wrap, value);
+  else if (sink == SINK_VAR) {
+    line_out(t, "v_%d = %s;", slot, value);
+    if (!t->defined[slot])
+      line_out(t, "if (!d_%d) { rt_store(%d, rt_none(), false); d_%d = true; }", slot, slot, slot);
+  }
+}
+
+//
+// sink_ram
+//
+// Outputs code that puts a tagged value, held in the named RAM_VALUE,
+// where the value of the expression goes. If owned is true, the
+// value's string is released once it is stored.
+//
+static void sink_ram(struct TRANSPILER* t, int sink, int slot, const char* value, bool owned)
+{
+  if (sink == SINK_CONDITION) {
+    line_out(t, "cond = rt_true(&%s);", value);
+    if (owned)
+      line_out(t, "rt_release(&%s);", value);
+  }
+  else if (sink == SINK_CELL)
+    line_out(t, "rt_store_cell(target, %s, %s);", value, owned ? "true" : "false");
+  else if (t->locals[slot] == 0)
+    line_out(t, "rt_store(%d, %s, %s);", slot, value, owned ? "true" : "false");
+  else {
+    // the value has the local's type, the only one it can have:
+    line_out(t, "v_%d = %s.types.%s;", slot, value, (t->locals[slot] == TYPE_REAL) ? "d" : "i");
+    if (!t->defined[slot])
+      line_out(t, "if (!d_%d) { rt_store(%d, rt_none(), false); d_%d = true; }", slot, slot, slot);
+  }
+}
+
+//
+// emit_unary
+//
+// Outputs the code for an expression with no operator.
+//
+static void emit_unary(struct TRANSPILER* t, struct UNARY_EXPR* unary, int sink, int slot, int line)
+{
+  struct OPERAND a = make_operand(t, unary, false);
+  char value[64];
+
+  if (a.kind == KIND_VAR || a.kind == KIND_DEREF || a.kind == KIND_ADDR) {
+    line_out(t, "struct RAM_VALUE value;");
+    fetch(t, &a, "value", line);
+    line_out(t, "if (!value_ok) goto done;");
+    sink_ram(t, sink, slot, "value", false);
+    return;
+  }
+
+  if (fetch(t, &a, "value", line))
+    line_out(t, "if (!value_ok) goto done;");
+
+  if (is_number(&a) || a.type == TYPE_BOOL) {
+    c_value(&a, value, sizeof(value));
+    if (a.kind == KIND_CONST && a.type == TYPE_BOOL)
+      snprintf(value, sizeof(value), "%d", a.i);
+    sink_c(t, sink, slot, value, a.type);
+  } else {
+    ram_value(&a, value, sizeof(value));
+    line_out(t, "struct RAM_VALUE value = %s;", value);
+    sink_ram(t, sink, slot, "value", false);
+  }
+}
+
+//
+// emit_direct
+//
+// Outputs lhs <operator> rhs for two numbers whose types are known, in
+// plain C.
+//
+static void emit_direct(struct TRANSPILER* t, int operator, struct OPERAND* a, struct OPERAND* b, int sink, int slot, int line)
+{
+  static const char* c_operators[] = { "+", "-", "*", "", "%", "/", "==", "!=", "<", "<=", ">", ">=" };
+  char lhs[80], rhs[80], value[256];
+  bool ints = (a->type == TYPE_INT && b->type == TYPE_INT);
+
+  c_value(a, lhs, sizeof(lhs));
+  c_value(b, rhs, sizeof(rhs));
+
+  if (operator < OPERATOR_PLUS || operator > OPERATOR_GTE) {  // is, in
+    line_out(t, "rt_error(\"invalid operand types\", %d);", line);
+    line_out(t, "goto done;");
+    return;
+  }
+
+  if (operator == OPERATOR_DIV || (operator == OPERATOR_MOD && ints)) {
+    line_out(t, "if (%s == 0) {", rhs);
+    line_out(t, "  rt_error(\"ZeroDivisionError: %s\", %d);", (operator == OPERATOR_DIV) ? "division by zero" : "integer modulo by zero", line);
+    line_out(t, "  goto done;");
+    line_out(t, "}");
+  }
+
+  if (!ints) {  // mixed types are computed as reals
+    char real[96];
+    if (a->type == TYPE_INT) {
+      snprintf(real, sizeof(real), "(double)%s", lhs);
+      strcpy(lhs, real);
+    }
+    if (b->type == TYPE_INT) {
+      snprintf(real, sizeof(real), "(double)%s", rhs);
+      strcpy(rhs, real);
+    }
+  }
+
+  int type = (operator >= OPERATOR_EQUAL) ? TYPE_BOOL : ints ? TYPE_INT : TYPE_REAL;
+  if (operator == OPERATOR_POWER)
+    snprintf(value, sizeof(value), ints ? "(int)pow(%s, %s)" : "pow(%s, %s)", lhs, rhs);
+  else if (operator == OPERATOR_MOD && !ints)
+    snprintf(value, sizeof(value), "fmod(%s, %s)", lhs, rhs);
+  else
+    snprintf(value, sizeof(value), "%s %s %s", lhs, c_operators[operator], rhs);
+
+  sink_c(t, sink, slot, value, type);
+}
+
+//
+// emit_binary
+//
+// Outputs the code for lhs <operator> rhs. Both operands are read
+// (and their errors output) before an error stops the program.
+//
+static void emit_binary(struct TRANSPILER* t, struct EXPR* expr, int sink, int slot, int line)
+{
+  if (expr->rhs == NULL) {  // malformed expression, stop without a message
+    line_out(t, "goto done;");
+    return;
+  }
+
+  struct OPERAND a = make_operand(t, expr->lhs, true);
+  struct OPERAND b = make_operand(t, expr->rhs, true);
+  bool direct = is_number(&a) && is_number(&b);
+  int operator = expr->operator;
+  char value[64];
+
+  if (operator < OPERATOR_PLUS || operator > OPERATOR_IN)
+    operator = OPERATOR_IS;
+
+  if (!direct)
+    line_out(t, "struct RAM_VALUE lhs, rhs;");
+  bool lhs_check = fetch(t, &a, "lhs", line);
+  bool rhs_check = fetch(t, &b, "rhs", line);
+  if (lhs_check || rhs_check)
+    line_out(t, "if (!(%s && %s)) goto done;", lhs_check ? "lhs_ok" : "true", rhs_check ? "rhs_ok" : "true");
+
+  if (direct) {
+    emit_direct(t, operator, &a, &b, sink, slot, line);
+    return;
+  }
+
+  if (a.kind == KIND_CONST || a.kind == KIND_LOCAL) {
+    ram_value(&a, value, sizeof(value));
+    line_out(t, "lhs = %s;", value);
+  }
+  if (b.kind == KIND_CONST || b.kind == KIND_LOCAL) {
+    ram_value(&b, value, sizeof(value));
+    line_out(t, "rhs = %s;", value);
+  }
+
+  // x = x + ...: appends to x's string in place, like the VM
+  if (operator == OPERATOR_PLUS && sink == SINK_VAR && a.kind == KIND_VAR && a.slot == slot) {
+    line_out(t, "if (!rt_append(%d, &lhs, &rhs, %d)) goto done;", slot, line);
+    return;
+  }
+
+  line_out(t, "struct RAM_VALUE result;");
+  line_out(t, "if (!rt_binary(%s, &lhs, &rhs, &result, %d)) goto done;", rt_operators[operator], line);
+  sink_ram(t, sink, slot, "result", true);
+}
+
+//
+// emit_expr
+//
+// Outputs the code for an expression whose value goes to the sink.
+//
+static void emit_expr(struct TRANSPILER* t, struct EXPR* expr, int sink, int slot, int line)
+{
+  if (expr->isBinaryExpr)
+    emit_binary(t, expr, sink, slot, line);
+  else
+    emit_unary(t, expr->lhs, sink, slot, line);
+}
+
+//
+// emit_assignment
+//
+// Outputs the code for x = ..., *p = ..., and x = input/int/float(...).
+// For *p the target is found before the right-hand side is evaluated,
+// so errors are output in the same order as the executor.
+//
+static void emit_assignment(struct TRANSPILER* t, struct STMT* stmt)
+{
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+  int slot = slot_of(t, assignment->var_name);
+  int sink = SINK_VAR;
+  int line = stmt->line;
+
+  line_out(t, "{  // line %d", line);
+  t->indent++;
+
+  if (assignment->isPtrDeref) {
+    line_out(t, "int target;");
+    line_out(t, "if (!rt_deref_target(%d, %d, &target)) goto done;", slot, line);
+    sink = SINK_CELL;
+  }
+
+  if (assignment->rhs->value_type == VALUE_EXPR)
+    emit_expr(t, assignment->rhs->types.expr, sink, slot, line);
+  else {
+    // function call: input, int, and float, anything else is ignored
+    struct FUNCTION_CALL* call = assignment->rhs->types.function_call;
+    struct ELEMENT* parameter = call->parameter;
+
+    if (strcmp(call->function_name, "input") == 0) {
+      line_out(t, "struct RAM_VALUE result;");
+      if (parameter == NULL)
+        line_out(t, "rt_input(NULL, &result);");
+      else  // the prompt is output as written, whatever the element type
+        line_out(t, "rt_input(strings[%d], &result);", add_string(t, parameter->element_value));
+      sink_ram(t, sink, slot, "result", true);
+    }
+    else if (strcmp(call->function_name, "int") == 0 || strcmp(call->function_name, "float") == 0) {
+      line_out(t, "struct RAM_VALUE value, result;");
+      if (parameter == NULL)
+        line_out(t, "value = rt_none();");
+      else {  // the parameter is always looked up as a variable
+        line_out(t, "if (!rt_fetch(RT_VAR, %d, %d, &value)) goto done;", slot_of(t, parameter->element_value), line);
+      }
+      line_out(t, "if (!rt_convert(%s, &value, &result, %d)) goto done;", (strcmp(call->function_name, "int") == 0) ? "true" : "false", line);
+      sink_ram(t, sink, slot, "result", false);
+    }
+  }
+
+  t->indent--;
+  line_out(t, "}");
+
+  if (sink == SINK_VAR)
+    t->defined[slot] = true;
+}
+
+//
+// emit_print
+//
+// Outputs the code for a function call statement, which is always
+// print. Literals are formatted now, once.
+//
+static void emit_print(struct TRANSPILER* t, struct STMT* stmt)
+{
+  struct ELEMENT* parameter = stmt->types.function_call->parameter;
+  int line = stmt->line;
+  char text[64];
+
+  if (parameter == NULL) {
+    line_out(t, "printf(\"\\n\");");
+    return;
+  }
+
+  switch (parameter->element_type) {
+  case ELEMENT_IDENTIFIER:
+    break;
+  case ELEMENT_INT_LITERAL:
+    snprintf(text, sizeof(text), "%d\n", atoi(parameter->element_value));
+    fprintf(t->out, "%*sfputs(", 2 * t->indent, "");
+    string_literal(t->out, text);
+    fprintf(t->out, ", stdout);\n");
+    return;
+  case ELEMENT_REAL_LITERAL:
+    snprintf(text, sizeof(text), "%f\n", atof(parameter->element_value));
+    fprintf(t->out, "%*sfputs(", 2 * t->indent, "");
+    string_literal(t->out, text);
+    fprintf(t->out, ", stdout);\n");
+    return;
+  case ELEMENT_STR_LITERAL:
+    line_out(t, "printf(\"%%s\\n\", strings[%d]);", add_string(t, parameter->element_value));
+    return;
+  case ELEMENT_TRUE:
+  case ELEMENT_FALSE:
+    line_out(t, "printf(\"%s\\n\");", (parameter->element_type == ELEMENT_TRUE) ? "True" : "False");
+    return;
+  default:
+    return;  // None outputs nothing at all
+  }
+
+  int slot = slot_of(t, parameter->element_value);
+  int local = t->locals[slot];
+
+  line_out(t, "{  // line %d", line);
+  t->indent++;
+  if (local == 0) {
+    line_out(t, "struct RAM_VALUE value;");
+    line_out(t, "if (!rt_fetch(RT_VAR, %d, %d, &value)) goto done;", slot, line);
+    line_out(t, "rt_print(&value);");
+  } else {
+    if (!t->defined[slot])
+      line_out(t, "if (!rt_defined(d_%d, %d, %d)) goto done;", slot, slot, line);
+    if (local == TYPE_INT)
+      line_out(t, "printf(\"%%d\\n\", v_%d);", slot);
+    else if (local == TYPE_REAL)
+      line_out(t, "printf(\"%%f\\n\", v_%d);", slot);
+    else
+      line_out(t, "printf(\"%%s\\n\", (v_%d == 1) ? \"True\" : \"False\");", slot);
+  }
+  t->indent--;
+  line_out(t, "}");
+}
+
+static void emit_stmts(struct TRANSPILER* t, struct STMT* stmt, struct STMT* stop);
+
+//
+// emit_while
+//
+// Outputs a while loop as an endless C loop that breaks when the
+// condition is false. Variables first assigned in the body are not
+// certain to be defined after it, since it may not run at all.
+//
+static void emit_while(struct TRANSPILER* t, struct STMT* stmt)
+{
+  struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
+  int n = t->num_slots;
+
+  line_out(t, "for (;;) {  // while, line %d", stmt->line);
+  t->indent++;
+  line_out(t, "bool cond;");
+  line_out(t, "{");
+  t->indent++;
+  emit_expr(t, while_loop->condition, SINK_CONDITION, 0, stmt->line);
+  t->indent--;
+  line_out(t, "}");
+  line_out(t, "if (!cond) break;");
+
+  bool* defined = (bool*)malloc((n + 1) * sizeof(bool));
+  if (defined == NULL)
+    panic("out of memory (emit_while)");
+  memcpy(defined, t->defined, n * sizeof(bool));
+
+  // the last stmt in the body links back to the loop itself:
+  emit_stmts(t, while_loop->loop_body, stmt);
+
+  memcpy(t->defined, defined, n * sizeof(bool));
+  for (int slot = n; slot < t->num_slots; slot++)
+    t->defined[slot] = false;
+  free(defined);
+
+  t->indent--;
+  line_out(t, "}");
+}
+
+//
+// emit_stmts
+//
+// Outputs the code for the statements from stmt until stop (or the
+// end of the program).
+//
+static void emit_stmts(struct TRANSPILER* t, struct STMT* stmt, struct STMT* stop)
+{
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      emit_assignment(t, stmt);
+      stmt = stmt->types.assignment->next_stmt;
+    } else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      emit_print(t, stmt);
+      stmt = stmt->types.function_call->next_stmt;
+    } else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      emit_while(t, stmt);
+      stmt = stmt->types.while_loop->next_stmt;
+    } else if (stmt->stmt_type == STMT_PASS) {
+      stmt = stmt->types.pass->next_stmt;
+    } else { // if-then-else is rejected by programgraph_build
+      line_out(t, "goto done;");
+      return;
+    }
+  }
+}
+
+//
+// write_program
+//
+// Outputs the whole C program: the runtime, the tables, and main,
+// whose statements are copied from t->out.
+//
+static void write_program(struct TRANSPILER* t, FILE* output)
+{
+  int n = t->symbols->num_slots;
+
+  fprintf(output, "//\n");
+  fprintf(output, "// Generated by the nuPython transpiler (see transpile.h). Build with:\n");
+  fprintf(output, "//\n");
+  fprintf(output, "//   gcc -std=c11 -O2 -fwrapv <this file> ram.c rstring.c -lm\n");
+  fprintf(output, "//\n\n");
+  fprintf(output, "#include <stdio.h>\n#include <stdlib.h>\n#include <stdbool.h>\n#include <string.h>\n#include <math.h>\n\n");
+  fprintf(output, "#include \"ram.h\"\n#include \"rstring.h\"\n\n");
+
+  fprintf(output, "static char* names[] = {");
+  for (int slot = 0; slot < n; slot++) {
+    fprintf(output, "%s", (slot % 8 == 0) ? "\n  " : " ");
+    string_literal(output, t->symbols->names[slot]);
+    fprintf(output, ",");
+  }
+  fprintf(output, "\n  NULL\n};\n");
+  fprintf(output, "static int addresses[%d];\n", n + 1);
+  fprintf(output, "static char* strings[%d];\n\n", t->num_strings + 1);
+
+  for (int i = 0; prelude[i] != NULL; i++)
+    fprintf(output, "%s\n", prelude[i]);
+
+  fprintf(output, "\nint main(void)\n{\n");
+  for (int slot = 0; slot < n; slot++) {
+    if (t->locals[slot] != 0)
+      fprintf(output, "  %s v_%d = 0;  // %s\n  bool d_%d = false;\n", (t->locals[slot] == TYPE_REAL) ? "double" : "int", slot, t->symbols->names[slot], slot);
+  }
+  fprintf(output, "\n  memory = ram_init();\n");
+  fprintf(output, "  for (int i = 0; i < %d; i++)\n    addresses[i] = -1;\n", n);
+  for (int i = 0; i < t->num_strings; i++) {
+    fprintf(output, "  strings[%d] = rstr_from(", i);
+    string_literal(output, t->strings[i]);
+    fprintf(output, ");\n");
+  }
+  fprintf(output, "\n");
+
+  // the statements:
+  rewind(t->out);
+  char buf[4096];
+  size_t count;
+  while ((count = fread(buf, 1, sizeof(buf), t->out)) > 0)
+    fwrite(buf, 1, count, output);
+
+  // the end, where errors also go:
+  fprintf(output, "\ndone:\n");
+  for (int slot = 0; slot < n; slot++) {
+    if (t->locals[slot] != 0)
+      fprintf(output, "  if (d_%d)\n    ram_write_cell_by_addr(memory, %s(v_%d), addresses[%d]);\n", slot,
+        (t->locals[slot] == TYPE_INT) ? "rt_int" : (t->locals[slot] == TYPE_REAL) ? "rt_real" : "rt_bool", slot, slot);
+  }
+  fprintf(output, "  printf(\"**done\\n\");\n");
+  fprintf(output, "  ram_print(memory);\n");
+  fprintf(output, "  ram_destroy(memory);\n");
+  fprintf(output, "  for (int i = 0; i < %d; i++)\n    rstr_release(strings[i]);\n", t->num_strings);
+  fprintf(output, "  return 0;\n}\n");
+}
+
+
+//
+// transpile_program
+//
+// Writes a C program equivalent to the given nuPython program
+// graph to the given file. Returns true if successful, false if
+// not (an error msg is output).
+//
+bool transpile_program(struct STMT* program, FILE* output)
+{
+  struct TRANSPILER t;
+
+  t.symbols = resolve_program(program);
+  t.num_slots = 0;
+  t.types = NULL;
+  t.locals = NULL;
+  t.defined = NULL;
+  t.pointers = false;
+  t.strings = NULL;
+  t.num_strings = 0;
+  t.string_capacity = 0;
+  t.indent = 1;
+
+  reserve_slots(&t, t.symbols->num_slots);  // the arrays exist even with no variables
+
+  t.out = tmpfile();
+  if (t.out == NULL) {
+    printf("**ERROR: unable to create a temporary file for the C code.\n");
+    symtab_destroy(t.symbols);
+    return false;
+  }
+
+  while (infer_stmts(&t, program, NULL))
+    ;
+  choose_locals(&t);
+
+  emit_stmts(&t, program, NULL);
+  write_program(&t, output);
+
+  fclose(t.out);
+  free(t.types);
+  free(t.locals);
+  free(t.defined);
+  free(t.strings);
+  symtab_destroy(t.symbols);
+
+  return true;
+}
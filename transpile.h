@@ -0,0 +1,48 @@
+/*transpile.h*/
+
+//
+// Ahead-of-time compiler from nuPython to C. The program graph is
+// translated into a single C translation unit which, compiled with
+// gcc and linked with ram.c and rstring.c, is a standalone program
+// that outputs exactly what the VM outputs after "**executing...":
+// the program's own output and errors, then **done and the memory.
+//
+// A variable that only ever holds one type --- int, real, or boolean
+// --- becomes a typed C local, and the operations on such locals are
+// plain C arithmetic. Every other variable lives in a RAM memory and
+// is handled by a small tagged-value runtime emitted at the top of the
+// file, which follows vm.c (and so execute.c) exactly. Programs that
+// use pointers keep every variable in memory, since any cell may be
+// reached through one.
+//
+// Build the output with:
+//
+//   gcc -std=c11 -O2 -fwrapv prog.c ram.c rstring.c -lm
+//
+// -fwrapv keeps int overflow wrapping around, as it does in the VM.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+
+
+//
+// Public functions:
+//
+
+//
+// transpile_program
+//
+// Writes a C program equivalent to the given nuPython program
+// graph to the given file. Returns true if successful, false if
+// not (an error msg is output).
+//
+bool transpile_program(struct STMT* program, FILE* output);
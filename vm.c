@@ -0,0 +1,1004 @@
+/*vm.c*/
+
+//
+// Virtual machine for nuPython bytecode. The dispatch loop fetches one
+// instruction at a time and switches on its opcode; each instruction
+// reads its operands straight from registers, the constant pool, or
+// memory, so there is no per-statement walk through the program graph.
+//
+// Built with VM_THREADED defined (make threaded), the loop is direct
+// threaded instead: a table of label addresses, indexed by opcode, and
+// GCC's computed goto let each instruction jump straight to the code
+// for the next one. Every instruction then has its own indirect jump,
+// which the CPU predicts far better than the single one in a switch.
+// The switch stays as the portable (ISO C) version.
+//
+// Every string the VM handles (constants, registers, memory) is a
+// refcounted rstring (see rstring.h), so moving a string from one
+// place to another is a reference count bump, never a copy. The
+// compiler turns x = x + ... into OP_APPEND, which extends x's string
+// in place when it is not shared.
+//
+// Variables are referred to by slot. The first time a slot is written,
+// its memory address is cached; since an address never changes once a
+// variable is written, every later access goes straight to the cell by
+// address instead of searching memory by name.
+//
+// Instructions that check.c has proven safe are marked as checked, and
+// read their operands with vm_peek, skipping every run-time check.
+//
+// Binary instructions are quickened: each one has an inline cache of
+// the operand types it has seen, and after QUICKEN_THRESHOLD runs with
+// the same int-int or real-real types it is rewritten in place into a
+// specialized opcode (e.g. OP_ADD_II), which does the operation after
+// a single type check instead of going through vm_binary. If the check
+// ever fails, the instruction goes back to its generic opcode for good.
+//
+// With a JIT (see jit.h), every jump back to a loop header goes
+// through jit_loop first, which may run the loop as machine code and
+// tell the VM where to resume.
+//
+// The semantics (and error messages) follow execute.c exactly: both
+// operands of a binary expression are fetched before any error stops
+// execution, while conditions are true only for non-zero int/boolean
+// values, and so on.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <math.h>
+
+#include "bytecode.h"
+#include "ram.h"
+#include "rstring.h"
+#include "jit.h"
+#include "vm.h"
+#include "output.h"
+#include "input.h"
+
+
+//
+// # of runs with the same operand types before an instruction is quickened:
+//
+#define QUICKEN_THRESHOLD 4
+
+
+//
+// The state of a running program:
+//
+struct VM
+{
+  struct BYTECODE* code;
+  struct RAM* memory;
+  struct RAM_VALUE* registers;  // each string holds a reference
+  int* addresses;  // slot -> memory address, -1 => not known yet
+  struct JIT* jit;  // NULL => loops are always interpreted
+};
+
+
+//
+// vm_address
+//
+// Returns the memory address of the variable in the given slot, or -1
+// if the variable has not been written to memory yet.
+//
+static int vm_address(struct VM* vm, int slot)
+{
+  int address = vm->addresses[slot];
+
+  if (address < 0) {
+    address = ram_get_addr(vm->memory, vm->code->symbols->names[slot]);
+    vm->addresses[slot] = address;
+  }
+  return address;
+}
+
+//
+// vm_cell
+//
+// Returns the value in the memory cell of the variable in the given
+// slot, which must be defined. Superinstructions use it to change an
+// int in place; only ints are ever changed this way, since they hold
+// no reference to anything.
+//
+static struct RAM_VALUE* vm_cell(struct VM* vm, int slot)
+{
+  return &vm->memory->cells[vm_address(vm, slot)].value;
+}
+
+//
+// vm_fetch
+//
+// Fetches the value of the given operand into *value. The value is
+// borrowed: a string points into a register, the constant pool or
+// memory, and is only valid until that location is next written.
+// Returns false if a semantic error occurred (error msg is output).
+//
+static bool vm_fetch(struct VM* vm, struct OPERAND operand, int line, struct RAM_VALUE* value)
+{
+  if (operand.kind == OPND_REG) {
+    *value = vm->registers[operand.index];
+    return true;
+  }
+  if (operand.kind == OPND_CONST) {
+    *value = vm->code->constants[operand.index];
+    return true;
+  }
+  if (operand.kind == OPND_NONE) {
+    value->value_type = RAM_TYPE_NONE;
+    value->types.i = 0;
+    return true;
+  }
+
+  char* name = vm->code->symbols->names[operand.index];
+  int address = vm_address(vm, operand.index);
+
+  if (operand.kind == OPND_ADDR) {
+    if (address == -1) {
+      printf("**SEMANTIC ERROR: name '%s' is not defined (line '%d')\n", name, line);
+      return false;
+    }
+    value->value_type = RAM_TYPE_PTR;
+    value->types.i = address;
+    return true;
+  }
+
+  if (address == -1) {
+    printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line);
+    return false;
+  }
+  const struct RAM_VALUE* cell = ram_peek_cell_by_addr(vm->memory, address);
+
+  if (operand.kind == OPND_DEREF) { // follow the pointer to the cell it refers to
+    if (cell->value_type != RAM_TYPE_PTR) {
+      printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+      return false;
+    }
+    cell = ram_peek_cell_by_addr(vm->memory, cell->types.i);
+    if (cell == NULL) {
+      printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", name, line);
+      return false;
+    }
+  }
+
+  *value = *cell;
+  return true;
+}
+
+//
+// vm_peek
+//
+// Returns the value of an operand with none of vm_fetch's checks, for
+// instructions that check.c has proven safe: every variable read is
+// defined, and every pointer followed holds a valid address. Like
+// vm_fetch, a string in the value is borrowed.
+//
+static struct RAM_VALUE vm_peek(struct VM* vm, struct OPERAND operand)
+{
+  struct RAM_VALUE value;
+
+  switch (operand.kind) {
+  case OPND_REG:
+    return vm->registers[operand.index];
+  case OPND_CONST:
+    return vm->code->constants[operand.index];
+  case OPND_ADDR:
+    value.value_type = RAM_TYPE_PTR;
+    value.types.i = vm_address(vm, operand.index);
+    return value;
+  case OPND_DEREF:
+    value = *ram_peek_cell_by_addr(vm->memory, vm_address(vm, operand.index));
+    return *ram_peek_cell_by_addr(vm->memory, value.types.i);
+  case OPND_VAR:
+    return *ram_peek_cell_by_addr(vm->memory, vm_address(vm, operand.index));
+  default:
+    value.value_type = RAM_TYPE_NONE;
+    value.types.i = 0;
+    return value;
+  }
+}
+
+//
+// vm_store
+//
+// Stores a value into the given destination: a variable, the memory
+// cell addressed by a register, or a register. If owned is true the
+// caller's reference to the value's string is consumed by the call,
+// otherwise the destination takes a reference of its own.
+//
+static void vm_store(struct VM* vm, struct OPERAND dst, struct RAM_VALUE value, bool owned)
+{
+  if (dst.kind == OPND_REG) {
+    struct RAM_VALUE* reg = &vm->registers[dst.index];
+
+    // retain before releasing, the value may be borrowed from this register:
+    if (value.value_type == RAM_TYPE_STR && !owned)
+      rstr_retain(value.types.s);
+    if (reg->value_type == RAM_TYPE_STR)
+      rstr_release(reg->types.s);
+    *reg = value;
+    return;
+  }
+
+  if (dst.kind == OPND_CELL) {
+    ram_share_cell_by_addr(vm->memory, value, vm->registers[dst.index].types.i);
+  } else {
+    int address = vm_address(vm, dst.index);
+    if (address >= 0) {
+      ram_share_cell_by_addr(vm->memory, value, address);
+    } else { // first write, the variable gets its address now
+      char* name = vm->code->symbols->names[dst.index];
+      ram_share_cell_by_name(vm->memory, value, name);
+      vm->addresses[dst.index] = ram_get_addr(vm->memory, name);
+    }
+  }
+
+  if (owned && value.value_type == RAM_TYPE_STR) // memory has its own reference
+    rstr_release(value.types.s);
+}
+
+//
+// int_op
+//
+// Applies an arithmetic or relational operator to two integers.
+// Returns false if a semantic error occurred (error msg is output).
+//
+static bool int_op(int opcode, int lhs, int rhs, struct RAM_VALUE* result, int line)
+{
+  result->value_type = RAM_TYPE_INT;
+
+  switch (opcode) {
+  case OP_ADD: result->types.i = lhs + rhs; break;
+  case OP_SUB: result->types.i = lhs - rhs; break;
+  case OP_MUL: result->types.i = lhs * rhs; break;
+  case OP_POW: result->types.i = (int)pow(lhs, rhs); break;
+  case OP_MOD:
+    if (rhs == 0) {
+      printf("**SEMANTIC ERROR: ZeroDivisionError: integer modulo by zero (line %d)\n", line);
+      return false;
+    }
+    result->types.i = lhs % rhs;
+    break;
+  case OP_DIV:
+    if (rhs == 0) {
+      printf("**SEMANTIC ERROR: ZeroDivisionError: division by zero (line %d)\n", line);
+      return false;
+    }
+    result->types.i = lhs / rhs;
+    break;
+  default:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (opcode == OP_EQ) result->types.i = (lhs == rhs);
+    else if (opcode == OP_NE) result->types.i = (lhs != rhs);
+    else if (opcode == OP_LT) result->types.i = (lhs < rhs);
+    else if (opcode == OP_LTE) result->types.i = (lhs <= rhs);
+    else if (opcode == OP_GT) result->types.i = (lhs > rhs);
+    else if (opcode == OP_GTE) result->types.i = (lhs >= rhs);
+    else {
+      printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// real_op
+//
+// Applies an arithmetic or relational operator to two reals.
+// Returns false if a semantic error occurred (error msg is output).
+//
+static bool real_op(int opcode, double lhs, double rhs, struct RAM_VALUE* result, int line)
+{
+  result->value_type = RAM_TYPE_REAL;
+
+  switch (opcode) {
+  case OP_ADD: result->types.d = lhs + rhs; break;
+  case OP_SUB: result->types.d = lhs - rhs; break;
+  case OP_MUL: result->types.d = lhs * rhs; break;
+  case OP_POW: result->types.d = pow(lhs, rhs); break;
+  case OP_MOD: result->types.d = fmod(lhs, rhs); break;
+  case OP_DIV:
+    if (rhs == 0.0) {
+      printf("**SEMANTIC ERROR: ZeroDivisionError: division by zero (line %d)\n", line);
+      return false;
+    }
+    result->types.d = lhs / rhs;
+    break;
+  default:
+    result->value_type = RAM_TYPE_BOOLEAN;
+    if (opcode == OP_EQ) result->types.i = (lhs == rhs);
+    else if (opcode == OP_NE) result->types.i = (lhs != rhs);
+    else if (opcode == OP_LT) result->types.i = (lhs < rhs);
+    else if (opcode == OP_LTE) result->types.i = (lhs <= rhs);
+    else if (opcode == OP_GT) result->types.i = (lhs > rhs);
+    else if (opcode == OP_GTE) result->types.i = (lhs >= rhs);
+    else {
+      printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// str_op
+//
+// Applies an operator to two strings: + concatenates (the result is a
+// new rstring the caller owns), the relational operators compare.
+// Returns false if a semantic error occurred (error msg is output).
+//
+static bool str_op(int opcode, char* lhs, char* rhs, struct RAM_VALUE* result, int line)
+{
+  if (opcode == OP_ADD) {
+    result->value_type = RAM_TYPE_STR;
+    result->types.s = rstr_concat(lhs, rstr_length(lhs), rhs, rstr_length(rhs));
+    return true;
+  }
+
+  int str_comp = strcmp(lhs, rhs);
+  result->value_type = RAM_TYPE_BOOLEAN;
+
+  if (opcode == OP_EQ) result->types.i = (str_comp == 0);
+  else if (opcode == OP_NE) result->types.i = (str_comp != 0);
+  else if (opcode == OP_LT) result->types.i = (str_comp < 0);
+  else if (opcode == OP_LTE) result->types.i = (str_comp <= 0);
+  else if (opcode == OP_GT) result->types.i = (str_comp > 0);
+  else if (opcode == OP_GTE) result->types.i = (str_comp >= 0);
+  else {
+    printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+    return false;
+  }
+  return true;
+}
+
+//
+// vm_binary
+//
+// Evaluates lhs <opcode> rhs for every supported combination of types:
+// int-int, real-real, int-real, str-str, and ptr-int (pointer arithmetic,
+// where the result is always a pointer). Returns false if a semantic
+// error occurred (error msg is output).
+//
+bool vm_binary(int opcode, struct RAM_VALUE* lhs, struct RAM_VALUE* rhs, struct RAM_VALUE* result, int line)
+{
+  int type_lhs = lhs->value_type;
+  int type_rhs = rhs->value_type;
+
+  if (type_lhs == RAM_TYPE_INT && type_rhs == RAM_TYPE_INT)
+    return int_op(opcode, lhs->types.i, rhs->types.i, result, line);
+
+  if ((type_lhs == RAM_TYPE_INT || type_lhs == RAM_TYPE_REAL) && (type_rhs == RAM_TYPE_INT || type_rhs == RAM_TYPE_REAL)) {
+    double lhs_real = (type_lhs == RAM_TYPE_INT) ? (double)lhs->types.i : lhs->types.d;
+    double rhs_real = (type_rhs == RAM_TYPE_INT) ? (double)rhs->types.i : rhs->types.d;
+    return real_op(opcode, lhs_real, rhs_real, result, line);
+  }
+
+  if (type_lhs == RAM_TYPE_STR && type_rhs == RAM_TYPE_STR)
+    return str_op(opcode, lhs->types.s, rhs->types.s, result, line);
+
+  if (type_lhs == RAM_TYPE_PTR && type_rhs == RAM_TYPE_INT) {
+    if (!int_op(opcode, lhs->types.i, rhs->types.i, result, line))
+      return false;
+    result->value_type = RAM_TYPE_PTR;
+    return true;
+  }
+
+  printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+  return false;
+}
+
+//
+// vm_print
+//
+// Outputs a value the way print() does, followed by a newline.
+// None outputs nothing at all.
+//
+void vm_print(struct RAM_VALUE* value)
+{
+  int type = value->value_type;
+
+  if (type == RAM_TYPE_INT || type == RAM_TYPE_PTR)
+    output_int(value->types.i);
+  else if (type == RAM_TYPE_REAL)
+    output_real(value->types.d);
+  else if (type == RAM_TYPE_STR)
+    output_string(value->types.s);
+  else if (type == RAM_TYPE_BOOLEAN)
+    output_string((value->types.i == 1) ? "True" : "False");
+}
+
+//
+// vm_input
+//
+// Outputs the prompt and reads one line from the keyboard (see
+// input.h), returned as an rstring the caller owns.
+//
+void vm_input(struct RAM_VALUE* prompt, struct RAM_VALUE* result)
+{
+  if (prompt->value_type == RAM_TYPE_STR)
+    printf("%s", prompt->types.s);
+  output_flush();  // the prompt, and everything printed so far
+
+  result->value_type = RAM_TYPE_STR;
+  result->types.s = input_string();
+}
+
+//
+// vm_convert
+//
+// Implements int() and float(): converts the string value to a number,
+// failing if the string is not a valid number. Returns false if a
+// semantic error occurred (error msg is output).
+//
+bool vm_convert(int opcode, struct RAM_VALUE* value, struct RAM_VALUE* result, int line)
+{
+  char* function = (opcode == OP_INT) ? "int" : "float";
+
+  if (value->value_type != RAM_TYPE_STR) {
+    printf("**SEMANTIC ERROR: invalid string for %s() (line %d)\n", function, line);
+    return false;
+  }
+
+  char* s = value->types.s;
+  if (opcode == OP_INT) {
+    int num = atoi(s);
+    if (num == 0 && !(strspn(s, "0") == strlen(s))) { // atoi failed (a real 0 is fine)
+      printf("**SEMANTIC ERROR: invalid string for int() (line %d)\n", line);
+      return false;
+    }
+    result->value_type = RAM_TYPE_INT;
+    result->types.i = num;
+  } else {
+    double num = atof(s);
+    if (num == 0.0 && !(strspn(s, "0.") == strlen(s))) { // atof failed (a real 0.0 is fine)
+      printf("**SEMANTIC ERROR: invalid string for float() (line %d)\n", line);
+      return false;
+    }
+    result->value_type = RAM_TYPE_REAL;
+    result->types.d = num;
+  }
+  return true;
+}
+
+//
+// vm_deref_target
+//
+// Resolves the target of *p = ..., i.e. the address stored in pointer
+// p, checking that p exists, is a pointer, and holds a valid address.
+// Returns false if a semantic error occurred (error msg is output).
+//
+static bool vm_deref_target(struct VM* vm, struct OPERAND pointer, int line, int* address)
+{
+  char* name = vm->code->symbols->names[pointer.index];
+
+  int pointer_address = vm_address(vm, pointer.index);
+  if (pointer_address == -1) {
+    printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", name, line);
+    return false;
+  }
+  const struct RAM_VALUE* cell = ram_peek_cell_by_addr(vm->memory, pointer_address);
+  if (cell->value_type != RAM_TYPE_PTR) {
+    printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+    return false;
+  }
+  *address = cell->types.i;
+
+  if (ram_peek_cell_by_addr(vm->memory, *address) == NULL) {
+    printf("**SEMANTIC ERROR: '%s' contains invalid address (line %d)\n", name, line);
+    return false;
+  }
+
+  return true;
+}
+
+//
+// generic_opcode
+//
+// Returns the generic binary opcode a quickened opcode came from.
+//
+static int generic_opcode(int opcode)
+{
+  static const int generic[] = {
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_EQ, OP_NE, OP_LT, OP_LTE, OP_GT, OP_GTE
+  };
+
+  if (opcode >= OP_ADD_RR)
+    return generic[opcode - OP_ADD_RR];
+  return generic[opcode - OP_ADD_II];
+}
+
+//
+// vm_quicken
+//
+// Records the operand types of a generic binary instruction in its
+// inline cache, and rewrites the instruction into its specialized
+// opcode once the types have been the same QUICKEN_THRESHOLD times
+// in a row.
+//
+static void vm_quicken(struct INSTR* instr, struct RAM_VALUE* lhs, struct RAM_VALUE* rhs)
+{
+  if (instr->cache_hits < 0)  // deoptimized before, the types are not stable
+    return;
+
+  int types = lhs->value_type * 8 + rhs->value_type;
+  if (types == instr->cache_types)
+    instr->cache_hits++;
+  else {
+    instr->cache_types = types;
+    instr->cache_hits = 1;
+  }
+
+  if (instr->cache_hits >= QUICKEN_THRESHOLD) {
+    int opcode = bytecode_quickened_opcode(instr->opcode, lhs->value_type, rhs->value_type);
+    if (opcode >= 0)
+      instr->opcode = opcode;
+    else
+      instr->cache_hits = -1;  // no specialized version, stop counting
+  }
+}
+
+//
+// vm_generic_binary
+//
+// The generic path for a binary instruction whose operands have been
+// fetched: evaluates lhs <opcode> rhs and stores the result. Returns
+// false if a semantic error occurred (error msg is output).
+//
+static bool vm_generic_binary(struct VM* vm, struct INSTR* instr, int opcode, struct RAM_VALUE* lhs, struct RAM_VALUE* rhs)
+{
+  struct RAM_VALUE result;
+
+  if (!vm_binary(opcode, lhs, rhs, &result, instr->line))
+    return false;
+
+  vm_store(vm, instr->dst, result, true);
+  return true;
+}
+
+//
+// vm_deoptimize
+//
+// Called when a quickened instruction's type check fails: puts the
+// instruction back to its generic opcode for good, and runs it.
+// Returns false if a semantic error occurred (error msg is output).
+//
+static bool vm_deoptimize(struct VM* vm, struct INSTR* instr, struct RAM_VALUE* lhs, struct RAM_VALUE* rhs)
+{
+  instr->opcode = generic_opcode(instr->opcode);
+  instr->cache_hits = -1;
+
+  return vm_generic_binary(vm, instr, instr->opcode, lhs, rhs);
+}
+
+//
+// vm_run
+//
+// The dispatch loop. Returns when the program halts or a semantic
+// error occurs.
+//
+static void vm_run(struct VM* vm)
+{
+  struct INSTR* code = vm->code->code;
+  struct INSTR* instr;
+  int pc = 0;
+
+#if defined(VM_THREADED)
+  static void* labels[NUM_OPCODES] = {
+    [OP_ADD] = &&L_OP_ADD, [OP_SUB] = &&L_OP_SUB, [OP_MUL] = &&L_OP_MUL,
+    [OP_POW] = &&L_OP_POW, [OP_MOD] = &&L_OP_MOD, [OP_DIV] = &&L_OP_DIV,
+    [OP_EQ] = &&L_OP_EQ, [OP_NE] = &&L_OP_NE, [OP_LT] = &&L_OP_LT,
+    [OP_LTE] = &&L_OP_LTE, [OP_GT] = &&L_OP_GT, [OP_GTE] = &&L_OP_GTE,
+    [OP_IS] = &&L_OP_IS, [OP_IN] = &&L_OP_IN, [OP_APPEND] = &&L_OP_APPEND,
+    [OP_MOVE] = &&L_OP_MOVE, [OP_INPUT] = &&L_OP_INPUT, [OP_INT] = &&L_OP_INT,
+    [OP_FLOAT] = &&L_OP_FLOAT, [OP_PRINT] = &&L_OP_PRINT,
+    [OP_DEREF_TARGET] = &&L_OP_DEREF_TARGET, [OP_JUMP] = &&L_OP_JUMP,
+    [OP_JUMP_IF_FALSE] = &&L_OP_JUMP_IF_FALSE, [OP_HALT] = &&L_OP_HALT,
+    [OP_ADD_II] = &&L_OP_ADD_II, [OP_SUB_II] = &&L_OP_SUB_II,
+    [OP_MUL_II] = &&L_OP_MUL_II, [OP_DIV_II] = &&L_OP_DIV_II,
+    [OP_EQ_II] = &&L_OP_EQ_II, [OP_NE_II] = &&L_OP_NE_II,
+    [OP_LT_II] = &&L_OP_LT_II, [OP_LTE_II] = &&L_OP_LTE_II,
+    [OP_GT_II] = &&L_OP_GT_II, [OP_GTE_II] = &&L_OP_GTE_II,
+    [OP_ADD_RR] = &&L_OP_ADD_RR, [OP_SUB_RR] = &&L_OP_SUB_RR,
+    [OP_MUL_RR] = &&L_OP_MUL_RR, [OP_DIV_RR] = &&L_OP_DIV_RR,
+    [OP_EQ_RR] = &&L_OP_EQ_RR, [OP_NE_RR] = &&L_OP_NE_RR,
+    [OP_LT_RR] = &&L_OP_LT_RR, [OP_LTE_RR] = &&L_OP_LTE_RR,
+    [OP_GT_RR] = &&L_OP_GT_RR, [OP_GTE_RR] = &&L_OP_GTE_RR,
+    [OP_INC_II] = &&L_OP_INC_II, [OP_ADD_TO_II] = &&L_OP_ADD_TO_II,
+    [OP_BRANCH_LT_II] = &&L_OP_BRANCH_LT_II, [OP_DEREF_INC] = &&L_OP_DEREF_INC,
+    [OP_LOOP_LT] = &&L_OP_LOOP_LT, [OP_LOOP_INC_LT] = &&L_OP_LOOP_INC_LT
+  };
+
+  // each instruction jumps straight to the code for the next one:
+#define DISPATCH()    do { instr = &code[pc++]; goto *labels[instr->opcode]; } while (0)
+#define CASE(OPCODE)  L_##OPCODE
+#define NEXT          DISPATCH()
+
+  DISPATCH();
+  {
+#else
+#define CASE(OPCODE)  case OPCODE
+#define NEXT          break
+
+  for (;;) {
+    instr = &code[pc];
+    pc++;
+
+    switch (instr->opcode) {
+#endif
+    CASE(OP_ADD): CASE(OP_SUB): CASE(OP_MUL): CASE(OP_POW): CASE(OP_MOD): CASE(OP_DIV):
+    CASE(OP_EQ): CASE(OP_NE): CASE(OP_LT): CASE(OP_LTE): CASE(OP_GT): CASE(OP_GTE):
+    CASE(OP_IS): CASE(OP_IN): {
+      struct RAM_VALUE lhs, rhs;
+
+      if (instr->checked) { // proven by check.c to succeed
+        lhs = vm_peek(vm, instr->a);
+        rhs = vm_peek(vm, instr->b);
+        vm_generic_binary(vm, instr, instr->opcode, &lhs, &rhs);
+        NEXT;
+      }
+
+      // both operands are fetched (and errors reported) before stopping:
+      bool lhs_success = vm_fetch(vm, instr->a, instr->line, &lhs);
+      bool rhs_success = vm_fetch(vm, instr->b, instr->line, &rhs);
+      if (!(lhs_success && rhs_success))
+        return;
+
+      int opcode = instr->opcode;
+      vm_quicken(instr, &lhs, &rhs);
+
+      if (!vm_generic_binary(vm, instr, opcode, &lhs, &rhs))
+        return;
+      NEXT;
+    }
+
+    //
+    // Quickened binary instructions. Each fetches its operands like the
+    // generic case, checks their types (and, for division, that the
+    // divisor is not 0), and computes the result directly; otherwise it
+    // is deoptimized and takes the generic path. If check.c proved the
+    // types, the operands are read without any checks at all.
+    //
+#define QUICKENED(OPCODE, TYPE, FIELD, RESULT_TYPE, RESULT_FIELD, OPERATION)  \
+    CASE(OPCODE): {                                                            \
+      struct RAM_VALUE lhs, rhs, result;                                       \
+      if (instr->checked) {                                                    \
+        lhs = vm_peek(vm, instr->a);                                           \
+        rhs = vm_peek(vm, instr->b);                                           \
+      } else {                                                                 \
+        bool lhs_success = vm_fetch(vm, instr->a, instr->line, &lhs);         \
+        bool rhs_success = vm_fetch(vm, instr->b, instr->line, &rhs);         \
+        if (!(lhs_success && rhs_success))                                     \
+          return;                                                              \
+        if (lhs.value_type != TYPE || rhs.value_type != TYPE) {                \
+          if (!vm_deoptimize(vm, instr, &lhs, &rhs))                           \
+            return;                                                            \
+          NEXT;                                                                \
+        }                                                                      \
+      }                                                                        \
+      result.value_type = RESULT_TYPE;                                         \
+      result.types.RESULT_FIELD = (lhs.types.FIELD OPERATION rhs.types.FIELD); \
+      vm_store(vm, instr->dst, result, false);                                 \
+      NEXT;                                                                    \
+    }
+
+    QUICKENED(OP_ADD_II, RAM_TYPE_INT, i, RAM_TYPE_INT, i, +)
+    QUICKENED(OP_SUB_II, RAM_TYPE_INT, i, RAM_TYPE_INT, i, -)
+    QUICKENED(OP_MUL_II, RAM_TYPE_INT, i, RAM_TYPE_INT, i, *)
+    QUICKENED(OP_EQ_II, RAM_TYPE_INT, i, RAM_TYPE_BOOLEAN, i, ==)
+    QUICKENED(OP_NE_II, RAM_TYPE_INT, i, RAM_TYPE_BOOLEAN, i, !=)
+    QUICKENED(OP_LT_II, RAM_TYPE_INT, i, RAM_TYPE_BOOLEAN, i, <)
+    QUICKENED(OP_LTE_II, RAM_TYPE_INT, i, RAM_TYPE_BOOLEAN, i, <=)
+    QUICKENED(OP_GT_II, RAM_TYPE_INT, i, RAM_TYPE_BOOLEAN, i, >)
+    QUICKENED(OP_GTE_II, RAM_TYPE_INT, i, RAM_TYPE_BOOLEAN, i, >=)
+    QUICKENED(OP_ADD_RR, RAM_TYPE_REAL, d, RAM_TYPE_REAL, d, +)
+    QUICKENED(OP_SUB_RR, RAM_TYPE_REAL, d, RAM_TYPE_REAL, d, -)
+    QUICKENED(OP_MUL_RR, RAM_TYPE_REAL, d, RAM_TYPE_REAL, d, *)
+    QUICKENED(OP_EQ_RR, RAM_TYPE_REAL, d, RAM_TYPE_BOOLEAN, i, ==)
+    QUICKENED(OP_NE_RR, RAM_TYPE_REAL, d, RAM_TYPE_BOOLEAN, i, !=)
+    QUICKENED(OP_LT_RR, RAM_TYPE_REAL, d, RAM_TYPE_BOOLEAN, i, <)
+    QUICKENED(OP_LTE_RR, RAM_TYPE_REAL, d, RAM_TYPE_BOOLEAN, i, <=)
+    QUICKENED(OP_GT_RR, RAM_TYPE_REAL, d, RAM_TYPE_BOOLEAN, i, >)
+    QUICKENED(OP_GTE_RR, RAM_TYPE_REAL, d, RAM_TYPE_BOOLEAN, i, >=)
+#undef QUICKENED
+
+    CASE(OP_DIV_II): CASE(OP_DIV_RR): {
+      struct RAM_VALUE lhs, rhs, result;
+      int type = (instr->opcode == OP_DIV_II) ? RAM_TYPE_INT : RAM_TYPE_REAL;
+
+      if (instr->checked) { // types proven, and the divisor is a non-zero constant
+        lhs = vm_peek(vm, instr->a);
+        rhs = vm_peek(vm, instr->b);
+      } else {
+        bool lhs_success = vm_fetch(vm, instr->a, instr->line, &lhs);
+        bool rhs_success = vm_fetch(vm, instr->b, instr->line, &rhs);
+        if (!(lhs_success && rhs_success))
+          return;
+
+        bool zero = (type == RAM_TYPE_INT) ? (rhs.types.i == 0) : (rhs.types.d == 0.0);
+        if (lhs.value_type != type || rhs.value_type != type || zero) {
+          if (!vm_deoptimize(vm, instr, &lhs, &rhs))  // reports division by zero
+            return;
+          NEXT;
+        }
+      }
+      result.value_type = type;
+      if (type == RAM_TYPE_INT)
+        result.types.i = lhs.types.i / rhs.types.i;
+      else
+        result.types.d = lhs.types.d / rhs.types.d;
+      vm_store(vm, instr->dst, result, false);
+      NEXT;
+    }
+
+    CASE(OP_APPEND): {
+      struct RAM_VALUE lhs, rhs, result;
+
+      if (instr->checked) {
+        lhs = vm_peek(vm, instr->a);
+        rhs = vm_peek(vm, instr->b);
+      } else {
+        bool lhs_success = vm_fetch(vm, instr->a, instr->line, &lhs);
+        bool rhs_success = vm_fetch(vm, instr->b, instr->line, &rhs);
+        if (!(lhs_success && rhs_success))
+          return;
+      }
+
+      if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) {
+        // rhs is retained in case it is the very string being appended to (x = x + x):
+        char* tail = rstr_retain(rhs.types.s);
+        ram_append_cell_by_addr(vm->memory, tail, rstr_length(tail), vm_address(vm, instr->a.index));
+        rstr_release(tail);
+        NEXT;
+      }
+
+      if (!vm_binary(OP_ADD, &lhs, &rhs, &result, instr->line))
+        return;
+      vm_store(vm, instr->dst, result, true);
+      NEXT;
+    }
+
+    CASE(OP_MOVE): {
+      struct RAM_VALUE value;
+      if (instr->checked)
+        value = vm_peek(vm, instr->a);
+      else if (!vm_fetch(vm, instr->a, instr->line, &value))
+        return;
+      vm_store(vm, instr->dst, value, false);
+      NEXT;
+    }
+
+    CASE(OP_INPUT): {
+      struct RAM_VALUE prompt, result;
+      vm_fetch(vm, instr->a, instr->line, &prompt);
+      vm_input(&prompt, &result);
+      vm_store(vm, instr->dst, result, true);
+      NEXT;
+    }
+
+    CASE(OP_INT): CASE(OP_FLOAT): {
+      struct RAM_VALUE value, result;
+      if (instr->checked)
+        value = vm_peek(vm, instr->a);
+      else if (!vm_fetch(vm, instr->a, instr->line, &value))
+        return;
+      if (!vm_convert(instr->opcode, &value, &result, instr->line))
+        return;
+      vm_store(vm, instr->dst, result, false);
+      NEXT;
+    }
+
+    CASE(OP_PRINT): {
+      struct RAM_VALUE value;
+      if (instr->a.kind == OPND_NONE) {
+        output_newline();
+        NEXT;
+      }
+      if (instr->checked)
+        value = vm_peek(vm, instr->a);
+      else if (!vm_fetch(vm, instr->a, instr->line, &value))
+        return;
+      vm_print(&value);
+      NEXT;
+    }
+
+    CASE(OP_DEREF_TARGET): {
+      int address;
+      if (instr->checked) // p is proven to hold a valid address
+        address = vm_peek(vm, instr->a).types.i;
+      else if (!vm_deref_target(vm, instr->a, instr->line, &address))
+        return;
+      struct RAM_VALUE* reg = &vm->registers[instr->dst.index];
+      if (reg->value_type == RAM_TYPE_STR)
+        rstr_release(reg->types.s);
+      reg->value_type = RAM_TYPE_PTR;
+      reg->types.i = address;
+      NEXT;
+    }
+
+    CASE(OP_JUMP):
+      if (vm->jit != NULL && instr->target < pc) {
+        // back to a loop header, whose trace (if any) runs the loop:
+        int resume = jit_loop(vm->jit, instr->target, pc - 1, vm->memory);
+        pc = (resume >= 0) ? resume : instr->target;
+        NEXT;
+      }
+      pc = instr->target;
+      NEXT;
+
+    CASE(OP_JUMP_IF_FALSE): {
+      struct RAM_VALUE value;
+      if (instr->checked)
+        value = vm_peek(vm, instr->a);
+      else if (!vm_fetch(vm, instr->a, instr->line, &value))
+        return;
+      // true only for non-zero int or boolean values, like the executor:
+      bool condition = ((value.value_type == RAM_TYPE_BOOLEAN || value.value_type == RAM_TYPE_INT) && value.types.i != 0);
+      if (!condition)
+        pc = instr->target;
+      NEXT;
+    }
+
+    //
+    // Superinstructions (see bytecode_fuse):
+    //
+    CASE(OP_INC_II): {
+      vm_cell(vm, instr->dst.index)->types.i += vm->code->constants[instr->b.index].types.i;
+      vm->code->fires[OP_INC_II]++;
+      NEXT;
+    }
+
+    CASE(OP_ADD_TO_II): {
+      vm_cell(vm, instr->dst.index)->types.i += vm_cell(vm, instr->b.index)->types.i;
+      vm->code->fires[OP_ADD_TO_II]++;
+      NEXT;
+    }
+
+    CASE(OP_BRANCH_LT_II): {
+      // the jump_if_false that follows is done here too:
+      if (vm_peek(vm, instr->a).types.i < vm_peek(vm, instr->b).types.i)
+        pc++;
+      else
+        pc = code[pc].target;
+      vm->code->fires[OP_BRANCH_LT_II]++;
+      NEXT;
+    }
+
+    CASE(OP_DEREF_INC): {
+      // *p = *p + constant, if p holds a valid address of an int:
+      int pointer_address = vm_address(vm, instr->a.index);
+      const struct RAM_VALUE* pointer = ram_peek_cell_by_addr(vm->memory, pointer_address);
+      if (pointer != NULL && pointer->value_type == RAM_TYPE_PTR) {
+        int address = pointer->types.i;
+        const struct RAM_VALUE* target = ram_peek_cell_by_addr(vm->memory, address);
+        if (target != NULL && target->value_type == RAM_TYPE_INT) {
+          vm->memory->cells[address].value.types.i += vm->code->constants[code[pc].b.index].types.i;
+          pc++;  // skip the add
+          vm->code->fires[OP_DEREF_INC]++;
+          NEXT;
+        }
+      }
+
+      // otherwise the deref target and the add run one at a time:
+      int address;
+      if (!vm_deref_target(vm, instr->a, instr->line, &address))
+        return;
+      struct RAM_VALUE* reg = &vm->registers[instr->dst.index];
+      if (reg->value_type == RAM_TYPE_STR)
+        rstr_release(reg->types.s);
+      reg->value_type = RAM_TYPE_PTR;
+      reg->types.i = address;
+      NEXT;
+    }
+
+    CASE(OP_LOOP_LT): {
+      // counted loop header: the types of i and N are checked here, once
+      // per entry to the loop, instead of on every iteration:
+      struct RAM_VALUE i, n;
+      bool i_success = vm_fetch(vm, instr->a, instr->line, &i);
+      bool n_success = vm_fetch(vm, instr->b, instr->line, &n);
+      if (!(i_success && n_success))
+        return;
+
+      struct INSTR* back_edge = &code[instr->target];
+      if (i.value_type == RAM_TYPE_INT && n.value_type == RAM_TYPE_INT) {
+        back_edge->cache_hits = 1;
+        pc = (i.types.i < n.types.i) ? pc + 1 : code[pc].target;
+        vm->code->fires[OP_LOOP_LT]++;
+        NEXT;
+      }
+
+      // not ints, an ordinary loop this time around:
+      back_edge->cache_hits = 0;
+      if (!vm_generic_binary(vm, instr, OP_LT, &i, &n))
+        return;
+      NEXT;
+    }
+
+    CASE(OP_LOOP_INC_LT): {
+      struct INSTR* header = &code[instr->target];
+
+      if (instr->cache_hits == 1) {
+        // i and N are ints, and the body changed neither:
+        struct RAM_VALUE* i = vm_cell(vm, instr->dst.index);
+        i->types.i += vm->code->constants[instr->b.index].types.i;
+        int back_edge = pc;
+        pc = (i->types.i < vm_peek(vm, header->b).types.i) ? instr->target + 2 : code[instr->target + 1].target;
+        vm->code->fires[OP_LOOP_INC_LT]++;
+        if (vm->jit != NULL && pc == instr->target + 2) {
+          // the trace tests i < N again, which changes nothing:
+          int resume = jit_loop(vm->jit, instr->target, back_edge, vm->memory);
+          if (resume >= 0)
+            pc = resume;
+        }
+        NEXT;
+      }
+
+      // otherwise the increment, then the jump back to the header:
+      struct RAM_VALUE lhs, rhs;
+      bool lhs_success = vm_fetch(vm, instr->a, instr->line, &lhs);
+      bool rhs_success = vm_fetch(vm, instr->b, instr->line, &rhs);
+      if (!(lhs_success && rhs_success))
+        return;
+      if (!vm_generic_binary(vm, instr, OP_ADD, &lhs, &rhs))
+        return;
+      NEXT;
+    }
+
+    CASE(OP_HALT):
+      return;
+
+#if !defined(VM_THREADED)
+    default:
+      return;
+    }
+#endif
+  }
+#undef CASE
+#undef NEXT
+#undef DISPATCH
+}
+
+//
+// vm_execute
+//
+// Given compiled nuPython bytecode and a memory, executes
+// the program. If a semantic error occurs (e.g. type error),
+// an error message is output, execution stops, and the
+// function returns. If jit is true, hot loops are compiled
+// to machine code (see jit.h).
+//
+void vm_execute(struct BYTECODE* code, struct RAM* memory, bool jit)
+{
+  struct VM vm;
+  vm.code = code;
+  vm.memory = memory;
+  vm.jit = jit ? jit_init(code) : NULL;
+  vm.registers = (struct RAM_VALUE*)malloc(code->num_registers * sizeof(struct RAM_VALUE));
+
+  vm.addresses = (int*)malloc(code->symbols->num_slots * sizeof(int));
+
+  for (int i = 0; i < code->num_registers; i++) {
+    vm.registers[i].value_type = RAM_TYPE_NONE;
+    vm.registers[i].types.i = 0;
+  }
+  for (int slot = 0; slot < code->symbols->num_slots; slot++)
+    vm.addresses[slot] = -1;
+
+  vm_run(&vm);
+
+  for (int i = 0; i < code->num_registers; i++) {
+    if (vm.registers[i].value_type == RAM_TYPE_STR)
+      rstr_release(vm.registers[i].types.s);
+  }
+  free(vm.registers);
+  free(vm.addresses);
+  if (vm.jit != NULL)
+    jit_destroy(vm.jit);
+}
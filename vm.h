@@ -0,0 +1,72 @@
+/*vm.h*/
+
+//
+// Register-based virtual machine for nuPython bytecode (see bytecode.h).
+// Produces the same output and the same semantic error messages as the
+// tree-walking executor in execute.c, which remains available as a
+// reference.
+//
+// Author: Jonathan Kong
+// Northwestern University
+// CS 211
+//
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "bytecode.h"
+#include "ram.h"
+
+
+//
+// Public functions:
+//
+
+//
+// vm_execute
+//
+// Given compiled nuPython bytecode and a memory, executes
+// the program. If a semantic error occurs (e.g. type error),
+// an error message is output, execution stops, and the
+// function returns. If jit is true, hot loops are compiled
+// to machine code (see jit.h).
+//
+void vm_execute(struct BYTECODE* code, struct RAM* memory, bool jit);
+
+//
+// The run-time operations on values, shared with the other engines
+// that run with the VM's semantics (see flat.h):
+//
+
+//
+// vm_binary
+//
+// Evaluates lhs <opcode> rhs, where opcode is a binary opcode OP_ADD
+// through OP_IN (OP_ADD + an enum OPERATORS value). Returns false if
+// a semantic error occurred (error msg is output).
+//
+bool vm_binary(int opcode, struct RAM_VALUE* lhs, struct RAM_VALUE* rhs, struct RAM_VALUE* result, int line);
+
+//
+// vm_print
+//
+// Outputs a value the way print() does, followed by a newline.
+//
+void vm_print(struct RAM_VALUE* value);
+
+//
+// vm_input
+//
+// Outputs the prompt (if it is a string) and reads one line from
+// the keyboard, returned as an rstring the caller owns.
+//
+void vm_input(struct RAM_VALUE* prompt, struct RAM_VALUE* result);
+
+//
+// vm_convert
+//
+// Implements int() (opcode OP_INT) and float() (OP_FLOAT). Returns
+// false if a semantic error occurred (error msg is output).
+//
+bool vm_convert(int opcode, struct RAM_VALUE* value, struct RAM_VALUE* result, int line);